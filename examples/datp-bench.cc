@@ -0,0 +1,326 @@
+#include <cstdlib>
+#include <new>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/datp-module.h"
+
+using namespace ns3;
+using namespace std;
+
+/**
+ * \brief Datp component microbenchmarks.
+ * Drives the header codec, the simple function and the simple scheduler
+ * directly with a synthetic message stream, without any network.  Messages
+ * of apps applications carry words 32 bit readings each.  For every
+ * component one line is printed:
+ *
+ * component,messages,ns/message,allocations/message,bytes out/bytes in
+ *
+ * The scheduler runs under simulated time, messages arrive every interval
+ * microseconds; its figures include the simulator events it schedules.
+ * Run with the same arguments on two commits to compare them.
+ */
+
+NS_LOG_COMPONENT_DEFINE ("DatpBench");
+
+//every allocation made by the process is counted
+static uint64_t g_allocations = 0;
+
+void *
+operator new (size_t size) throw (std::bad_alloc)
+{
+  ++g_allocations;
+  void *p = malloc (size ? size : 1);
+  if (!p)
+    throw std::bad_alloc ();
+  return p;
+}
+
+void
+operator delete (void *p) throw ()
+{
+  free (p);
+}
+
+struct BenchResult
+{
+  uint64_t messages;
+  int64_t elapsedMs;
+  uint64_t allocations;
+  uint64_t bytesIn;
+  uint64_t bytesOut;
+};
+
+static void
+Report (string component, BenchResult const &result)
+{
+  cout << component << ","
+       << result.messages << ","
+       << fixed << setprecision (1)
+       << result.elapsedMs * 1e6 / result.messages << ","
+       << setprecision (3)
+       << result.allocations / (double) result.messages << ","
+       << result.bytesOut / (double) result.bytesIn << endl;
+}
+
+static Ptr<Packet>
+MakePayload (uint32_t words, uint32_t seed)
+{
+  Ptr<Packet> payload = Create<Packet> (0);
+  for (uint32_t w = 0; w < words; ++w)
+    {
+      DatpGenericApplicationDataHeader value;
+      value.SetValue (1 + (seed + w) % 7);
+      payload->AddHeader (value);
+    }
+  return payload;
+}
+
+static DatpHeader
+MakeHeader (uint32_t apps, uint32_t m, uint32_t words)
+{
+  DatpHeader datpHeader;
+  datpHeader.SetApplication (1 + m % apps);
+  datpHeader.SetPriority (0);
+  datpHeader.SetTimestamp (Seconds (10.0).GetNanoSeconds () + m * 1000);
+  datpHeader.SetDataLength (words * 4);
+  datpHeader.SetSequence (m);
+  return datpHeader;
+}
+
+static DatpMessageDescriptor
+MakeDescriptor (DatpHeader const &datpHeader)
+{
+  DatpMessageDescriptor descriptor;
+  descriptor.offset = 0;
+  descriptor.hff = datpHeader.GetHeaderFieldFlags ();
+  descriptor.sizeModifiers = datpHeader.GetSizeModifiers ();
+  descriptor.encodingFlags = datpHeader.GetEncodingFlags ();
+  descriptor.context = 0;
+  descriptor.headerSize = datpHeader.GetInternalHeaderSize ();
+  descriptor.origin = datpHeader.GetOrigin ();
+  descriptor.application = datpHeader.GetApplication ();
+  descriptor.priority = datpHeader.GetPriority ();
+  descriptor.timestamp = datpHeader.GetTimestamp ();
+  descriptor.dataLength = datpHeader.GetDataLength ();
+  descriptor.sequence = datpHeader.GetSequence ();
+  descriptor.count = datpHeader.GetCount ();
+  descriptor.payloadOffset = descriptor.headerSize;
+  return descriptor;
+}
+
+/// Encode messages into packets of batch messages, then decode them again
+static void
+BenchHeaders (uint32_t messages, uint32_t apps, uint32_t words, uint32_t batch, bool bundle, bool frame)
+{
+  Ptr<Packet> payload = MakePayload (words, 0);
+  vector<Ptr<Packet> > packets;
+  BenchResult encode = { messages, 0, 0, 0, 0 };
+  DatpPacketBuilder packetBuilder;
+  packetBuilder.SetBundleHeaders (bundle);
+  packetBuilder.SetFrameHeader (frame);
+
+  uint64_t allocations = g_allocations;
+  SystemWallClockMs clock;
+  clock.Start ();
+  for (uint32_t m = 0; m < messages; ++m)
+    {
+      packetBuilder.AddMessage (MakeHeader (apps, m, words), payload);
+      if (packetBuilder.GetNMessages () == batch || m + 1 == messages)
+        {
+          packets.push_back (packetBuilder.Build ());
+          encode.bytesOut += packets.back ()->GetSize ();
+        }
+      encode.bytesIn += payload->GetSize ();
+    }
+  encode.elapsedMs = clock.End ();
+  encode.allocations = g_allocations - allocations;
+  Report ("header-encode", encode);
+
+  BenchResult decode = { 0, 0, 0, encode.bytesOut, 0 };
+  DatpHeaderView view;
+  allocations = g_allocations;
+  clock.Start ();
+  for (uint32_t p = 0; p < packets.size (); ++p)
+    {
+      view.Parse (packets[p]);
+      for (uint32_t i = 0; i < view.GetNMessages (); ++i)
+        decode.bytesOut += view.GetMessage (i).dataLength;
+      decode.messages += view.GetNMessages ();
+    }
+  decode.elapsedMs = clock.End ();
+  decode.allocations = g_allocations - allocations;
+  Report ("header-decode", decode);
+}
+
+/// Stands in for the scheduler: one buffered message per application
+class FunctionHarness
+{
+public:
+  FunctionHarness (Ptr<DatpFunction> function, Ptr<DatpMessageStore> messageStore)
+    : m_function (function),
+      m_messageStore (messageStore)
+  {
+  }
+  uint32_t Lookup (uint64_t mergeKey)
+  {
+    std::map<uint64_t,uint32_t>::iterator it = m_buffered.find (mergeKey);
+    return it == m_buffered.end () ? 0 : it->second;
+  }
+  void NewMessage (uint32_t handle)
+  {
+    m_buffered[m_messageStore->GetMergeKey (handle)] = handle;
+  }
+  void ExistingMessage (uint32_t handle)
+  {
+  }
+  /// Eject stand-in, reduces what a lazy function left pending
+  void Reduce (void)
+  {
+    for (std::map<uint64_t,uint32_t>::iterator it = m_buffered.begin (); it != m_buffered.end (); ++it)
+      m_function->Reduce (it->second);
+  }
+  uint64_t GetBufferedBytes (void)
+  {
+    uint64_t bytes = 0;
+    for (std::map<uint64_t,uint32_t>::iterator it = m_buffered.begin (); it != m_buffered.end (); ++it)
+      bytes += m_messageStore->Get (it->second).payload->GetSize ();
+    return bytes;
+  }
+
+private:
+  Ptr<DatpFunction> m_function;
+  Ptr<DatpMessageStore> m_messageStore;
+  std::map<uint64_t,uint32_t> m_buffered;
+};
+
+/// Merge every message into the buffered message of its application
+static void
+BenchFunction (uint32_t messages, uint32_t apps, uint32_t words, bool lazy)
+{
+  Ptr<DatpMessageStore> messageStore = CreateObject<DatpMessageStore> ();
+  Ptr<DatpFunction> function = CreateObjectWithAttributes<DatpFunctionSimple> ("LazyMerge", BooleanValue (lazy));
+  function->SetMessageStore (messageStore);
+  FunctionHarness harness (function, messageStore);
+  function->SetMergeLookupCallback (MakeCallback (&FunctionHarness::Lookup, &harness));
+  function->SetNewMessageCallback (MakeCallback (&FunctionHarness::NewMessage, &harness));
+  function->SetExistingMessageCallback (MakeCallback (&FunctionHarness::ExistingMessage, &harness));
+
+  //payloads are prepared up front, the function consumes them
+  vector<Ptr<Packet> > payloads;
+  for (uint32_t m = 0; m < messages; ++m)
+    payloads.push_back (MakePayload (words, m));
+
+  BenchResult result = { messages, 0, 0, 0, 0 };
+  uint64_t allocations = g_allocations;
+  SystemWallClockMs clock;
+  clock.Start ();
+  for (uint32_t m = 0; m < messages; ++m)
+    {
+      DatpHeader datpHeader = MakeHeader (apps, m, words);
+      result.bytesIn += payloads[m]->GetSize ();
+      function->ReceiveNewMessage (messageStore->Add (MakeDescriptor (datpHeader), payloads[m], Seconds (0.0)));
+    }
+  harness.Reduce ();
+  result.elapsedMs = clock.End ();
+  result.allocations = g_allocations - allocations;
+  result.bytesOut = harness.GetBufferedBytes ();
+  Report ("function-merge", result);
+}
+
+struct SchedulerFeed
+{
+  Ptr<DatpScheduler> scheduler;
+  Ptr<DatpMessageStore> messageStore;
+  Ptr<Packet> payload;
+  uint32_t apps;
+  uint32_t words;
+  uint32_t messages;
+  uint32_t next;
+  Time interval;
+  uint64_t bytesIn;
+  uint64_t bytesOut;
+};
+
+static void
+SchedulerEject (SchedulerFeed *feed, Ptr<Packet> packet)
+{
+  feed->bytesOut += packet->GetSize ();
+}
+
+static void
+SchedulerArrival (SchedulerFeed *feed)
+{
+  DatpHeader datpHeader = MakeHeader (feed->apps, feed->next, feed->words);
+  feed->bytesIn += datpHeader.GetInternalHeaderSize () + feed->payload->GetSize ();
+  feed->scheduler->ReceiveNewMessage (feed->messageStore->Add (MakeDescriptor (datpHeader), feed->payload, Simulator::Now ()));
+  if (++feed->next < feed->messages)
+    Simulator::Schedule (feed->interval, &SchedulerArrival, feed);
+}
+
+/// Buffer and eject a message stream arriving at a fixed rate
+static void
+BenchScheduler (uint32_t messages, uint32_t apps, uint32_t words, Time interval, bool bundle, bool frame)
+{
+  Ptr<DatpMessageStore> messageStore = CreateObject<DatpMessageStore> ();
+  Ptr<DatpScheduler> scheduler = CreateObjectWithAttributes<DatpSchedulerSimple> ("BundleHeaders", BooleanValue (bundle),
+                                                                                  "FrameHeader", BooleanValue (frame));
+  scheduler->SetMessageStore (messageStore);
+  SchedulerFeed feed = { scheduler, messageStore, MakePayload (words, 0), apps, words, messages, 0, interval, 0, 0 };
+  scheduler->SetPacketEjectCallback (MakeBoundCallback (&SchedulerEject, &feed));
+
+  BenchResult result = { messages, 0, 0, 0, 0 };
+  uint64_t allocations = g_allocations;
+  SystemWallClockMs clock;
+  clock.Start ();
+  Simulator::ScheduleNow (&SchedulerArrival, &feed);
+  Simulator::Run ();
+  result.elapsedMs = clock.End ();
+  result.allocations = g_allocations - allocations;
+  result.bytesIn = feed.bytesIn;
+  result.bytesOut = feed.bytesOut;
+  Simulator::Destroy ();
+  Report ("scheduler-eject", result);
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t messages = 100000;
+  uint32_t apps = 4;
+  uint32_t words = 1;
+  uint32_t batch = 8;
+  uint32_t interval = 100;
+  bool bundle = false;
+  bool frame = false;
+  bool lazy = false;
+  string component = "all";
+
+  CommandLine cmd;
+  cmd.AddValue ("messages", "messages driven through each component (100000)", messages);
+  cmd.AddValue ("apps", "number of applications the messages are spread over (4)", apps);
+  cmd.AddValue ("words", "32 bit readings per message (1)", words);
+  cmd.AddValue ("batch", "messages per packet for the header benchmark (8)", batch);
+  cmd.AddValue ("interval", "microseconds between scheduler arrivals (100)", interval);
+  cmd.AddValue ("bundle", "bundle the headers of concatenated messages (false)", bundle);
+  cmd.AddValue ("frame", "put a frame header in front of packets (false)", frame);
+  cmd.AddValue ("lazy", "merge on eject instead of on arrival (false)", lazy);
+  cmd.AddValue ("component", "header, function, scheduler or all (all)", component);
+
+  cmd.Parse (argc, argv);
+  NS_LOG_DEBUG ("Command-Line Arguments: messages="<<messages<<", apps="<<apps<<", words="<<words<<", batch="<<batch);
+
+  cout << "component,messages,ns/message,allocations/message,bytes out/bytes in" << endl;
+  if (component == "all" || component == "header")
+    BenchHeaders (messages, apps, words, batch, bundle, frame);
+  if (component == "all" || component == "function")
+    BenchFunction (messages, apps, words, lazy);
+  if (component == "all" || component == "scheduler")
+    BenchScheduler (messages, apps, words, MicroSeconds (interval), bundle, frame);
+
+  return 0;
+}
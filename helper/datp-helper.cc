@@ -58,7 +58,24 @@ DatpHelper::EnableLogComponents (LogLevel level)
   LogComponentEnable ("DatpSchedulerSimple", level);
   LogComponentEnable ("DatpFunction", level);
   LogComponentEnable ("DatpFunctionSimple", level);
+  LogComponentEnable ("DatpFunctionTyped", level);
+  LogComponentEnable ("DatpFunctionSketch", level);
+  LogComponentEnable ("DatpFunctionCompress", level);
+  LogComponentEnable ("DatpFunctionDeadBand", level);
+  LogComponentEnable ("DatpFunctionWindow", level);
+  LogComponentEnable ("DatpFunctionPipeline", level);
+  LogComponentEnable ("DatpFunctionSchema", level);
+  LogComponentEnable ("DatpFunctionIncremental", level);
+  LogComponentEnable ("DatpFunctionFusion", level);
+  LogComponentEnable ("DatpDeadBand", level);
+  LogComponentEnable ("DatpBloomFilter", level);
+  LogComponentEnable ("DatpPayloadSchema", level);
+  LogComponentEnable ("DatpQuantizer", level);
   LogComponentEnable ("DatpHeaders", level);
+  LogComponentEnable ("DatpHeaderContext", level);
+  LogComponentEnable ("DatpHeaderView", level);
+  LogComponentEnable ("DatpMessageStore", level);
+  LogComponentEnable ("DatpPacketBuilder", level);
   LogComponentEnable ("DatpTreeController", level);
   LogComponentEnable ("DatpTreeControllerAodv", level);
 }
@@ -124,8 +141,8 @@ DatpHelper::DatpTrace (std::string fileName, Ptr<Node> collector, NodeContainer
   *stream->GetStream () << "Id,Address,Name,Role,Mt,Bt,Pr,Mr,Br,Pp,Mm,Bm,Dm,Mc,Rp,Rb,Dma\n";
   collectorApp->PrintStream ();
 
-  *stream->GetStream () << "\nId,Address,Name,Role,Ps,Bs,Pr,Mr,Br,Pf,Mm,Bm,Ds,Mc,Rp,Rb,Dsa,Mst\n";
-  double c[11] = {0};
+  *stream->GetStream () << "\nId,Address,Name,Role,Ps,Bs,Pr,Mr,Br,Pf,Mm,Bm,Ds,Mc,Rp,Rb,Dsa,Mst,Md\n";
+  double c[12] = {0};
   uint32_t nNodes = aggregators.GetN ();
   for (uint32_t i = 0; i < nNodes; ++i)
     {
@@ -144,14 +161,15 @@ DatpHelper::DatpTrace (std::string fileName, Ptr<Node> collector, NodeContainer
                             << agg->GetMessagesReceived () << ","
                             << agg->GetBytesReceived () << ","
                             << agg->GetPacketsSentFailure () << ","
-                            << node->GetObject<DatpFunctionSimple> ()->GetMessagesMerged ()  << ","
-                            << node->GetObject<DatpFunctionSimple> ()->GetBytesMerged ()  << ","
+                            << agg->GetMessagesMerged ()  << ","
+                            << agg->GetBytesMerged ()  << ","
                             << node->GetObject<DatpSchedulerSimple> ()->GetSchedulerDelay ().GetSeconds () << ","
                             << node->GetObject<DatpSchedulerSimple> ()->GetMessagesConcatenated () << ","
                             << (agg->GetPacketsReceived () - agg->GetPacketsSent ()) / (agg->GetPacketsReceived () * 1.0) * 100 << ","
                             << (agg->GetBytesReceived () - agg->GetBytesSent ()) / (agg->GetBytesReceived () * 1.0) * 100 << ","
                             << node->GetObject<DatpSchedulerSimple> ()->GetSchedulerDelay ().GetSeconds () / node->GetObject<DatpSchedulerSimple> ()->GetMessagesTotal () << ","
-                            << node->GetObject<DatpSchedulerSimple> ()->GetMessagesTotal ()
+                            << node->GetObject<DatpSchedulerSimple> ()->GetMessagesTotal () << ","
+                            << agg->GetDuplicatesEliminated ()
                             << "\n";
 
       c[0] += agg->GetPacketsSent ();
@@ -160,11 +178,12 @@ DatpHelper::DatpTrace (std::string fileName, Ptr<Node> collector, NodeContainer
       c[3] += agg->GetMessagesReceived ();
       c[4] += agg->GetBytesReceived ();
       c[9] += agg->GetPacketsSentFailure ();
-      c[5] += node->GetObject<DatpFunctionSimple> ()->GetMessagesMerged ();
-      c[6] += node->GetObject<DatpFunctionSimple> ()->GetBytesMerged ();
+      c[5] += agg->GetMessagesMerged ();
+      c[6] += agg->GetBytesMerged ();
       c[7] += node->GetObject<DatpSchedulerSimple> ()->GetSchedulerDelay ().GetSeconds ();
       c[10] += node->GetObject<DatpSchedulerSimple> ()->GetMessagesTotal ();
       c[8] += node->GetObject<DatpSchedulerSimple> ()->GetMessagesConcatenated ();
+      c[11] += agg->GetDuplicatesEliminated ();
     }
     
   *stream->GetStream () << "!,!,Total,Aggregator," << c[0] << "," 
@@ -180,7 +199,8 @@ DatpHelper::DatpTrace (std::string fileName, Ptr<Node> collector, NodeContainer
                                   << (c[2] - c[0]) / c[2] * 100 << ","
                                   << (c[4] - c[1]) / c[4] * 100 << ","
                                   <<  c[7] / c[10] << ","
-                                  << c[10] 
+                                  << c[10] << ","
+                                  << c[11]
                                   << "\n";
   
 
@@ -22,9 +22,13 @@
 #include "ns3/ipv4-address.h"
 #include "ns3/inet-socket-address.h"
 #include "ns3/assert.h"
+#include "ns3/abort.h"
 #include "ns3/boolean.h"
 #include "ns3/uinteger.h"
+#include "ns3/string.h"
 #include "datp-aggregator.h"
+#include <sstream>
+#include <cstdlib>
 
 namespace ns3 {
 
@@ -48,6 +52,26 @@ DatpAggregator::GetTypeId (void)
                    BooleanValue (true),
                    MakeBooleanAccessor (&DatpAggregator::m_functionOn),
                    MakeBooleanChecker ())
+    .AddAttribute ("HeaderContexts",
+                   "Send the static fields of messages as link context IDs, see DatpHeaderContext",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DatpAggregator::m_headerContextsOn),
+                   MakeBooleanChecker ())
+    .AddAttribute ("Dedup",
+                   "Drop messages received before, identified by their origin and sequence number",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DatpAggregator::m_dedupOn),
+                   MakeBooleanChecker ())
+    .AddAttribute ("DedupCapacity",
+                   "Messages remembered per generation of the dedup filter, two generations are kept",
+                   UintegerValue (4096),
+                   MakeUintegerAccessor (&DatpAggregator::m_dedupCapacity),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("DedupBitsPerEntry",
+                   "Bits of the dedup filter per message remembered, more bits drop fewer unique messages",
+                   UintegerValue (10),
+                   MakeUintegerAccessor (&DatpAggregator::m_dedupBitsPerEntry),
+                   MakeUintegerChecker<uint32_t> (1, 64))
     .AddAttribute ("CollectorAddress",
                    "The address of the collector in the aggregation system",
                    AddressValue (),
@@ -68,6 +92,11 @@ DatpAggregator::GetTypeId (void)
                    TypeIdValue (DatpFunctionSimple::GetTypeId ()),   //needs to be set to a child of class function
                    MakeTypeIdAccessor (&DatpAggregator::m_functionTypeId),
                    MakeTypeIdChecker ())    
+    .AddAttribute ("ApplicationFunctions",
+                   "Function type per application, overriding FunctionType, e.g. \"1=ns3::DatpFunctionSum 2=ns3::DatpFunctionDeadBand>ns3::DatpFunctionMean\", several types make a pipeline",
+                   StringValue (""),
+                   MakeStringAccessor (&DatpAggregator::m_applicationFunctionTypes),
+                   MakeStringChecker ())
     .AddAttribute ("SchedulerType",
                    "Set type of scheduler to use",
                    TypeIdValue (DatpSchedulerSimple::GetTypeId ()),   //needs to be set to a child of class scheduler
@@ -87,6 +116,8 @@ DatpAggregator::DatpAggregator ()
   m_packetsReceived = 0;
   m_messagesReceived = 0;
   m_bytesReceived = 0;
+  m_packetsDropped = 0;
+  m_duplicatesEliminated = 0;
 }
 
 DatpAggregator::~DatpAggregator ()
@@ -130,12 +161,32 @@ DatpAggregator::GetBytesReceived (void)
   return m_bytesReceived;
 }
 
+uint32_t 
+DatpAggregator::GetPacketsDropped (void)
+{
+  return m_packetsDropped;
+}
+
+uint32_t 
+DatpAggregator::GetDuplicatesEliminated (void)
+{
+  return m_duplicatesEliminated;
+}
+
 
 void 
 DatpAggregator::SetParentAggregatorAddress (Address parentAggregatorAddress)
 {
   NS_LOG_FUNCTION (this << parentAggregatorAddress);
   m_parentAggregatorAddress = parentAggregatorAddress;
+  //the new parent has none of our contexts
+  if (m_headerContext)
+    m_headerContext->Reset ();
+  //nor the state of the functions
+  if (m_function)
+    m_function->NotifyParentChange ();
+  for (std::map<uint8_t,Ptr<DatpFunction> >::iterator it = m_applicationFunctions.begin (); it != m_applicationFunctions.end (); ++it)
+    it->second->NotifyParentChange ();
 }
 
 Address 
@@ -152,6 +203,24 @@ DatpAggregator::GetCollectorAddress (void) const
   return m_collectorAddress;
 }
 
+uint32_t 
+DatpAggregator::GetMessagesMerged (void)
+{
+  uint32_t messagesMerged = m_function->GetMessagesMerged ();
+  for (std::map<uint8_t,Ptr<DatpFunction> >::iterator it = m_applicationFunctions.begin (); it != m_applicationFunctions.end (); ++it)
+    messagesMerged += it->second->GetMessagesMerged ();
+  return messagesMerged;
+}
+
+uint32_t 
+DatpAggregator::GetBytesMerged (void)
+{
+  uint32_t bytesMerged = m_function->GetBytesMerged ();
+  for (std::map<uint8_t,Ptr<DatpFunction> >::iterator it = m_applicationFunctions.begin (); it != m_applicationFunctions.end (); ++it)
+    bytesMerged += it->second->GetBytesMerged ();
+  return bytesMerged;
+}
+
 void
 DatpAggregator::Install (void)
 {
@@ -172,9 +241,58 @@ DatpAggregator::Install (void)
   m_scheduler = factory.Create <DatpScheduler> ();
   GetNode ()->AggregateObject(m_scheduler);
   
+  //messages live in the store, function and scheduler pass handles around
+  m_messageStore = CreateObject<DatpMessageStore> ();
+  m_scheduler->SetMessageStore (m_messageStore);
+  
+  //contexts of the children are always expanded, our own are optional
+  m_headerContext = CreateObject<DatpHeaderContext> ();
+  if (m_headerContextsOn)
+    m_scheduler->SetHeaderContext (m_headerContext);
+  
+  if (m_dedupOn)
+    m_dedupFilter.SetCapacity (m_dedupCapacity, m_dedupBitsPerEntry);
+  
   factory.SetTypeId (m_functionTypeId);
   m_function = factory.Create <DatpFunction> ();
   GetNode ()->AggregateObject(m_function);
+  m_function->SetMessageStore (m_messageStore);
+  
+  //applications listed in ApplicationFunctions get a function of their own
+  std::istringstream applicationFunctionTypes (m_applicationFunctionTypes);
+  std::string entry;
+  while (applicationFunctionTypes >> entry)
+    {
+      std::string::size_type separator = entry.find ('=');
+      NS_ABORT_MSG_IF (separator == std::string::npos || separator == 0 || separator > 3
+                       || entry.find_first_not_of ("0123456789") < separator,
+                       "ApplicationFunctions entry " << entry << " is not app=type");
+      uint32_t application = atoi (entry.substr (0, separator).c_str ());
+      NS_ABORT_MSG_IF (application > 255, "No application " << application << " in ApplicationFunctions");
+      NS_ABORT_MSG_IF (separator + 1 == entry.size (), "ApplicationFunctions entry " << entry << " has no type");
+      //several types separated by '>' make a pipeline, in that order
+      std::string types = entry.substr (separator + 1);
+      Ptr<DatpFunctionPipeline> pipeline;
+      if (types.find ('>') != std::string::npos)
+        {
+          pipeline = CreateObject<DatpFunctionPipeline> ();
+          pipeline->SetMessageStore (m_messageStore);
+        }
+      std::string::size_type start = 0;
+      Ptr<DatpFunction> function;
+      do
+        {
+          std::string::size_type end = types.find ('>', start);
+          factory.SetTypeId (types.substr (start, end == std::string::npos ? end : end - start));
+          function = factory.Create <DatpFunction> ();
+          function->SetMessageStore (m_messageStore);
+          if (pipeline)
+            pipeline->AddStage (function);
+          start = (end == std::string::npos) ? end : end + 1;
+        }
+      while (start != std::string::npos);
+      m_applicationFunctions[application] = pipeline ? Ptr<DatpFunction> (pipeline) : function;
+    }
   
   if (m_schedulerOn)
     {
@@ -182,13 +300,26 @@ DatpAggregator::Install (void)
 
       if (m_functionOn)
         {     
-          SetNextReceiverCallback (MakeCallback (&DatpFunction::ReceiveNewMessage, m_function));
+          std::vector<Ptr<DatpFunction> > functions (1, m_function);
+          if (m_applicationFunctions.empty ())
+            {
+              SetNextReceiverCallback (MakeCallback (&DatpFunction::ReceiveNewMessage, m_function));
+              m_scheduler->SetReduceCallback (MakeCallback (&DatpFunction::Reduce, m_function));
+            }
+          else
+            {
+              SetNextReceiverCallback (MakeCallback (&DatpAggregator::DispatchNewMessage, this));
+              m_scheduler->SetReduceCallback (MakeCallback (&DatpAggregator::DispatchReduce, this));
+              for (std::map<uint8_t,Ptr<DatpFunction> >::iterator it = m_applicationFunctions.begin (); it != m_applicationFunctions.end (); ++it)
+                functions.push_back (it->second);
+            }
 
-          m_scheduler->SetQueryResponseCallback (MakeCallback (&DatpFunction::ReceiveQueryResponse, m_function)); 
-          
-          m_function->SetQueryCallback (MakeCallback (&DatpScheduler::ReceiveQuery, m_scheduler));
-          m_function->SetNewMessageCallback (MakeCallback (&DatpScheduler::ReceiveNewMessage, m_scheduler));
-          m_function->SetExistingMessageCallback (MakeCallback (&DatpScheduler::ReceiveExistingMessage, m_scheduler));
+          for (uint32_t f = 0; f < functions.size (); ++f)
+            {
+              functions[f]->SetMergeLookupCallback (MakeCallback (&DatpScheduler::FindMergePartner, m_scheduler));
+              functions[f]->SetNewMessageCallback (MakeCallback (&DatpScheduler::ReceiveNewMessage, m_scheduler));
+              functions[f]->SetExistingMessageCallback (MakeCallback (&DatpScheduler::ReceiveExistingMessage, m_scheduler));
+            }
         }
       else
         {
@@ -207,24 +338,52 @@ DatpAggregator::GetTreeControllerApplication (void) const
 }
 
 void 
-DatpAggregator::SetNextReceiverCallback (Callback<void, DatpHeader, Ptr<Packet> > nextReceiver)
+DatpAggregator::SetNextReceiverCallback (Callback<void, uint32_t> nextReceiver)
 {
   NS_LOG_FUNCTION (this << &nextReceiver);
   m_nextReceiver = nextReceiver;
 }
 
 void 
-DatpAggregator::NotifyNextReceiver (DatpHeader datpHeader, Ptr<Packet> packet)
+DatpAggregator::NotifyNextReceiver (uint32_t handle)
 {
-  NS_LOG_FUNCTION (this);
+  NS_LOG_FUNCTION (this << handle);
   if (!m_nextReceiver.IsNull ())
-    m_nextReceiver (datpHeader, packet);
+    m_nextReceiver (handle);
+}
+
+Ptr<DatpFunction>
+DatpAggregator::GetFunction (uint32_t handle) const
+{
+  return GetApplicationFunction (m_messageStore->Get (handle).application);
+}
+
+Ptr<DatpFunction>
+DatpAggregator::GetApplicationFunction (uint8_t application) const
+{
+  std::map<uint8_t,Ptr<DatpFunction> >::const_iterator it = m_applicationFunctions.find (application);
+  return it == m_applicationFunctions.end () ? m_function : it->second;
+}
+
+void
+DatpAggregator::DispatchNewMessage (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  GetFunction (handle)->ReceiveNewMessage (handle);
+}
+
+void
+DatpAggregator::DispatchReduce (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  GetFunction (handle)->Reduce (handle);
 }
 
 void
 DatpAggregator::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
+  m_applicationFunctions.clear ();
   Application::DoDispose ();
 }
 
@@ -259,51 +418,81 @@ DatpAggregator::Receiver (Ptr<Socket> socket)
 {
   NS_LOG_FUNCTION (this << socket);
   Ptr<Packet> packet;
-  Ptr<Packet> forwardPacket = Create<Packet> (0);
   Address from;
   while (packet = socket->RecvFrom (from))
     {
       ++m_packetsReceived;
       m_bytesReceived += packet->GetSize () ;
-      while (packet->GetSize () > 0)
+      //walk every message header once, without touching the packet
+      if (!m_headerView.Parse (packet, m_headerContext, InetSocketAddress::ConvertFrom (from).GetIpv4 ()))
         {
-          DatpHeader datpHeader;
-          /* uint8_t headerBytesRemoved =  */packet->RemoveHeader (datpHeader);
-          ++m_messagesReceived;
-          // NS_LOG_INFO ("Removing message: headerBytes=" << (uint32_t)headerBytesRemoved 
-                    // << " packetSizeLeft=" << packet->GetSize ()
-                    // << " dataLength=" << (uint32_t) datpHeader.GetDataLength ());
-          //check sanity of message
-          // if (/*function to determine sanity of header*/)
-            // break;  //bad rest of packet, effectively discards rest of packet
-          // if (packet->GetSize () < (uint32_t) datpHeader.GetDataLength ())
-            // break;  //bad rest of packet, effectively discards rest of packet
-          NS_ASSERT (packet->GetSize () >= (uint32_t)datpHeader.GetDataLength ()); //bad rest of packet, never should have bad packet in simulator!
-          
-          //Build message descriptor
-          datpHeader.SetInternalMessageIdentifier (m_messagesReceived);
-          datpHeader.SetInternalReceiveTime (Simulator::Now ());
-          
-          Ptr<Packet> newPacket = packet->Copy (); //Explore CopyData instead
-          newPacket->RemoveAtEnd (packet->GetSize () - datpHeader.GetDataLength ());
-          
-          packet->RemoveAtStart (datpHeader.GetDataLength ());
-          
-          if (m_schedulerOn == true)  //as long as scheduler is on, there is a next receiver
+          //truncated, or does not match its frame header
+          NS_LOG_WARN ("Dropping malformed packet from " << InetSocketAddress::ConvertFrom (from).GetIpv4 ());
+          ++m_packetsDropped;
+          continue;
+        }
+      
+      if (m_schedulerOn == false)
+        {
+          //messages are forwarded unchanged, no need to rebuild them
+          //a fresh packet leaves the receive side packet tags behind
+          m_messagesReceived += m_headerView.GetNMessages ();
+          Ptr<Packet> forwardPacket;
+          if (!m_headerView.HasContextMembers ())
             {
-              NotifyNextReceiver (datpHeader, newPacket);
+              forwardPacket = Create<Packet> (0);
+              forwardPacket->AddAtEnd (packet);
             }
           else
             {
-              newPacket->AddHeader (datpHeader);
-              forwardPacket->AddAtEnd (newPacket);
+              //the contexts belong to the link from the child, spell them out
+              DatpPacketBuilder packetBuilder;
+              packetBuilder.SetFrameHeader (m_headerView.HasFrame ());
+              for (uint32_t i = 0; i < m_headerView.GetNMessages (); ++i)
+                packetBuilder.AddMessage (m_headerView.GetHeader (i), m_headerView.GetPayload (i));
+              forwardPacket = packetBuilder.Build ();
             }
+          if (forwardPacket->GetSize () > 0)
+            Sender (forwardPacket);  //forward packet
+          continue;
+        }
+      
+      for (uint32_t i = 0; i < m_headerView.GetNMessages (); ++i)
+        {
+          ++m_messagesReceived;
+          
+          if (m_dedupOn && IsDuplicate (i))
+            {
+              ++m_duplicatesEliminated;
+              continue;
+            }
+          
+          //the message is stored once, only its handle is passed on
+          uint32_t handle = m_messageStore->Add (m_headerView.GetMessage (i), m_headerView.GetPayload (i), Simulator::Now (),
+                                                 InetSocketAddress::ConvertFrom (from).GetIpv4 ().Get ());
+          
+          //as long as scheduler is on, there is a next receiver
+          NotifyNextReceiver (handle);
         }
-      if (m_schedulerOn == false)
-        Sender (forwardPacket);  //forward packet
     }
 }
 
+bool
+DatpAggregator::IsDuplicate (uint32_t index)
+{
+  NS_LOG_FUNCTION (this << index);
+  const DatpMessageDescriptor &message = m_headerView.GetMessage (index);
+  //only messages carrying their origin and sequence can be told apart
+  if ((message.hff&(64|2)) != (64|2))
+    return false;
+  //aggregates keep the origin and sequence of their first reading, the
+  //timestamp and count tell apart those built from the same reading
+  uint64_t key = ((uint64_t) message.origin << 32) | message.sequence;
+  key = key * 0x100000001b3ULL ^ ((uint64_t) message.application << 32 | message.count);
+  key = key * 0x100000001b3ULL ^ message.timestamp;
+  return m_dedupFilter.Insert (key);
+}
+
 void 
 DatpAggregator::Sender (Ptr<Packet> packet)
 {
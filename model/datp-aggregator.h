@@ -29,11 +29,27 @@
 #include "ns3/packet.h"
 #include "ns3/socket.h"
 #include "ns3/type-id.h"
+#include <map>
+#include <string>
 #include "datp-headers.h"
+#include "datp-header-view.h"
+#include "datp-header-context.h"
+#include "datp-packet-builder.h"
+#include "datp-message.h"
 #include "datp-scheduler.h"
 #include "datp-scheduler-simple.h"
 #include "datp-function.h"
 #include "datp-function-simple.h"
+#include "datp-function-typed.h"
+#include "datp-function-sketch.h"
+#include "datp-function-compress.h"
+#include "datp-function-dead-band.h"
+#include "datp-function-window.h"
+#include "datp-function-pipeline.h"
+#include "datp-function-schema.h"
+#include "datp-function-incremental.h"
+#include "datp-function-fusion.h"
+#include "datp-bloom-filter.h"
 #include "datp-tree-controller.h"
 #include "datp-tree-controller-aodv.h"
 
@@ -43,6 +59,11 @@ namespace ns3 {
  * \ingroup Datp
  * \class DatpAggregator
  * \brief The Datp aggregator creates a scheduler, function, and a tree controller
+ *
+ * With Dedup on, a received message carrying both its origin and sequence
+ * number is dropped before it is stored if the same reading went through
+ * already, as remembered by a rotating DatpBloomFilter.  Messages without
+ * these fields, or with the scheduler off, are never deduplicated.
  */
 class DatpAggregator : public Application
 {
@@ -57,6 +78,14 @@ public:
   uint32_t GetPacketsReceived (void);
   uint32_t GetMessagesReceived (void);
   uint32_t GetBytesReceived (void);
+  uint32_t GetPacketsDropped (void);
+  /// Messages dropped as copies of messages received before (Dedup)
+  uint32_t GetDuplicatesEliminated (void);
+  /// Summed over the functions of all applications
+  uint32_t GetMessagesMerged (void);
+  uint32_t GetBytesMerged (void);
+  /// Function of application, a DatpFunctionPipeline for several types, FunctionType if none is listed
+  Ptr<DatpFunction> GetApplicationFunction (uint8_t application) const;
   
   virtual void SetParentAggregatorAddress (Address parentAggregatorAddress);
   virtual Address GetParentAggregatorAddress (void) const;
@@ -66,12 +95,19 @@ public:
   
   virtual Ptr<Application> GetTreeControllerApplication (void) const;
   
-  virtual void SetNextReceiverCallback (Callback<void, DatpHeader, Ptr<Packet> > nextReceiver);
+  virtual void SetNextReceiverCallback (Callback<void, uint32_t> nextReceiver);
 
 protected:
   virtual void DoDispose (void);
   
-  void NotifyNextReceiver (DatpHeader datpHeader, Ptr<Packet> packet);
+  void NotifyNextReceiver (uint32_t handle);
+  
+  /// Function in charge of the application of message handle
+  Ptr<DatpFunction> GetFunction (uint32_t handle) const;
+  void DispatchNewMessage (uint32_t handle);
+  void DispatchReduce (uint32_t handle);
+  /// \returns true if message index of the header view was received before
+  bool IsDuplicate (uint32_t index);
   
 private:
 
@@ -85,6 +121,9 @@ private:
   Ptr<Socket> m_socket;
   Address m_parentAggregatorAddress;
   Address m_collectorAddress;
+  DatpHeaderView m_headerView;
+  Ptr<DatpHeaderContext> m_headerContext;
+  Ptr<DatpMessageStore> m_messageStore;
   
 
   uint32_t m_packetsSent;
@@ -93,20 +132,29 @@ private:
   uint32_t m_packetsReceived;
   uint32_t m_messagesReceived;
   uint32_t m_bytesReceived;
+  uint32_t m_packetsDropped;
+  uint32_t m_duplicatesEliminated;
   
   
   //attribute members
   bool m_schedulerOn;
   bool m_functionOn;
+  bool m_headerContextsOn;
+  bool m_dedupOn;
+  uint32_t m_dedupCapacity;
+  uint32_t m_dedupBitsPerEntry;
+  DatpBloomFilter m_dedupFilter;
   bool m_isInstalled;
   TypeId m_treeControllerTypeId;
   Ptr<DatpTreeController> m_treeController;
   TypeId m_functionTypeId;
   Ptr<DatpFunction> m_function;
+  std::string m_applicationFunctionTypes;
+  std::map<uint8_t,Ptr<DatpFunction> > m_applicationFunctions;
   TypeId m_schedulerTypeId;
   Ptr<DatpScheduler> m_scheduler;
 
-  Callback<void, DatpHeader, Ptr<Packet> > m_nextReceiver;
+  Callback<void, uint32_t> m_nextReceiver;
   
   /// Provides uniform random variables.
   // Ptr<UniformRandomVariable> m_uniformRandomVariable; 
@@ -24,8 +24,10 @@
 #include "ns3/simulator.h"
 #include "ns3/packet.h"
 #include "ns3/uinteger.h"
+#include "ns3/boolean.h"
 #include "datp-application.h"
 #include "datp-headers.h"
+#include "datp-payload-schema.h"
 
 namespace ns3 {
 
@@ -38,6 +40,26 @@ DatpApplication::GetTypeId (void)
 {
   static TypeId tid = TypeId ("ns3::DatpApplication")
     .SetParent<Application> ()
+    .AddAttribute ("StampOrigin",
+                   "Send the node ID as the origin of every message",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DatpApplication::m_stampOrigin),
+                   MakeBooleanChecker ())
+    .AddAttribute ("StampSequence",
+                   "Number the readings of the application, so receivers can drop copies of a message",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DatpApplication::m_stampSequence),
+                   MakeBooleanChecker ())
+    .AddAttribute ("DeadBand",
+                   "Largest change of a reading that is not sent, with a Heartbeat",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&DatpApplication::m_deadBand),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Heartbeat",
+                   "Longest time between two sends when readings do not change, zero sends every reading",
+                   TimeValue (Seconds (0.0)),
+                   MakeTimeAccessor (&DatpApplication::m_heartbeat),
+                   MakeTimeChecker ())
   ;
   return tid;
 }
@@ -49,8 +71,13 @@ DatpApplication::DatpApplication ()
   m_sendEvent = EventId ();
   m_peerAddress.Set ("127.0.0.1");
   m_peerPort = 9999;
+  m_stampOrigin = false;
+  m_stampSequence = false;
+  m_sequence = 0;
   m_messagesSent = 0;
   m_bytesSent = 0;
+  m_messagesSuppressed = 0;
+  m_deadBand = 0;
   m_uniformRandomVariable = CreateObject<UniformRandomVariable> ();
 }
 
@@ -71,6 +98,30 @@ DatpApplication::GetBytesSent (void)
   return m_bytesSent;
 }
 
+uint32_t 
+DatpApplication::GetMessagesSuppressed (void)
+{
+  return m_messagesSuppressed;
+}
+
+bool
+DatpApplication::Suppress (Ptr<const Packet> payload, uint8_t application)
+{
+  NS_LOG_FUNCTION (this << payload << (uint32_t) application);
+  if (m_suppressor.Pass (m_origin, application, payload, Simulator::Now ()))
+    return false;
+  ++m_messagesSuppressed;
+  return true;
+}
+
+Ptr<Packet>
+DatpApplication::CreatePayload (uint8_t application, uint32_t dataLength)
+{
+  //one record of the schema of application, if it has one
+  const DatpPayloadSchema *schema = DatpPayloadSchema::Lookup (application);
+  return Create<Packet> (schema ? schema->GetSize () : dataLength);
+}
+
 void
 DatpApplication::DoDispose (void)
 {
@@ -83,6 +134,9 @@ DatpApplication::StartApplication (void)
 {
   NS_LOG_FUNCTION (this);
   m_origin = GetNode ()->GetId ();
+  m_suppressor.SetDeadBand (m_deadBand);
+  m_suppressor.SetHeartbeat (m_heartbeat);
+  m_suppressor.Clear ();
   if (m_socket == 0)
     {
       TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
@@ -147,20 +201,25 @@ DatpApplicationOne::Send (void)
   NS_LOG_FUNCTION (this);
   NS_ASSERT (m_sendEvent.IsExpired ());
   DatpHeader datpHeader;
-  // datpHeader.SetOrigin (m_origin);
+  if (m_stampOrigin)
+    datpHeader.SetOrigin (m_origin);
   datpHeader.SetApplication (m_application);
   datpHeader.SetTimestamp (Simulator::Now ().GetNanoSeconds ());
   datpHeader.SetPriority (m_priority);
-  datpHeader.SetDataLength (m_dataLength);
-  // datpHeader.SetSequence (m_messagesSent);  
-  Ptr<Packet> p = Create<Packet> (m_dataLength);
+  Ptr<Packet> p = CreatePayload (m_application, m_dataLength);
+  datpHeader.SetDataLength (p->GetSize ());
+  m_sendEvent = Simulator::Schedule (m_interval, &DatpApplicationOne::Send, this);
+  if (Suppress (p, m_application))
+    return;
+  //suppressed readings take no sequence number, a gap means a lost message
+  if (m_stampSequence)
+    datpHeader.SetSequence (m_sequence++);
   p->AddHeader (datpHeader);
   if ((m_socket->Send (p)) >= 0)
     {
       ++m_messagesSent;
       m_bytesSent += p->GetSize ();
     }
-  m_sendEvent = Simulator::Schedule (m_interval, &DatpApplicationOne::Send, this);
 }
 
 
@@ -206,20 +265,24 @@ DatpApplicationTwo::Send (void)
   NS_LOG_FUNCTION (this);
   NS_ASSERT (m_sendEvent.IsExpired ());
   DatpHeader datpHeader;
-  // datpHeader.SetOrigin (m_origin);
+  if (m_stampOrigin)
+    datpHeader.SetOrigin (m_origin);
   datpHeader.SetApplication (m_application);
   datpHeader.SetTimestamp (Simulator::Now ().GetNanoSeconds ());
   datpHeader.SetPriority (m_priority);
-  datpHeader.SetDataLength (m_dataLength);
-  // datpHeader.SetSequence (m_messagesSent);  
-  Ptr<Packet> p = Create<Packet> (m_dataLength);
+  Ptr<Packet> p = CreatePayload (m_application, m_dataLength);
+  datpHeader.SetDataLength (p->GetSize ());
+  m_sendEvent = Simulator::Schedule (m_interval, &DatpApplicationTwo::Send, this);
+  if (Suppress (p, m_application))
+    return;
+  if (m_stampSequence)
+    datpHeader.SetSequence (m_sequence++);
   p->AddHeader (datpHeader);
   if ((m_socket->Send (p)) >= 0)
     {
       ++m_messagesSent;
       m_bytesSent += p->GetSize ();
     }
-  m_sendEvent = Simulator::Schedule (m_interval, &DatpApplicationTwo::Send, this);
 }
 
 
@@ -265,20 +328,24 @@ DatpApplicationThree::Send (void)
   NS_LOG_FUNCTION (this);
   NS_ASSERT (m_sendEvent.IsExpired ());
   DatpHeader datpHeader;
-  // datpHeader.SetOrigin (m_origin);
+  if (m_stampOrigin)
+    datpHeader.SetOrigin (m_origin);
   datpHeader.SetApplication (m_application);
   datpHeader.SetTimestamp (Simulator::Now ().GetNanoSeconds ());
   datpHeader.SetPriority (m_priority);
-  datpHeader.SetDataLength (m_dataLength);
-  // datpHeader.SetSequence (m_messagesSent);  
-  Ptr<Packet> p = Create<Packet> (m_dataLength);
+  Ptr<Packet> p = CreatePayload (m_application, m_dataLength);
+  datpHeader.SetDataLength (p->GetSize ());
+  m_sendEvent = Simulator::Schedule (m_interval, &DatpApplicationThree::Send, this);
+  if (Suppress (p, m_application))
+    return;
+  if (m_stampSequence)
+    datpHeader.SetSequence (m_sequence++);
   p->AddHeader (datpHeader);
   if ((m_socket->Send (p)) >= 0)
     {
       ++m_messagesSent;
       m_bytesSent += p->GetSize ();
     }
-  m_sendEvent = Simulator::Schedule (m_interval, &DatpApplicationThree::Send, this);
 }
 
 } // Namespace ns3
\ No newline at end of file
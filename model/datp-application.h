@@ -29,6 +29,7 @@
 #include "ns3/ptr.h"
 #include "ns3/ipv4-address.h"
 #include "ns3/random-variable-stream.h"
+#include "datp-dead-band.h"
 
 namespace ns3 {
 
@@ -36,6 +37,11 @@ namespace ns3 {
  * \ingroup Datp
  * \class DatpApplication
  * \brief Pure base class for Datp Applications
+ *
+ * With a Heartbeat set, a reading is only sent if it moved by more than the
+ * DeadBand from the last one sent, or the heartbeat went by (DatpDeadBand).
+ * With StampOrigin and StampSequence, aggregators can drop copies of a
+ * message that reach them twice (see the Dedup attribute of DatpAggregator).
  */
 class DatpApplication : public Application
 {
@@ -47,14 +53,23 @@ public:
   
   uint32_t GetMessagesSent (void);
   uint32_t GetBytesSent (void);
+  uint32_t GetMessagesSuppressed (void);
 
 protected:
   virtual void DoDispose (void);
+  /// \returns true if the reading in payload is not worth sending
+  bool Suppress (Ptr<const Packet> payload, uint8_t application);
+  /// Payload of dataLength bytes, or one record if application has a DatpPayloadSchema
+  Ptr<Packet> CreatePayload (uint8_t application, uint32_t dataLength);
   
   EventId m_sendEvent;
   uint32_t m_origin;
+  bool m_stampOrigin;
+  bool m_stampSequence;
+  uint32_t m_sequence;
   uint32_t m_messagesSent;
   uint32_t m_bytesSent;
+  uint32_t m_messagesSuppressed;
   Ptr<Socket> m_socket;
 
 private:
@@ -65,6 +80,9 @@ private:
   Ipv4Address m_peerAddress;
   uint16_t m_peerPort;
   Ptr<UniformRandomVariable> m_uniformRandomVariable; 
+  uint32_t m_deadBand;
+  Time m_heartbeat;
+  DatpDeadBand m_suppressor;
 };
 
 
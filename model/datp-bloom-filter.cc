@@ -0,0 +1,124 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "datp-bloom-filter.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+
+NS_LOG_COMPONENT_DEFINE ("DatpBloomFilter");
+
+namespace ns3 {
+
+namespace {
+
+/// SplitMix64 finalizer, spreads the bits of a key over the whole word
+uint64_t
+Mix (uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+} // anonymous namespace
+
+DatpBloomFilter::DatpBloomFilter ()
+{
+  NS_LOG_FUNCTION (this);
+  SetCapacity (1024, 10);
+}
+
+void
+DatpBloomFilter::SetCapacity (uint32_t capacity, uint32_t bitsPerEntry)
+{
+  NS_LOG_FUNCTION (this << capacity << bitsPerEntry);
+  NS_ASSERT (capacity > 0 && bitsPerEntry > 0);
+  m_capacity = capacity;
+  //k = bits per entry * ln 2 minimizes false positives
+  m_nHashes = (bitsPerEntry * 693 + 500) / 1000;
+  if (m_nHashes == 0)
+    m_nHashes = 1;
+  m_nBits = ((uint64_t) capacity * bitsPerEntry + 63) / 64 * 64;
+  m_current.assign (m_nBits / 64, 0);
+  m_previous.assign (m_nBits / 64, 0);
+  m_nEntries = 0;
+}
+
+uint32_t
+DatpBloomFilter::GetCapacity (void) const
+{
+  return m_capacity;
+}
+
+void
+DatpBloomFilter::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_current.assign (m_current.size (), 0);
+  m_previous.assign (m_previous.size (), 0);
+  m_nEntries = 0;
+}
+
+bool
+DatpBloomFilter::Test (std::vector<uint64_t> const &bits, uint64_t hash1, uint64_t hash2) const
+{
+  for (uint32_t i = 0; i < m_nHashes; ++i)
+    {
+      uint64_t bit = (hash1 + i * hash2) % m_nBits;
+      if ((bits[bit / 64] & (1ULL << (bit % 64))) == 0)
+        return false;
+    }
+  return true;
+}
+
+void
+DatpBloomFilter::Set (std::vector<uint64_t> &bits, uint64_t hash1, uint64_t hash2)
+{
+  for (uint32_t i = 0; i < m_nHashes; ++i)
+    {
+      uint64_t bit = (hash1 + i * hash2) % m_nBits;
+      bits[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+bool
+DatpBloomFilter::Insert (uint64_t key)
+{
+  NS_LOG_FUNCTION (this << key);
+  //double hashing, the second hash is odd so it never degenerates
+  uint64_t hash1 = Mix (key);
+  uint64_t hash2 = Mix (hash1 ^ 0x9e3779b97f4a7c15ULL) | 1;
+  if (Test (m_current, hash1, hash2) || Test (m_previous, hash1, hash2))
+    return true;
+  if (m_nEntries == m_capacity)
+    {
+      m_previous.swap (m_current);
+      m_current.assign (m_current.size (), 0);
+      m_nEntries = 0;
+    }
+  Set (m_current, hash1, hash2);
+  ++m_nEntries;
+  return false;
+}
+
+} // namespace ns3
@@ -0,0 +1,68 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_BLOOM_FILTER_H__
+#define __DATP_BLOOM_FILTER_H__
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup datp
+ * \brief Rotating Bloom filter remembering the most recent keys seen
+ *
+ * Two generations of bits are kept.  Keys go into the current one, and once
+ * it holds Capacity keys it becomes the previous generation and the old
+ * previous one is cleared to take its place.  A key is reported as seen if
+ * either generation holds it, so the last Capacity keys at least are always
+ * remembered in bounded memory, 2 * Capacity * BitsPerEntry bits.  Keys may
+ * be falsely reported as seen, with a probability of about
+ * 0.6185 ^ BitsPerEntry per generation, never the other way around.
+ */
+class DatpBloomFilter
+{
+public:
+  DatpBloomFilter ();
+
+  /// Set the keys per generation and the bits per key, forgetting all keys
+  void SetCapacity (uint32_t capacity, uint32_t bitsPerEntry);
+  uint32_t GetCapacity (void) const;
+  /// \returns true if key was possibly seen before, else remembers it
+  bool Insert (uint64_t key);
+  /// Forget all keys
+  void Clear (void);
+
+private:
+  bool Test (std::vector<uint64_t> const &bits, uint64_t hash1, uint64_t hash2) const;
+  void Set (std::vector<uint64_t> &bits, uint64_t hash1, uint64_t hash2);
+
+  uint32_t m_capacity;
+  uint32_t m_nHashes;
+  uint64_t m_nBits;
+  uint32_t m_nEntries;
+  std::vector<uint64_t> m_current;
+  std::vector<uint64_t> m_previous;
+};
+
+} // namespace ns3
+
+#endif /* __DATP_BLOOM_FILTER_H__ */
@@ -20,6 +20,7 @@
 
 #include "ns3/log.h"
 #include "ns3/ipv4-address.h"
+#include "ns3/inet-socket-address.h"
 #include "ns3/ipv4.h"
 #include "ns3/uinteger.h"
 #include "ns3/assert.h"
@@ -27,6 +28,9 @@
 #include "ns3/names.h"
 #include "datp-headers.h"
 #include "datp-collector.h"
+#include "datp-function-compress.h"
+#include "datp-function-fusion.h"
+#include "datp-function-incremental.h"
 
 namespace ns3 {
 
@@ -65,6 +69,7 @@ DatpCollector::DatpCollector ()
   m_bytesMerged=0;
   m_delayMessage = Seconds (0.0);
   m_stream = 0;
+  m_headerContext = CreateObject<DatpHeaderContext> ();
 }
 
 DatpCollector::~DatpCollector ()
@@ -128,10 +133,27 @@ DatpCollector::PrintStream ()
     }    
 }
 
+std::vector<int64_t>
+DatpCollector::GetRunningTotal (uint8_t application) const
+{
+  std::vector<int64_t> total;
+  for (std::map<uint64_t,std::vector<int64_t> >::const_iterator it = m_totals.begin (); it != m_totals.end (); ++it)
+    {
+      if ((it->first & 0xff) != application)
+        continue;
+      if (total.size () < it->second.size ())
+        total.resize (it->second.size (), 0);
+      for (uint32_t w = 0; w < it->second.size (); ++w)
+        total[w] += it->second[w];
+    }
+  return total;
+}
+
 void
 DatpCollector::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
+  m_totals.clear ();
   Application::DoDispose ();
 }
 
@@ -181,40 +203,96 @@ DatpCollector::Receive (Ptr<Socket> socket)
       ++m_packetsReceived;
       m_bytesReceived += packet->GetSize ();
 
-      while (packet->GetSize () > 0)
+      Ipv4Address sender = InetSocketAddress::ConvertFrom (from).GetIpv4 ();
+      if (!m_headerView.Parse (packet, m_headerContext, sender))
         {
-          DatpHeader datpHeader;
-          uint8_t headerBytesRemoved = packet->RemoveHeader (datpHeader);
-          ++m_messagesReceived;
-
-          NS_ASSERT (packet->GetSize () >= (uint32_t)datpHeader.GetDataLength ()); //bad rest of packet, never should have bad packet in simulator!
-          
-          uint32_t i = 0;
-          uint32_t value = 0;
-          bool firstIteration2 = true;
-          DatpGenericApplicationDataHeader dataHeader;
-          while (i < datpHeader.GetDataLength ())
-            {
-              i+= packet->RemoveHeader (dataHeader);
-              if (!firstIteration2)
-                NS_ASSERT (value == dataHeader.GetValue ());  //value should not change per current function operations
-              else
-                firstIteration2 = false;
-              value = dataHeader.GetValue ();
-            }
-          
-          if (dataHeader.GetValue () > 0)
+          NS_LOG_WARN ("Dropping malformed packet");
+          continue;
+        }
+
+      for (uint32_t m = 0; m < m_headerView.GetNMessages (); ++m)
+        {
+          const DatpMessageDescriptor &message = m_headerView.GetMessage (m);
+          if (!(message.encodingFlags & DATP_HFF3_COMPRESSED))
             {
-              m_delayMessage += NanoSeconds ((Simulator::Now ().GetNanoSeconds () - datpHeader.GetTimestamp ()) * dataHeader.GetValue ());
-              m_messagesMerged += dataHeader.GetValue () -1;
-              m_bytesMerged += (datpHeader.GetDataLength () + headerBytesRemoved) * (dataHeader.GetValue () - 1);
+              CountMessage (m_headerView, m, sender.Get ());
+              continue;
             }
-          else
+          if (!DatpFunctionCompress::Unpack (m_codec, m_headerView.GetPayload (message), message.application, m_packed)
+              || m_packed.empty () || !m_packedView.Parse (Create<Packet> (&m_packed[0], m_packed.size ())))
             {
-              m_delayMessage += NanoSeconds (Simulator::Now ().GetNanoSeconds () - datpHeader.GetTimestamp ());
+              NS_LOG_WARN ("Dropping malformed compressed message");
+              continue;
             }
-      }
+          for (uint32_t p = 0; p < m_packedView.GetNMessages (); ++p)
+            CountMessage (m_packedView, p, sender.Get ());
+        }
+    }
+}
+
+void
+DatpCollector::CountMessage (DatpHeaderView const &view, uint32_t index, uint32_t sender)
+{
+  const DatpMessageDescriptor &message = view.GetMessage (index);
+  if (message.encodingFlags & DATP_HFF3_FUSED)
+    {
+      CountFused (view, index, sender);
+      return;
+    }
+  ++m_messagesReceived;
+
+  //readings as sent are snapshots of their total, sketches and quantized ones are not
+  if (!(message.sizeModifiers & DATP_HFF2_SKETCH) && !(message.encodingFlags & DATP_HFF3_QUANTIZED)
+      && !DatpFunctionIncremental::ApplyReport (view.GetPayload (index), message.encodingFlags & DATP_HFF3_DELTA,
+                                                m_totals[((uint64_t) sender << 8) | message.application]))
+    NS_LOG_WARN ("Malformed report of application " << (uint32_t) message.application << " from " << Ipv4Address (sender));
+
+  //typed and sketch functions send the count of readings they reduced,
+  //the simple function repeats it in every payload word
+  uint32_t value = 0;
+  if ((message.sizeModifiers & (DATP_HFF2_COUNT | DATP_HFF2_SKETCH)) || (message.encodingFlags & (DATP_HFF3_QUANTIZED | DATP_HFF3_DELTA)))
+    value = message.count;
+  else
+    {
+      uint32_t nValues = message.dataLength / 4;
+      for (uint32_t i = 0; i < nValues; ++i)
+        {
+          if (i > 0)
+            NS_ASSERT (value == view.ReadPayloadU32 (index, i));  //value should not change per current function operations
+          value = view.ReadPayloadU32 (index, i);
+        }
+    }
+
+  if (value > 0)
+    {
+      m_delayMessage += NanoSeconds ((Simulator::Now ().GetNanoSeconds () - message.timestamp) * value);
+      m_messagesMerged += value -1;
+      m_bytesMerged += (message.dataLength + message.headerSize) * (value - 1);
+    }
+  else
+    {
+      m_delayMessage += NanoSeconds (Simulator::Now ().GetNanoSeconds () - message.timestamp);
+    }
+}
+
+void
+DatpCollector::CountFused (DatpHeaderView const &view, uint32_t index, uint32_t sender)
+{
+  if (!DatpFunctionFusion::Unpack (view.GetHeader (index), view.GetPayload (index), m_fusedHeaders, m_fusedPayloads))
+    {
+      NS_LOG_WARN ("Dropping malformed fused message");
+      return;
+    }
+  m_fusedBuilder.Clear ();
+  for (uint32_t r = 0; r < m_fusedHeaders.size (); ++r)
+    m_fusedBuilder.AddMessage (m_fusedHeaders[r], m_fusedPayloads[r]);
+  if (!m_fusedView.Parse (m_fusedBuilder.Build ()))
+    {
+      NS_LOG_WARN ("Dropping malformed fused message");
+      return;
     }
+  for (uint32_t r = 0; r < m_fusedView.GetNMessages (); ++r)
+    CountMessage (m_fusedView, r, sender);
 }
 
 void
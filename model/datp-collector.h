@@ -27,6 +27,12 @@
 #include "ns3/packet.h"
 #include "ns3/nstime.h"
 #include "ns3/output-stream-wrapper.h"
+#include "datp-header-view.h"
+#include "datp-header-context.h"
+#include "datp-lz-codec.h"
+#include "datp-packet-builder.h"
+#include <vector>
+#include <map>
 
 namespace ns3 {
 
@@ -34,6 +40,10 @@ namespace ns3 {
  * \ingroup datp
  * \class DatpCollector
  * \brief Datp collector
+ *
+ * Besides the statistics, the collector keeps the running total of every
+ * sender and application, as DatpFunctionIncremental reports it: a snapshot
+ * replaces it, a delta adds to it (GetRunningTotal).
  */
 class DatpCollector : public Application
 {
@@ -43,6 +53,8 @@ public:
   virtual ~DatpCollector ();
   void SetStream (Ptr<OutputStreamWrapper> stream);
   void PrintStream ();
+  /// Running total of application, the sum over its senders of their last snapshot and the deltas since
+  std::vector<int64_t> GetRunningTotal (uint8_t application) const;
 
 protected:
   virtual void DoDispose (void);
@@ -54,12 +66,26 @@ private:
 
   void ReceiveProbe (Ptr<Socket> socket);
   void Receive (Ptr<Socket> socket);
+  /// Account for message index of view, received from sender, in the statistics and running totals
+  void CountMessage (DatpHeaderView const &view, uint32_t index, uint32_t sender);
+  /// Account for the records fused into message index of view, as messages of their own
+  void CountFused (DatpHeaderView const &view, uint32_t index, uint32_t sender);
   
   Ptr<Socket> m_probe_socket;
   uint16_t m_probePort;
 
   Ptr<Socket> m_socket;
   uint16_t m_aggregatorPort;
+  DatpHeaderView m_headerView;
+  Ptr<DatpHeaderContext> m_headerContext;
+  DatpHeaderView m_packedView;     //messages unpacked from a compressed message
+  DatpLzCodec m_codec;
+  std::vector<uint8_t> m_packed;
+  DatpHeaderView m_fusedView;      //messages split from a fused message
+  DatpPacketBuilder m_fusedBuilder;
+  std::vector<DatpHeader> m_fusedHeaders;
+  std::vector<Ptr<Packet> > m_fusedPayloads;
+  std::map<uint64_t,std::vector<int64_t> > m_totals;   //sender and application, running total
   
   uint32_t m_packetsReceived;
   uint32_t m_messagesReceived;
@@ -0,0 +1,92 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "datp-dead-band.h"
+#include "datp-merge-kernel.h"
+#include "ns3/log.h"
+
+NS_LOG_COMPONENT_DEFINE ("DatpDeadBand");
+
+namespace ns3 {
+
+DatpDeadBand::DatpDeadBand ()
+  : m_deadBand (0),
+    m_heartbeat (Seconds (0.0))
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+DatpDeadBand::SetDeadBand (uint32_t deadBand)
+{
+  NS_LOG_FUNCTION (this << deadBand);
+  m_deadBand = deadBand;
+}
+
+void
+DatpDeadBand::SetHeartbeat (Time heartbeat)
+{
+  NS_LOG_FUNCTION (this << heartbeat);
+  m_heartbeat = heartbeat;
+}
+
+void
+DatpDeadBand::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_last.clear ();
+}
+
+bool
+DatpDeadBand::Pass (uint32_t origin, uint8_t application, Ptr<const Packet> payload, Time now)
+{
+  NS_LOG_FUNCTION (this << origin << (uint32_t) application << payload << now);
+  if (m_heartbeat.IsZero ())
+    return true;
+
+  //a trailing partial reading is zero padded
+  uint32_t size = payload->GetSize ();
+  m_readings.assign ((size + 3) / 4, 0);
+  if (size > 0)
+    payload->CopyData ((uint8_t *) &m_readings[0], size);
+  for (uint32_t r = 0; r < m_readings.size (); ++r)
+    m_readings[r] = DatpMergeKernel::NetworkToHost (m_readings[r]);
+
+  uint64_t key = ((uint64_t) origin << 8) | application;
+  std::map<uint64_t,LastReadings>::iterator it = m_last.find (key);
+  bool pass = (it == m_last.end () || now - it->second.sent >= m_heartbeat
+               || it->second.readings.size () != m_readings.size ());
+  for (uint32_t r = 0; !pass && r < m_readings.size (); ++r)
+    {
+      uint32_t last = it->second.readings[r];
+      pass = (m_readings[r] > last ? m_readings[r] - last : last - m_readings[r]) > m_deadBand;
+    }
+  if (!pass)
+    {
+      NS_LOG_LOGIC ("Suppressing origin " << origin << " application " << (uint32_t) application);
+      return false;
+    }
+  LastReadings &last = m_last[key];
+  last.sent = now;
+  last.readings.swap (m_readings);
+  return true;
+}
+
+} // namespace ns3
@@ -0,0 +1,70 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_DEAD_BAND_H__
+#define __DATP_DEAD_BAND_H__
+
+#include "ns3/packet.h"
+#include "ns3/nstime.h"
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup datp
+ * \brief Dead-band change suppression of the readings of a source
+ *
+ * Keeps the last payload let through per origin and application.  A new
+ * payload passes only if one of its 32 bit network order readings moved by
+ * more than the dead-band from the last one let through, its size changed,
+ * or the heartbeat went by since then.  So the readings a receiver holds
+ * never lag the source by more than the dead-band, and a silent source is
+ * still heard from once per heartbeat.  A zero heartbeat lets everything
+ * through.
+ */
+class DatpDeadBand
+{
+public:
+  DatpDeadBand ();
+
+  void SetDeadBand (uint32_t deadBand);
+  void SetHeartbeat (Time heartbeat);
+  /// \returns true if payload is to be sent, it then becomes the last payload of origin and application
+  bool Pass (uint32_t origin, uint8_t application, Ptr<const Packet> payload, Time now);
+  /// Forget the last payloads
+  void Clear (void);
+
+private:
+  struct LastReadings
+  {
+    Time sent;
+    std::vector<uint32_t> readings;
+  };
+
+  uint32_t m_deadBand;
+  Time m_heartbeat;
+  std::map<uint64_t,LastReadings> m_last;
+  std::vector<uint32_t> m_readings;
+};
+
+} // namespace ns3
+
+#endif /* __DATP_DEAD_BAND_H__ */
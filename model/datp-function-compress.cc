@@ -0,0 +1,180 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "datp-function-compress.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/boolean.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DatpFunctionCompress");
+
+NS_OBJECT_ENSURE_REGISTERED (DatpFunctionCompress);
+
+TypeId DatpFunctionCompress::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFunctionCompress")
+    .SetParent<DatpFunction> ()
+    .AddConstructor<DatpFunctionCompress> ()
+    .AddAttribute ("UseDictionary",
+                   "Compress with the dictionary of the application, if DatpLzCodec has one",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&DatpFunctionCompress::m_useDictionary),
+                   MakeBooleanChecker ())
+  ;
+  return tid;
+}
+
+DatpFunctionCompress::DatpFunctionCompress ()
+  : m_useDictionary (true)
+{
+  NS_LOG_FUNCTION (this);
+  m_builder.SetBundleHeaders (true);
+}
+
+DatpFunctionCompress::~DatpFunctionCompress()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void 
+DatpFunctionCompress::ReceiveNewMessage (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  uint32_t existing = LookupMergePartner (handle);
+  if (existing != 0)
+    {
+      NS_LOG_INFO ("Packing Id: " << handle << " with Id: " << existing);
+      m_messageStore->AddToGroup (existing, handle);
+      NotifyExistingMessage (existing);
+    }
+  else
+    {
+      NS_LOG_INFO ("We got a new message with Id: " << handle);
+      NotifyNewMessage (handle);
+    }
+}
+
+void
+DatpFunctionCompress::Reduce (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  if (!m_messageStore->TakeGroup (handle, m_members))
+    return;
+
+  m_builder.Clear ();
+  AddMessages (handle);
+  for (std::vector<uint32_t>::const_iterator it = m_members.begin (); it != m_members.end (); ++it)
+    {
+      AddMessages (*it);
+      const DatpMessage &message = m_messageStore->Get (*it);
+      m_messagesMerged++;
+      m_bytesMerged += message.payload->GetSize () + message.headerSize;
+      m_messageStore->Remove (*it);
+    }
+  uint32_t count = m_builder.GetNMessages ();
+  Ptr<Packet> messages = m_builder.Build ();
+  m_buffer.resize (messages->GetSize ());
+  messages->CopyData (&m_buffer[0], m_buffer.size ());
+
+  DatpMessage &head = m_messageStore->Get (handle);
+  head.payload = Pack (m_codec, m_buffer, head.application, m_useDictionary);
+  head.sizeModifiers = 0;
+  head.encodingFlags = DATP_HFF3_COMPRESSED;
+  head.count = count;
+  NS_LOG_INFO ("Packed " << count << " messages, " << m_buffer.size () << " bytes into " << head.payload->GetSize ());
+}
+
+void
+DatpFunctionCompress::AddMessages (uint32_t handle)
+{
+  const DatpMessage &message = m_messageStore->Get (handle);
+  if (!message.IsCompressed ())
+    {
+      m_builder.AddMessage (m_messageStore->GetHeader (handle), message.payload);
+      return;
+    }
+  if (!Unpack (m_codec, message.payload, message.application, m_buffer) || m_buffer.empty ()
+      || !m_view.Parse (Create<Packet> (&m_buffer[0], m_buffer.size ())))
+    {
+      NS_LOG_WARN ("Dropping malformed compressed message Id: " << handle);
+      return;
+    }
+  for (uint32_t m = 0; m < m_view.GetNMessages (); ++m)
+    m_builder.AddMessage (m_view.GetHeader (m), m_view.GetPayload (m));
+}
+
+Ptr<Packet>
+DatpFunctionCompress::Pack (DatpLzCodec &codec, std::vector<uint8_t> const &messages,
+                            uint8_t application, bool useDictionary)
+{
+  static const std::string none;
+  const std::string &dictionary = useDictionary ? DatpLzCodec::GetDictionary (application) : none;
+  uint32_t size = messages.size ();
+  std::vector<uint8_t> payload (1 + DatpHeader::GetVarintSize (size));
+  payload[0] = dictionary.empty () ? 0 : DATP_COMPRESS_DICTIONARY;
+  DatpHeader::WriteVarint (&payload[1], size);
+  uint32_t start = payload.size ();
+  if (size == 0 || codec.Compress (&messages[0], size, dictionary, payload) >= size)
+    {
+      payload.resize (start);
+      payload[0] = DATP_COMPRESS_STORED;
+      payload.insert (payload.end (), messages.begin (), messages.end ());
+    }
+  return Create<Packet> (&payload[0], payload.size ());
+}
+
+bool
+DatpFunctionCompress::Unpack (DatpLzCodec &codec, Ptr<const Packet> payload, uint8_t application,
+                              std::vector<uint8_t> &messages)
+{
+  static const std::string none;
+  uint32_t size = payload->GetSize ();
+  if (size < 2)
+    return false;
+  std::vector<uint8_t> bytes (size);
+  payload->CopyData (&bytes[0], size);
+  uint8_t flags = bytes[0];
+  uint64_t rawSize;
+  uint32_t read = DatpHeader::ReadVarint (&bytes[1], size - 1, rawSize);
+  if (read == 0)
+    return false;
+  uint32_t start = 1 + read;
+  if (flags & DATP_COMPRESS_STORED)
+    {
+      if (size - start != rawSize)
+        return false;
+      messages.assign (bytes.begin () + start, bytes.end ());
+      return true;
+    }
+  //a match adds at most 255 bytes per byte of block, anything larger is bogus
+  if (rawSize > (uint64_t) (size - start) * 255)
+    return false;
+  const std::string &dictionary = (flags & DATP_COMPRESS_DICTIONARY) ? DatpLzCodec::GetDictionary (application) : none;
+  if ((flags & DATP_COMPRESS_DICTIONARY) && dictionary.empty ())
+    {
+      NS_LOG_WARN ("No dictionary for application " << (uint32_t) application);
+      return false;
+    }
+  return codec.Decompress (&bytes[start], size - start, dictionary, rawSize, messages);
+}
+
+} // namespace ns3
@@ -0,0 +1,87 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_FUNCTION_COMPRESS_H__
+#define __DATP_FUNCTION_COMPRESS_H__
+
+#include "datp-function.h"
+#include "datp-lz-codec.h"
+#include "datp-packet-builder.h"
+#include "datp-header-view.h"
+#include <vector>
+
+namespace ns3 {
+
+#define DATP_COMPRESS_DICTIONARY 1   //!< compressed payload flag, the application dictionary was used
+#define DATP_COMPRESS_STORED 2       //!< compressed payload flag, the messages are stored as is
+
+/**
+ * \ingroup datp
+ * \brief Packs the messages of an application into one compressed message
+ *
+ * Messages of the same merge key that meet while buffered are kept aside
+ * and, when the first of them is ejected, written back to back as a bundle
+ * encoded Datp packet which is compressed with DatpLzCodec.  Nothing is
+ * lost: the result replaces the payload of the first message, flagged with
+ * DATP_HFF3_COMPRESSED, and its count is the number of messages inside.
+ * The payload is a flags byte (DATP_COMPRESS_*), the varint size of the
+ * messages and the LZ block, or the messages themselves when compressing
+ * does not pay.  A compressed message meeting others on a later hop is
+ * unpacked and packed again with them.  A DatpCollector unpacks it.
+ */
+class DatpFunctionCompress : public DatpFunction
+{
+public:
+  static TypeId GetTypeId (void);
+
+  DatpFunctionCompress ();
+  virtual ~DatpFunctionCompress ();
+
+  virtual void ReceiveNewMessage (uint32_t handle);
+  virtual void Reduce (uint32_t handle);
+
+  /**
+   * \brief Compress messages, a Datp packet, into a compressed message payload
+   * \param application selects the dictionary, if useDictionary and there is one
+   */
+  static Ptr<Packet> Pack (DatpLzCodec &codec, std::vector<uint8_t> const &messages,
+                           uint8_t application, bool useDictionary);
+  /**
+   * \brief Recover the messages packed in the payload of a compressed message
+   * \returns false if the payload is malformed
+   */
+  static bool Unpack (DatpLzCodec &codec, Ptr<const Packet> payload, uint8_t application,
+                      std::vector<uint8_t> &messages);
+
+private:
+  /// Queue the message of handle, or the messages packed into it, on m_builder
+  void AddMessages (uint32_t handle);
+
+  bool m_useDictionary;
+  DatpLzCodec m_codec;
+  DatpPacketBuilder m_builder;
+  DatpHeaderView m_view;
+  std::vector<uint32_t> m_members;
+  std::vector<uint8_t> m_buffer;
+};
+
+} // namespace ns3
+
+#endif /* __DATP_FUNCTION_COMPRESS_H__ */
@@ -0,0 +1,114 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "datp-function-dead-band.h"
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DatpFunctionDeadBand");
+
+NS_OBJECT_ENSURE_REGISTERED (DatpFunctionDeadBand);
+
+TypeId DatpFunctionDeadBand::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFunctionDeadBand")
+    .SetParent<DatpFunction> ()
+    .AddConstructor<DatpFunctionDeadBand> ()
+    .AddAttribute ("DeadBand",
+                   "Largest change of a reading that is not forwarded",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&DatpFunctionDeadBand::SetDeadBand,
+                                         &DatpFunctionDeadBand::GetDeadBand),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Heartbeat",
+                   "Longest time a source goes unheard of, zero forwards every message",
+                   TimeValue (Seconds (10.0)),
+                   MakeTimeAccessor (&DatpFunctionDeadBand::SetHeartbeat,
+                                     &DatpFunctionDeadBand::GetHeartbeat),
+                   MakeTimeChecker ())
+  ;
+  return tid;
+}
+
+DatpFunctionDeadBand::DatpFunctionDeadBand ()
+  : m_deadBand (0),
+    m_heartbeat (Seconds (10.0))
+{
+  NS_LOG_FUNCTION (this);
+  m_filter.SetHeartbeat (m_heartbeat);
+}
+
+DatpFunctionDeadBand::~DatpFunctionDeadBand()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+DatpFunctionDeadBand::SetDeadBand (uint32_t deadBand)
+{
+  m_deadBand = deadBand;
+  m_filter.SetDeadBand (deadBand);
+}
+
+uint32_t
+DatpFunctionDeadBand::GetDeadBand (void) const
+{
+  return m_deadBand;
+}
+
+void
+DatpFunctionDeadBand::SetHeartbeat (Time heartbeat)
+{
+  m_heartbeat = heartbeat;
+  m_filter.SetHeartbeat (heartbeat);
+}
+
+Time
+DatpFunctionDeadBand::GetHeartbeat (void) const
+{
+  return m_heartbeat;
+}
+
+void 
+DatpFunctionDeadBand::ReceiveNewMessage (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  const DatpMessage &message = m_messageStore->Get (handle);
+  //without its origin a reading cannot be told from those of other sources,
+  //an aggregate is no reading of its origin at all, both go on unfiltered
+  if (!(message.hff&64) || message.count > 1 || !message.IsPlain () || message.IsWindow ())
+    {
+      NotifyNewMessage (handle);
+      return;
+    }
+  if (m_filter.Pass (message.origin, message.application, message.payload, message.receiveTime))
+    {
+      NotifyNewMessage (handle);
+      return;
+    }
+  NS_LOG_INFO ("Suppressing Id: " << handle);
+  m_messagesMerged++;
+  m_bytesMerged += message.payload->GetSize () + message.headerSize;
+  m_messageStore->Remove (handle);
+}
+
+} // namespace ns3
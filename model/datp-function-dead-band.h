@@ -0,0 +1,65 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_FUNCTION_DEAD_BAND_H__
+#define __DATP_FUNCTION_DEAD_BAND_H__
+
+#include "datp-function.h"
+#include "datp-dead-band.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup datp
+ * \brief Drops the messages that repeat the last readings of their source
+ *
+ * Meant for the first aggregator above sources that do not suppress their
+ * readings themselves (see the DeadBand attributes of DatpApplication).
+ * Messages passing the DatpDeadBand filter of their origin and application
+ * go on to the scheduler unmerged, the others are dropped and counted as
+ * merged.  Only plain readings carrying their origin are filtered, sources
+ * need to stamp it (StampOrigin); messages without one and aggregates of
+ * any kind (counted, sketched, compressed, quantized, delta, fused or
+ * windowed) pass unfiltered.
+ */
+class DatpFunctionDeadBand : public DatpFunction
+{
+public:
+  static TypeId GetTypeId (void);
+
+  DatpFunctionDeadBand ();
+  virtual ~DatpFunctionDeadBand ();
+
+  virtual void ReceiveNewMessage (uint32_t handle);
+
+private:
+  void SetDeadBand (uint32_t deadBand);
+  uint32_t GetDeadBand (void) const;
+  void SetHeartbeat (Time heartbeat);
+  Time GetHeartbeat (void) const;
+
+  uint32_t m_deadBand;
+  Time m_heartbeat;
+  DatpDeadBand m_filter;
+};
+
+} // namespace ns3
+
+#endif /* __DATP_FUNCTION_DEAD_BAND_H__ */
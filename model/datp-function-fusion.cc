@@ -0,0 +1,193 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "datp-function-fusion.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DatpFunctionFusion");
+
+NS_OBJECT_ENSURE_REGISTERED (DatpFunctionFusion);
+
+TypeId DatpFunctionFusion::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFunctionFusion")
+    .SetParent<DatpFunction> ()
+    .AddConstructor<DatpFunctionFusion> ()
+    .AddAttribute ("Window",
+                   "Largest difference of the timestamps of the messages fused into one record",
+                   TimeValue (MilliSeconds (50)),
+                   MakeTimeAccessor (&DatpFunctionFusion::m_window),
+                   MakeTimeChecker ())
+  ;
+  return tid;
+}
+
+DatpFunctionFusion::DatpFunctionFusion ()
+  : m_window (MilliSeconds (50))
+{
+  NS_LOG_FUNCTION (this);
+}
+
+DatpFunctionFusion::~DatpFunctionFusion ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+bool
+DatpFunctionFusion::IsFusable (DatpMessage const &message)
+{
+  return (message.hff & (64|8)) == (64|8) && message.IsPlain ();
+}
+
+void 
+DatpFunctionFusion::ReceiveNewMessage (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  const DatpMessage &message = m_messageStore->Get (handle);
+  if (!IsFusable (message))
+    {
+      NotifyNewMessage (handle);
+      return;
+    }
+
+  std::map<uint32_t,Head>::iterator it = m_heads.find (message.origin);
+  if (it != m_heads.end () && m_messageStore->Contains (it->second.handle))
+    {
+      Head &head = it->second;
+      const DatpMessage &existing = m_messageStore->Get (head.handle);
+      uint64_t apart = existing.timestamp > message.timestamp ? existing.timestamp - message.timestamp
+                                                              : message.timestamp - existing.timestamp;
+      if (existing.priority == message.priority
+          && !(head.applications[message.application / 8] & (1 << (message.application % 8)))
+          && apart <= (uint64_t) m_window.GetNanoSeconds ())
+        {
+          NS_LOG_INFO ("Fusing Id: " << handle << " of app " << (uint32_t) message.application
+                                     << " with Id: " << head.handle);
+          head.applications[message.application / 8] |= 1 << (message.application % 8);
+          m_messageStore->AddToGroup (head.handle, handle);
+          NotifyExistingMessage (head.handle);
+          return;
+        }
+    }
+
+  //later messages of the origin are fused into this one
+  NS_LOG_INFO ("We got a new message with Id: " << handle << " and app=" << (uint32_t) message.application);
+  Head &head = m_heads[message.origin];
+  head.handle = handle;
+  head.applications.assign (32, 0);
+  head.applications[message.application / 8] |= 1 << (message.application % 8);
+  NotifyNewMessage (handle);
+}
+
+void
+DatpFunctionFusion::Reduce (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  DatpMessage &head = m_messageStore->Get (handle);
+  std::map<uint32_t,Head>::iterator it = m_heads.find (head.origin);
+  if (it != m_heads.end () && it->second.handle == handle)
+    m_heads.erase (it);
+  if (!m_messageStore->TakeGroup (handle, m_members))
+    return;
+
+  //one record per application, in ascending order
+  std::map<uint8_t,uint32_t> records;
+  records[head.application] = handle;
+  for (std::vector<uint32_t>::const_iterator member = m_members.begin (); member != m_members.end (); ++member)
+    records[m_messageStore->Get (*member).application] = *member;
+  uint32_t bitmapSize = records.rbegin ()->first / 8 + 1;
+  uint32_t size = 1 + bitmapSize;
+  for (std::map<uint8_t,uint32_t>::const_iterator record = records.begin (); record != records.end (); ++record)
+    size += 3 * 10 + m_messageStore->Get (record->second).payload->GetSize ();
+  m_buffer.assign (size, 0);
+  size = DatpHeader::WriteVarint (&m_buffer[0], bitmapSize);
+  for (std::map<uint8_t,uint32_t>::const_iterator record = records.begin (); record != records.end (); ++record)
+    m_buffer[size + record->first / 8] |= 1 << (record->first % 8);
+  size += bitmapSize;
+  for (std::map<uint8_t,uint32_t>::const_iterator record = records.begin (); record != records.end (); ++record)
+    {
+      const DatpMessage &message = m_messageStore->Get (record->second);
+      uint32_t length = message.payload->GetSize ();
+      size += DatpHeader::WriteVarint (&m_buffer[size], DatpHeader::EncodeZigZag ((int64_t) (message.timestamp - head.timestamp)));
+      size += DatpHeader::WriteVarint (&m_buffer[size], message.count);
+      size += DatpHeader::WriteVarint (&m_buffer[size], length);
+      message.payload->CopyData (&m_buffer[size], length);
+      size += length;
+    }
+
+  for (std::vector<uint32_t>::const_iterator member = m_members.begin (); member != m_members.end (); ++member)
+    {
+      const DatpMessage &message = m_messageStore->Get (*member);
+      m_messagesMerged++;
+      m_bytesMerged += message.payload->GetSize () + message.headerSize;
+      m_messageStore->Remove (*member);
+    }
+  head.payload = Create<Packet> (&m_buffer[0], size);
+  head.encodingFlags |= DATP_HFF3_FUSED;
+  head.count = records.size ();
+  NS_LOG_INFO ("Fused " << records.size () << " records into " << size << " bytes");
+}
+
+bool
+DatpFunctionFusion::Unpack (DatpHeader const &fused, Ptr<const Packet> payload,
+                            std::vector<DatpHeader> &headers, std::vector<Ptr<Packet> > &payloads)
+{
+  headers.clear ();
+  payloads.clear ();
+  uint32_t size = payload->GetSize ();
+  std::vector<uint8_t> bytes (size + 1);
+  payload->CopyData (&bytes[0], size);
+  uint64_t bitmapSize;
+  uint32_t offset = DatpHeader::ReadVarint (&bytes[0], size, bitmapSize);
+  if (offset == 0 || bitmapSize == 0 || bitmapSize > 32 || bitmapSize > size - offset)
+    return false;
+  uint32_t bitmap = offset;
+  offset += bitmapSize;
+  for (uint32_t application = 0; application < 8 * bitmapSize; ++application)
+    {
+      if (!(bytes[bitmap + application / 8] & (1 << (application % 8))))
+        continue;
+      uint64_t fields[3];
+      for (uint32_t f = 0; f < 3; ++f)
+        {
+          uint32_t read = DatpHeader::ReadVarint (&bytes[offset], size - offset, fields[f]);
+          if (read == 0)
+            return false;
+          offset += read;
+        }
+      if (fields[2] > size - offset)
+        return false;
+      DatpHeader datpHeader = fused;
+      datpHeader.SetFused (false);
+      datpHeader.SetApplication (application);
+      datpHeader.SetTimestamp (fused.GetTimestamp () + DatpHeader::DecodeZigZag (fields[0]));
+      datpHeader.SetCount (fields[1]);
+      datpHeader.SetDataLength (fields[2]);
+      headers.push_back (datpHeader);
+      payloads.push_back (Create<Packet> (&bytes[offset], fields[2]));
+      offset += fields[2];
+    }
+  return offset == size && !headers.empty ();
+}
+
+} // namespace ns3
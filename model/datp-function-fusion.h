@@ -0,0 +1,89 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_FUNCTION_FUSION_H__
+#define __DATP_FUNCTION_FUSION_H__
+
+#include "datp-function.h"
+#include "ns3/nstime.h"
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup datp
+ * \brief Fuses the messages of different applications of one origin into one record
+ *
+ * A message meeting a buffered message of the same origin and priority but
+ * of another application, timestamped at most Window apart, waits to be
+ * fused with it.  When the first of them is ejected, their payloads are
+ * written into its payload behind a single header, flagged with
+ * DATP_HFF3_FUSED, and its count is the number of records inside.
+ *
+ * The payload is a presence bitmap, a varint byte count followed by one
+ * bit per application (bit a % 8 of byte a / 8), then one record per
+ * application present in ascending order: the zigzag varint offset of its
+ * timestamp from that of the header, its varint count and length, and its
+ * payload.  The other header fields, sequence included, are those of the
+ * first message.  Only messages stamped with their origin (StampOrigin)
+ * and timestamp are fused, others, and sketch, compressed, quantized and
+ * delta ones, go on as they are.  A DatpCollector splits the records back
+ * into messages.  Above the fusing aggregator, fused messages should only
+ * meet functions that leave them alone, such as DatpFunctionCompress.
+ */
+class DatpFunctionFusion : public DatpFunction
+{
+public:
+  static TypeId GetTypeId (void);
+
+  DatpFunctionFusion ();
+  virtual ~DatpFunctionFusion ();
+
+  virtual void ReceiveNewMessage (uint32_t handle);
+  virtual void Reduce (uint32_t handle);
+
+  /**
+   * \brief Split the payload of a fused message back into messages
+   * \param fused the header of the fused message, the other fields are copied from it
+   * \returns false if the payload is malformed
+   */
+  static bool Unpack (DatpHeader const &fused, Ptr<const Packet> payload,
+                      std::vector<DatpHeader> &headers, std::vector<Ptr<Packet> > &payloads);
+
+private:
+  struct Head
+  {
+    uint32_t handle;
+    std::vector<uint8_t> applications;  //!< presence bitmap of the messages waiting to be fused
+  };
+
+  /// Whether message may be fused with others at all
+  static bool IsFusable (DatpMessage const &message);
+
+  Time m_window;
+  std::map<uint32_t,Head> m_heads;      //!< buffered message of each origin others are fused into
+  std::vector<uint32_t> m_members;
+  std::vector<uint8_t> m_buffer;
+};
+
+} // namespace ns3
+
+#endif /* __DATP_FUNCTION_FUSION_H__ */
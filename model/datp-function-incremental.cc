@@ -0,0 +1,289 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "datp-function-incremental.h"
+#include "datp-merge-kernel.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/uinteger.h"
+#include "ns3/simulator.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DatpFunctionIncremental");
+
+NS_OBJECT_ENSURE_REGISTERED (DatpFunctionIncremental);
+
+TypeId DatpFunctionIncremental::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFunctionIncremental")
+    .SetParent<DatpFunction> ()
+    .AddConstructor<DatpFunctionIncremental> ()
+    .AddAttribute ("Threshold",
+                   "Largest change of a word of the total that is not reported",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&DatpFunctionIncremental::m_threshold),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("SnapshotInterval",
+                   "Longest time between two full snapshots of a total, zero only sends them after a parent change",
+                   TimeValue (Seconds (0.0)),
+                   MakeTimeAccessor (&DatpFunctionIncremental::m_snapshotInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("ContributionTimeout",
+                   "Time the contribution of a child is kept without hearing from it, zero keeps it forever",
+                   TimeValue (Seconds (5.0)),
+                   MakeTimeAccessor (&DatpFunctionIncremental::m_contributionTimeout),
+                   MakeTimeChecker ())
+  ;
+  return tid;
+}
+
+DatpFunctionIncremental::DatpFunctionIncremental ()
+  : m_threshold (0),
+    m_snapshotInterval (Seconds (0.0)),
+    m_contributionTimeout (Seconds (5.0))
+{
+  NS_LOG_FUNCTION (this);
+}
+
+DatpFunctionIncremental::~DatpFunctionIncremental ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+Ptr<Packet>
+DatpFunctionIncremental::EncodeDelta (std::vector<int64_t> const &words)
+{
+  std::vector<uint8_t> buffer (10 * (words.size () + 1));
+  uint32_t size = DatpHeader::WriteVarint (&buffer[0], words.size ());
+  for (uint32_t w = 0; w < words.size (); ++w)
+    size += DatpHeader::WriteVarint (&buffer[size], DatpHeader::EncodeZigZag (words[w]));
+  return Create<Packet> (&buffer[0], size);
+}
+
+bool
+DatpFunctionIncremental::DecodeDelta (Ptr<const Packet> payload, std::vector<int64_t> &words)
+{
+  uint32_t size = payload->GetSize ();
+  std::vector<uint8_t> buffer (size + 1);
+  payload->CopyData (&buffer[0], size);
+  uint64_t value;
+  uint32_t offset = DatpHeader::ReadVarint (&buffer[0], size, value);
+  //every word takes at least a byte
+  if (offset == 0 || value > size - offset)
+    return false;
+  words.resize (value);
+  for (uint32_t w = 0; w < words.size (); ++w)
+    {
+      uint32_t read = DatpHeader::ReadVarint (&buffer[offset], size - offset, value);
+      if (read == 0)
+        return false;
+      offset += read;
+      words[w] = DatpHeader::DecodeZigZag (value);
+    }
+  return offset == size;
+}
+
+bool
+DatpFunctionIncremental::ApplyReport (Ptr<const Packet> payload, bool delta, std::vector<int64_t> &total)
+{
+  std::vector<int64_t> words;
+  if (delta)
+    {
+      if (!DecodeDelta (payload, words))
+        return false;
+      if (total.size () < words.size ())
+        total.resize (words.size (), 0);
+      for (uint32_t w = 0; w < words.size (); ++w)
+        total[w] += words[w];
+      return true;
+    }
+  uint32_t size = payload->GetSize ();
+  if (size % 4 != 0)
+    return false;
+  std::vector<uint32_t> raw (size / 4 + 1);
+  payload->CopyData ((uint8_t *) &raw[0], size);
+  total.resize (size / 4);
+  for (uint32_t w = 0; w < total.size (); ++w)
+    total[w] = DatpMergeKernel::NetworkToHost (raw[w]);
+  return true;
+}
+
+bool
+DatpFunctionIncremental::Update (KeyState &state, DatpMessage const &message)
+{
+  NS_LOG_FUNCTION (this << message.sender);
+  if (message.IsDelta ())
+    {
+      if (!DecodeDelta (message.payload, m_words))
+        return false;
+    }
+  else
+    {
+      uint32_t size = message.payload->GetSize ();
+      if (size % 4 != 0)
+        return false;
+      std::vector<uint32_t> raw (size / 4 + 1);
+      message.payload->CopyData ((uint8_t *) &raw[0], size);
+      m_words.resize (size / 4);
+      for (uint32_t w = 0; w < m_words.size (); ++w)
+        m_words[w] = DatpMergeKernel::NetworkToHost (raw[w]);
+    }
+
+  //a delta from a sender we hold nothing of applies to zero, until its next snapshot
+  Contribution &contribution = state.contributions[message.sender];
+  contribution.heard = message.receiveTime;
+  if (state.total.size () < m_words.size ())
+    state.total.resize (m_words.size (), 0);
+  if (contribution.words.size () < m_words.size ())
+    contribution.words.resize (m_words.size (), 0);
+  for (uint32_t w = 0; w < contribution.words.size (); ++w)
+    {
+      int64_t word = w < m_words.size () ? m_words[w] : 0;
+      int64_t updated = message.IsDelta () ? contribution.words[w] + word : word;
+      state.total[w] += updated - contribution.words[w];
+      contribution.words[w] = updated;
+    }
+  return true;
+}
+
+void
+DatpFunctionIncremental::Expire (KeyState &state, Time now)
+{
+  if (m_contributionTimeout.IsZero ())
+    return;
+  std::map<uint32_t,Contribution>::iterator it = state.contributions.begin ();
+  while (it != state.contributions.end ())
+    {
+      if (now - it->second.heard > m_contributionTimeout)
+        {
+          NS_LOG_INFO ("Expiring the contribution of " << it->first);
+          for (uint32_t w = 0; w < it->second.words.size (); ++w)
+            state.total[w] -= it->second.words[w];
+          state.contributions.erase (it++);
+        }
+      else
+        ++it;
+    }
+}
+
+bool
+DatpFunctionIncremental::IsReportDue (KeyState const &state) const
+{
+  if (!state.synced)
+    return true;
+  if (!m_snapshotInterval.IsZero () && Simulator::Now () - state.lastSnapshot >= m_snapshotInterval)
+    return true;
+  if (state.total.size () != state.reported.size ())
+    return true;
+  for (uint32_t w = 0; w < state.total.size (); ++w)
+    {
+      int64_t change = state.total[w] - state.reported[w];
+      if (change > (int64_t) m_threshold || -change > (int64_t) m_threshold)
+        return true;
+    }
+  return false;
+}
+
+void 
+DatpFunctionIncremental::ReceiveNewMessage (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  DatpMessage &message = m_messageStore->Get (handle);
+  KeyState &state = m_keys[m_messageStore->GetMergeKey (handle)];
+  if (!Update (state, message))
+    {
+      NS_LOG_WARN ("Dropping malformed message Id: " << handle);
+      m_messageStore->Remove (handle);
+      return;
+    }
+  Expire (state, message.receiveTime);
+
+  if (state.carrier != 0 && m_messageStore->Contains (state.carrier))
+    {
+      //the report already waiting will carry the change
+      DatpMessage &carrier = m_messageStore->Get (state.carrier);
+      carrier.count += message.count;
+      m_messagesMerged++;
+      m_bytesMerged += message.payload->GetSize () + message.headerSize;
+      m_messageStore->Remove (handle);
+      NotifyExistingMessage (state.carrier);
+      return;
+    }
+  if (!IsReportDue (state))
+    {
+      NS_LOG_INFO ("Total unchanged, suppressing Id: " << handle);
+      m_messagesMerged++;
+      m_bytesMerged += message.payload->GetSize () + message.headerSize;
+      m_messageStore->Remove (handle);
+      return;
+    }
+  state.carrier = handle;
+  NotifyNewMessage (handle);
+}
+
+void
+DatpFunctionIncremental::Reduce (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  std::map<uint64_t,KeyState>::iterator it = m_keys.find (m_messageStore->GetMergeKey (handle));
+  if (it == m_keys.end () || it->second.carrier != handle)
+    return;
+  KeyState &state = it->second;
+  DatpMessage &message = m_messageStore->Get (handle);
+  Time now = Simulator::Now ();
+  if (!state.synced || (!m_snapshotInterval.IsZero () && now - state.lastSnapshot >= m_snapshotInterval))
+    {
+      NS_LOG_INFO ("Sending a snapshot of " << state.total.size () << " words in Id: " << handle);
+      std::vector<uint32_t> raw (state.total.size () + 1);
+      for (uint32_t w = 0; w < state.total.size (); ++w)
+        {
+          int64_t word = state.total[w];
+          word = word < 0 ? 0 : (word > 0xffffffffLL ? 0xffffffffLL : word);
+          raw[w] = DatpMergeKernel::HostToNetwork ((uint32_t) word);
+        }
+      message.payload = Create<Packet> ((const uint8_t *) &raw[0], 4 * state.total.size ());
+      message.encodingFlags &= ~DATP_HFF3_DELTA;
+      state.synced = true;
+      state.lastSnapshot = now;
+    }
+  else
+    {
+      m_words.resize (state.total.size ());
+      for (uint32_t w = 0; w < m_words.size (); ++w)
+        m_words[w] = state.total[w] - (w < state.reported.size () ? state.reported[w] : 0);
+      message.payload = EncodeDelta (m_words);
+      message.encodingFlags |= DATP_HFF3_DELTA;
+      NS_LOG_INFO ("Sending a delta of " << message.payload->GetSize () << " bytes in Id: " << handle);
+    }
+  state.reported = state.total;
+  state.carrier = 0;
+}
+
+void
+DatpFunctionIncremental::NotifyParentChange (void)
+{
+  NS_LOG_FUNCTION (this);
+  //the new parent holds none of our totals
+  for (std::map<uint64_t,KeyState>::iterator it = m_keys.begin (); it != m_keys.end (); ++it)
+    it->second.synced = false;
+}
+
+} // namespace ns3
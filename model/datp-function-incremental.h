@@ -0,0 +1,107 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_FUNCTION_INCREMENTAL_H__
+#define __DATP_FUNCTION_INCREMENTAL_H__
+
+#include "datp-function.h"
+#include "ns3/nstime.h"
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup datp
+ * \brief Keeps a running subtree total per merge key and reports its changes
+ *
+ * The payload is an array of 32 bit unsigned readings in network order.
+ * Every child (told apart by the address its messages come from) holds one
+ * contribution per key, its latest readings, and the total of a key is the
+ * sum of the contributions.  A message either replaces the contribution of
+ * its sender, or, when it is a delta (DATP_HFF3_DELTA), is added to it.
+ *
+ * When a message leaves, it carries the change of the total since the last
+ * report as a delta: a varint word count followed by one zigzag varint per
+ * word.  Messages changing no word of the total by more than Threshold are
+ * dropped, so the upstream traffic follows the rate of change of the total
+ * rather than the rate of the readings.  A full snapshot is sent instead
+ * after a parent change, and every SnapshotInterval if it is not zero, to
+ * bound the drift left by lost deltas.  Contributions not heard of for
+ * ContributionTimeout are dropped from the total, so a child that moved to
+ * another parent stops counting here.
+ */
+class DatpFunctionIncremental : public DatpFunction
+{
+public:
+  static TypeId GetTypeId (void);
+
+  DatpFunctionIncremental ();
+  virtual ~DatpFunctionIncremental ();
+
+  virtual void ReceiveNewMessage (uint32_t handle);
+  virtual void Reduce (uint32_t handle);
+  virtual void NotifyParentChange (void);
+
+  /// Write a delta payload of words
+  static Ptr<Packet> EncodeDelta (std::vector<int64_t> const &words);
+  /// \returns false if payload is not a complete delta
+  static bool DecodeDelta (Ptr<const Packet> payload, std::vector<int64_t> &words);
+  /**
+   * \brief Apply a report to the running total of its key, as the receiver holds it
+   *
+   * A snapshot replaces total, a delta adds to it.
+   * \returns false if payload is malformed, total is then left as it was
+   */
+  static bool ApplyReport (Ptr<const Packet> payload, bool delta, std::vector<int64_t> &total);
+
+private:
+  struct Contribution
+  {
+    std::vector<int64_t> words;
+    Time heard;
+  };
+  struct KeyState
+  {
+    KeyState () : synced (false), carrier (0) {}
+    std::vector<int64_t> total;
+    std::vector<int64_t> reported;  //!< total the parent was last told of
+    bool synced;                    //!< the parent got a snapshot since it changed
+    Time lastSnapshot;
+    uint32_t carrier;               //!< buffered message the next report leaves in, 0 if none
+    std::map<uint32_t,Contribution> contributions;
+  };
+
+  /// Apply message to the contribution of its sender, \returns false if the payload is malformed
+  bool Update (KeyState &state, DatpMessage const &message);
+  /// Drop the contributions not heard of since now - ContributionTimeout
+  void Expire (KeyState &state, Time now);
+  bool IsReportDue (KeyState const &state) const;
+
+  uint32_t m_threshold;
+  Time m_snapshotInterval;
+  Time m_contributionTimeout;
+  std::map<uint64_t,KeyState> m_keys;
+  std::vector<int64_t> m_words;
+};
+
+} // namespace ns3
+
+#endif /* __DATP_FUNCTION_INCREMENTAL_H__ */
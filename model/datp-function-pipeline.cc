@@ -0,0 +1,160 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "datp-function-pipeline.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DatpFunctionPipeline");
+
+NS_OBJECT_ENSURE_REGISTERED (DatpFunctionPipeline);
+
+TypeId DatpFunctionPipeline::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFunctionPipeline")
+    .SetParent<DatpFunction> ()
+    .AddConstructor<DatpFunctionPipeline> ()
+  ;
+  return tid;
+}
+
+DatpFunctionPipeline::DatpFunctionPipeline ()
+  : m_messagesIn (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+DatpFunctionPipeline::~DatpFunctionPipeline()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+DatpFunctionPipeline::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  for (uint32_t s = 0; s < m_stages.size (); ++s)
+    m_stages[s]->Dispose ();
+  m_stages.clear ();
+  DatpFunction::DoDispose ();
+}
+
+void
+DatpFunctionPipeline::AddStage (Ptr<DatpFunction> function)
+{
+  NS_LOG_FUNCTION (this << function);
+  if (!m_stages.empty ())
+    m_stages.back ()->SetNewMessageCallback (MakeCallback (&DatpFunction::ReceiveNewMessage, function));
+  function->SetMergeLookupCallback (MakeCallback (&DatpFunctionPipeline::LookupMergeKey, this));
+  function->SetNewMessageCallback (MakeCallback (&DatpFunctionPipeline::ForwardNewMessage, this));
+  function->SetExistingMessageCallback (MakeCallback (&DatpFunctionPipeline::ForwardExistingMessage, this));
+  m_stages.push_back (function);
+}
+
+uint32_t
+DatpFunctionPipeline::GetNStages (void) const
+{
+  return m_stages.size ();
+}
+
+Ptr<DatpFunction>
+DatpFunctionPipeline::GetStage (uint32_t stage) const
+{
+  NS_ASSERT (stage < m_stages.size ());
+  return m_stages[stage];
+}
+
+uint32_t
+DatpFunctionPipeline::GetStageMessagesIn (uint32_t stage) const
+{
+  NS_ASSERT (stage < m_stages.size ());
+  return stage == 0 ? m_messagesIn : m_stages[stage - 1]->GetMessagesForwarded ();
+}
+
+double
+DatpFunctionPipeline::GetStageReductionRatio (uint32_t stage) const
+{
+  uint32_t messagesIn = GetStageMessagesIn (stage);
+  //a window stage hands on a copy per window, never report a negative reduction
+  if (messagesIn == 0 || m_stages[stage]->GetMessagesForwarded () >= messagesIn)
+    return 0.0;
+  return 1.0 - m_stages[stage]->GetMessagesForwarded () / (messagesIn * 1.0);
+}
+
+uint32_t
+DatpFunctionPipeline::GetMessagesMerged (void) const
+{
+  uint32_t messagesMerged = m_messagesMerged;
+  for (uint32_t s = 0; s < m_stages.size (); ++s)
+    messagesMerged += m_stages[s]->GetMessagesMerged ();
+  return messagesMerged;
+}
+
+uint32_t
+DatpFunctionPipeline::GetBytesMerged (void) const
+{
+  uint32_t bytesMerged = m_bytesMerged;
+  for (uint32_t s = 0; s < m_stages.size (); ++s)
+    bytesMerged += m_stages[s]->GetBytesMerged ();
+  return bytesMerged;
+}
+
+void 
+DatpFunctionPipeline::ReceiveNewMessage (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  ++m_messagesIn;
+  if (m_stages.empty ())
+    NotifyNewMessage (handle);
+  else
+    m_stages.front ()->ReceiveNewMessage (handle);
+}
+
+void
+DatpFunctionPipeline::Reduce (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  for (uint32_t s = 0; s < m_stages.size (); ++s)
+    m_stages[s]->Reduce (handle);
+}
+
+void
+DatpFunctionPipeline::NotifyParentChange (void)
+{
+  NS_LOG_FUNCTION (this);
+  for (uint32_t s = 0; s < m_stages.size (); ++s)
+    m_stages[s]->NotifyParentChange ();
+}
+
+void
+DatpFunctionPipeline::ForwardNewMessage (uint32_t handle)
+{
+  NotifyNewMessage (handle);
+}
+
+void
+DatpFunctionPipeline::ForwardExistingMessage (uint32_t handle)
+{
+  NotifyExistingMessage (handle);
+}
+
+} // namespace ns3
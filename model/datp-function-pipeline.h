@@ -0,0 +1,78 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_FUNCTION_PIPELINE_H__
+#define __DATP_FUNCTION_PIPELINE_H__
+
+#include "datp-function.h"
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup datp
+ * \brief Runs messages through an ordered list of functions
+ *
+ * Each stage hands the messages it lets through to the next one by handle,
+ * the payloads stay in the message store.  What the last stage lets through
+ * goes on to the scheduler.  All stages look merge partners up among the
+ * messages buffered by the scheduler, that went through every stage.  When
+ * a message leaves, every stage reduces it, in order.  Stage i reduces
+ * GetStageMessagesIn (i) messages to the GetMessagesForwarded () of its
+ * function.  The aggregator builds a pipeline from ApplicationFunctions
+ * entries with several types, e.g. "1=ns3::DatpFunctionDeadBand>ns3::DatpFunctionSum".
+ */
+class DatpFunctionPipeline : public DatpFunction
+{
+public:
+  static TypeId GetTypeId (void);
+
+  DatpFunctionPipeline ();
+  virtual ~DatpFunctionPipeline ();
+
+  /// Append function as the last stage, it needs the same message store
+  void AddStage (Ptr<DatpFunction> function);
+  uint32_t GetNStages (void) const;
+  Ptr<DatpFunction> GetStage (uint32_t stage) const;
+  /// Messages that reached stage
+  uint32_t GetStageMessagesIn (uint32_t stage) const;
+  /// Share of the messages reaching stage that it did not hand on as new, zero if it handed on more
+  double GetStageReductionRatio (uint32_t stage) const;
+
+  virtual void ReceiveNewMessage (uint32_t handle);
+  virtual void Reduce (uint32_t handle);
+  virtual void NotifyParentChange (void);
+  virtual uint32_t GetMessagesMerged (void) const;
+  virtual uint32_t GetBytesMerged (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  void ForwardNewMessage (uint32_t handle);
+  void ForwardExistingMessage (uint32_t handle);
+
+  std::vector<Ptr<DatpFunction> > m_stages;
+  uint32_t m_messagesIn;
+};
+
+} // namespace ns3
+
+#endif /* __DATP_FUNCTION_PIPELINE_H__ */
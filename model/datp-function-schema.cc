@@ -0,0 +1,103 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "datp-function-schema.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DatpFunctionSchema");
+
+NS_OBJECT_ENSURE_REGISTERED (DatpFunctionSchema);
+
+TypeId DatpFunctionSchema::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFunctionSchema")
+    .SetParent<DatpFunction> ()
+    .AddConstructor<DatpFunctionSchema> ()
+  ;
+  return tid;
+}
+
+DatpFunctionSchema::DatpFunctionSchema ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+DatpFunctionSchema::~DatpFunctionSchema ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+bool
+DatpFunctionSchema::Matches (DatpMessage const &message, const DatpPayloadSchema *schema)
+{
+  uint32_t size = message.payload->GetSize ();
+  return schema != 0 && !message.IsSketch () && !message.IsCompressed () && !message.IsFused ()
+         && size > 0 && size % schema->GetSize () == 0;
+}
+
+void
+DatpFunctionSchema::ReceiveNewMessage (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  DatpMessage &message = m_messageStore->Get (handle);
+  const DatpPayloadSchema *schema = DatpPayloadSchema::Lookup (message.application);
+  uint32_t existingHandle = Matches (message, schema) ? LookupMergePartner (handle) : 0;
+  if (existingHandle == 0)
+    {
+      NS_LOG_INFO ("We got a new message with Id: " << handle);
+      NotifyNewMessage (handle);
+      return;
+    }
+  DatpMessage &existing = m_messageStore->Get (existingHandle);
+  uint32_t size = message.payload->GetSize ();
+  if (!Matches (existing, schema) || existing.payload->GetSize () != size)
+    {
+      NS_LOG_INFO ("Id: " << handle << " does not have the records of Id: " << existingHandle);
+      NotifyNewMessage (handle);
+      return;
+    }
+
+  NS_LOG_INFO ("Reducing Id: " << handle << " into Id: " << existingHandle);
+  m_result.resize (size);
+  m_incoming.resize (size);
+  existing.payload->CopyData (&m_result[0], size);
+  message.payload->CopyData (&m_incoming[0], size);
+  bool later = message.timestamp >= existing.timestamp;
+  for (uint32_t offset = 0; offset < size; offset += schema->GetSize ())
+    schema->Reduce (&m_result[offset], &m_incoming[offset], existing.count, message.count, later);
+  existing.payload = Create<Packet> (&m_result[0], size);
+
+  existing.timestamp = (existing.timestamp * existing.count + message.timestamp * message.count) / (existing.count + message.count);
+  existing.hff |= 8;
+  int64_t receiveTime = (existing.receiveTime.GetNanoSeconds () * existing.count
+                         + message.receiveTime.GetNanoSeconds () * message.count) / (existing.count + message.count);
+  existing.receiveTime = NanoSeconds (receiveTime);
+  existing.count += message.count;
+
+  m_messagesMerged++;
+  m_bytesMerged += size + message.headerSize;
+  m_messageStore->Remove (handle);
+  NotifyExistingMessage (existingHandle);
+}
+
+} // namespace ns3
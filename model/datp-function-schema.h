@@ -0,0 +1,61 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_FUNCTION_SCHEMA_H__
+#define __DATP_FUNCTION_SCHEMA_H__
+
+#include "datp-function.h"
+#include "datp-payload-schema.h"
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup datp
+ * \brief Reduces payloads field by field as declared by their schema
+ *
+ * The payload of a message is one or more records of the DatpPayloadSchema
+ * registered for its application.  Messages of the same merge key are
+ * reduced record by record with the reduction of each field, straight on
+ * the payload bytes, and the message count (DATP_HFF2_COUNT) says how many
+ * readings they stand for.  Messages of an application without a schema,
+ * or whose payload is not made of its records, are forwarded unmerged.
+ */
+class DatpFunctionSchema : public DatpFunction
+{
+public:
+  static TypeId GetTypeId (void);
+
+  DatpFunctionSchema ();
+  virtual ~DatpFunctionSchema ();
+
+  virtual void ReceiveNewMessage (uint32_t handle);
+
+private:
+  /// \returns true if message is a run of records of schema
+  static bool Matches (DatpMessage const &message, const DatpPayloadSchema *schema);
+
+  std::vector<uint8_t> m_result;
+  std::vector<uint8_t> m_incoming;
+};
+
+} // namespace ns3
+
+#endif /* __DATP_FUNCTION_SCHEMA_H__ */
@@ -19,8 +19,10 @@
  */
  
 #include "datp-function-simple.h"
+#include "datp-merge-kernel.h"
 #include "ns3/log.h"
 #include "ns3/assert.h"
+#include "ns3/boolean.h"
 
 namespace ns3 {
 
@@ -33,6 +35,11 @@ TypeId DatpFunctionSimple::GetTypeId (void)
   static TypeId tid = TypeId ("ns3::DatpFunctionSimple")
     .SetParent<DatpFunction> ()
     .AddConstructor<DatpFunctionSimple> ()
+    .AddAttribute ("LazyMerge",
+                   "Only record which messages share a buffered message, and merge them all at once when it is ejected",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DatpFunctionSimple::m_lazyMerge),
+                   MakeBooleanChecker ())
   ;
   return tid;
 }
@@ -40,8 +47,7 @@ TypeId DatpFunctionSimple::GetTypeId (void)
 DatpFunctionSimple::DatpFunctionSimple ()
 {
   NS_LOG_FUNCTION (this);
-  m_messagesMerged=0;
-  m_bytesMerged=0;
+  m_lazyMerge=false;
 }
 
 DatpFunctionSimple::~DatpFunctionSimple()
@@ -49,111 +55,110 @@ DatpFunctionSimple::~DatpFunctionSimple()
   NS_LOG_FUNCTION (this);
 }
 
-uint32_t 
-DatpFunctionSimple::GetMessagesMerged ()
+void 
+DatpFunctionSimple::ReceiveNewMessage (uint32_t handle)
 {
-  return m_messagesMerged;
+  NS_LOG_FUNCTION (this << handle);
+  //should be a valid new message from aggregator receiver
+  DatpMessage &message = m_messageStore->Get (handle);
+  
+  //look up a buffered message of the same merge key
+  uint32_t existing = LookupMergePartner (handle);
+  
+  if (existing != 0)
+    {
+      NS_LOG_INFO ("We got an existing message on app " << (uint32_t) message.application 
+                                                        << " Ids: " 
+                                                        << existing
+                                                        << " "
+                                                        << handle);
+      if (m_lazyMerge)
+        {
+          //the payloads are merged once, when the scheduler ejects existing
+          m_messageStore->AddToGroup (existing, handle);
+        }
+      else
+        {
+          m_members.assign (1, handle);
+          Merge (existing, m_members);
+        }
+      NotifyExistingMessage (existing);
+    }
+  else
+    {
+      NS_LOG_INFO ("We got a new message with Id: " << handle << " and app=" << (uint32_t) message.application);
+      NotifyNewMessage (handle);
+    }
 }
 
-uint32_t 
-DatpFunctionSimple::GetBytesMerged ()
+void
+DatpFunctionSimple::Reduce (uint32_t handle)
 {
-  return m_bytesMerged;
+  NS_LOG_FUNCTION (this << handle);
+  if (m_messageStore->TakeGroup (handle, m_members))
+    {
+      NS_LOG_INFO ("Reducing " << m_members.size () << " messages into Id: " << handle);
+      Merge (handle, m_members);
+    }
 }
 
-
-void 
-DatpFunctionSimple::ReceiveQueryResponse (DatpHeader datpHeader, Ptr<Packet> packet)
+void
+DatpFunctionSimple::Merge (uint32_t existingHandle, std::vector<uint32_t> const &members)
 {
-  NS_LOG_FUNCTION (this);
-  NS_LOG_INFO ("Query response: app=" << (uint32_t) datpHeader.GetApplication ());
-  m_existingMessageDatpHeader = datpHeader;
-  m_existingMessagePacket = packet;
-}
+  NS_LOG_FUNCTION (this << existingHandle << members.size ());
+  DatpMessage &existing = m_messageStore->Get (existingHandle);
+  //add up the data in 4 byte segments with the two data segments aligned,
+  //the payloads are copied out once and merged word-wise in scratch memory,
+  //the running result stays there until the last member is merged
+  uint32_t size = existing.payload->GetSize ();
+  NS_ASSERT_MSG (size % 4 == 0, "Uneven data in messages for function to parse");
+  uint32_t words = size / 4;
+  m_scratch.resize (2 * words + 1);
+  uint32_t *a = &m_scratch[0];
+  uint32_t *result = a + words;
+  existing.payload->CopyData ((uint8_t *) result, size);
 
-void 
-DatpFunctionSimple::ReceiveNewMessage (DatpHeader datpHeader, Ptr<Packet> packet)
-{
-  NS_LOG_FUNCTION (this);
-  //should be a valid new header and data from aggregator receiver
-  
-  //query scheduler to see if same application has an existing message
-  NotifyQuery (datpHeader);
-  
-  if (m_existingMessageDatpHeader.GetInternalMessageIdentifier () != 0 && m_existingMessagePacket != NULL)
+  for (std::vector<uint32_t>::const_iterator it = members.begin (); it != members.end (); ++it)
     {
-      NS_LOG_INFO ("We got an existing message on app " << (uint32_t) datpHeader.GetApplication () 
-                                                        << " Ids: " 
-                                                        << m_existingMessageDatpHeader.GetInternalMessageIdentifier ()
-                                                        << " "
-                                                        << datpHeader.GetInternalMessageIdentifier ());
-      Ptr<Packet> newPacket = Create<Packet> (0);
-      //add up the data in 4 byte segments with the two data segments aligned... 
-      //if any extra 4 byte segments, keep them, if any remaining bytes less than four, discard
-      uint32_t c1 = 0;
-      uint32_t c2 = 0;
-      while (packet->GetSize () > 0 || m_existingMessagePacket->GetSize () > 0)
+      const DatpMessage &message = m_messageStore->Get (*it);
+      NS_ASSERT_MSG (message.payload->GetSize () == size, "Uneven data in messages for function to parse");
+      message.payload->CopyData ((uint8_t *) a, size);
+
+      //the timestamps are weighted by the counts of the last segment
+      uint32_t c1 = 1;
+      uint32_t c2 = 1;
+      uint32_t value2 = words > 0 ? DatpMergeKernel::NetworkToHost (result[words - 1]) : 0;
+      DatpMergeKernel::MergeGeneric (result, a, result, words);
+      if (words > 0)
         {
-          DatpGenericApplicationDataHeader value;
-          DatpGenericApplicationDataHeader value2;
-          uint16_t headerBytesRemoved = packet->RemoveHeader (value);
-          uint16_t headerBytesRemoved2 = m_existingMessagePacket->RemoveHeader (value2);
-          NS_LOG_INFO ("Existing Message: " << value2.GetValue () << " New Message : " << value.GetValue ());
-          if (headerBytesRemoved == 4 && headerBytesRemoved2 == 4)
-            {
-              if (value.GetValue () == 0 && value2.GetValue () == 0)
-                {
-                  value.SetValue (2);
-                  c1 = c2 = 1;
-                }
-              else if (value.GetValue () == 0 || value2.GetValue () == 0)
-                if (value.GetValue () == 0)
-                  {
-                    value.SetValue (value2.GetValue () + 1);
-                    c1 = 1;
-                    c2 = value2.GetValue ();
-                  }
-                else
-                  {
-                    value.SetValue (value.GetValue () + 1);
-                    c2 = 1;
-                    c1 = value.GetValue ();
-                  }
-              else 
-                {
-                  value.SetValue (value.GetValue () + value2.GetValue ());
-                  c1 = value.GetValue ();
-                  c2 = value2.GetValue ();
-                }
-                
-              newPacket->AddHeader (value);
-              NS_LOG_INFO ("Merged Message: " << value.GetValue ());
-            }
-          else 
+          uint32_t value = DatpMergeKernel::NetworkToHost (a[words - 1]);
+          uint32_t merged = DatpMergeKernel::NetworkToHost (result[words - 1]);
+          NS_LOG_INFO ("Existing Message: " << value2 << " New Message : " << value << " Merged Message: " << merged);
+          if (value == 0 && value2 != 0)
+            c2 = value2;
+          else if (value != 0 && value2 == 0)
+            c1 = merged;
+          else if (value != 0)
             {
-              NS_ASSERT_MSG (false, "Uneven data in messages for function to parse");
+              c1 = merged;
+              c2 = value2;
             }
-          m_bytesMerged += 4;
         }
       
-      uint64_t timestamp = (datpHeader.GetTimestamp () * c1 + m_existingMessageDatpHeader.GetTimestamp () * c2) / (c1 + c2);
+      uint64_t timestamp = (message.timestamp * c1 + existing.timestamp * c2) / (c1 + c2);
       NS_LOG_INFO ("Timestamp Result: " << NanoSeconds (timestamp).GetSeconds () 
-                << " = New: "           << NanoSeconds (datpHeader.GetTimestamp ()).GetSeconds ()
-                << " + Existing: "      << NanoSeconds (m_existingMessageDatpHeader.GetTimestamp ()).GetSeconds ());
-      m_existingMessageDatpHeader.SetTimestamp (timestamp);
-      timestamp = (datpHeader.GetInternalReceiveTime ().GetNanoSeconds () * c1 + m_existingMessageDatpHeader.GetInternalReceiveTime ().GetNanoSeconds () * c2) / (c1 + c2);
-      m_existingMessageDatpHeader.SetInternalReceiveTime (NanoSeconds (timestamp));
+                << " = New: "           << NanoSeconds (message.timestamp).GetSeconds ()
+                << " + Existing: "      << NanoSeconds (existing.timestamp).GetSeconds ());
+      existing.timestamp = timestamp;
+      existing.hff |= 8;
+      timestamp = (message.receiveTime.GetNanoSeconds () * c1 + existing.receiveTime.GetNanoSeconds () * c2) / (c1 + c2);
+      existing.receiveTime = NanoSeconds (timestamp);
 
       m_messagesMerged++;
-      m_bytesMerged += datpHeader.GetInternalHeaderSize ();
-      NotifyExistingMessage (m_existingMessageDatpHeader, newPacket);
-    }
-  else
-    {
-      NS_LOG_INFO ("We got a new message with Id: " << datpHeader.GetInternalMessageIdentifier () << " and app=" << (uint32_t) datpHeader.GetApplication ());
-      NotifyNewMessage (datpHeader, packet);
+      m_bytesMerged += size + message.headerSize;
+      m_messageStore->Remove (*it);
     }
+  existing.payload = Create<Packet> ((const uint8_t *) result, size);
 }
 
 } // namespace ns3
-
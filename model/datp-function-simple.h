@@ -22,6 +22,7 @@
 #define __DATP_FUNCTION_SIMPLE_H__
 
 #include "datp-function.h"
+#include <vector>
 
 namespace ns3 {
 
@@ -33,16 +34,16 @@ public:
   DatpFunctionSimple ();
   virtual ~DatpFunctionSimple ();
   
-  uint32_t GetMessagesMerged ();
-  uint32_t GetBytesMerged ();
-  
-  virtual void ReceiveQueryResponse (DatpHeader datpHeader, Ptr<Packet> packet);
-  virtual void ReceiveNewMessage (DatpHeader datpHeader, Ptr<Packet> packet);
+  virtual void ReceiveNewMessage (uint32_t handle);
+  virtual void Reduce (uint32_t handle);
 
 private:
+  /// Merge the messages of members, in order, into existingHandle and drop them
+  void Merge (uint32_t existingHandle, std::vector<uint32_t> const &members);
   
-  uint32_t m_messagesMerged;
-  uint32_t m_bytesMerged;
+  bool m_lazyMerge;
+  std::vector<uint32_t> m_scratch;
+  std::vector<uint32_t> m_members;
   
 };
 
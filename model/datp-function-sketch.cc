@@ -0,0 +1,575 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "datp-function-sketch.h"
+#include "datp-merge-kernel.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/uinteger.h"
+#include <algorithm>
+#include <map>
+#include <cstring>
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DatpFunctionSketch");
+
+NS_OBJECT_ENSURE_REGISTERED (DatpFunctionSketch);
+NS_OBJECT_ENSURE_REGISTERED (DatpFunctionHyperLogLog);
+NS_OBJECT_ENSURE_REGISTERED (DatpFunctionTDigest);
+NS_OBJECT_ENSURE_REGISTERED (DatpFunctionCountMin);
+NS_OBJECT_ENSURE_REGISTERED (DatpFunctionTopK);
+
+static inline void
+WriteHtonU32 (uint8_t *p, uint32_t value)
+{
+  p[0] = value >> 24;
+  p[1] = value >> 16;
+  p[2] = value >> 8;
+  p[3] = value;
+}
+
+static inline uint32_t
+ReadNtohU32 (const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static void
+WriteSketchHeader (std::vector<uint8_t> &sketch, uint8_t kind, uint8_t parameter1, uint16_t parameter2)
+{
+  sketch[0] = kind;
+  sketch[1] = parameter1;
+  sketch[2] = parameter2 >> 8;
+  sketch[3] = parameter2;
+}
+
+TypeId DatpFunctionSketch::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFunctionSketch")
+    .SetParent<DatpFunction> ()
+  ;
+  return tid;
+}
+
+DatpFunctionSketch::DatpFunctionSketch ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+DatpFunctionSketch::~DatpFunctionSketch()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+uint64_t
+DatpFunctionSketch::Hash (uint32_t reading, uint32_t seed)
+{
+  //splitmix64 finalizer
+  uint64_t z = reading + 0x9e3779b97f4a7c15ULL * (seed + 1);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+void
+DatpFunctionSketch::ToSketch (DatpMessage &message)
+{
+  if (message.IsSketch ())
+    return;
+  uint32_t size = message.payload->GetSize ();
+  NS_ASSERT_MSG (size % 4 == 0, "Uneven data in messages for function to parse");
+  uint32_t n = size / 4;
+  m_readings.resize (n + 1);
+  message.payload->CopyData ((uint8_t *) &m_readings[0], size);
+  for (uint32_t i = 0; i < n; ++i)
+    m_readings[i] = DatpMergeKernel::NetworkToHost (m_readings[i]);
+  Build (m_into, &m_readings[0], n);
+  NS_LOG_INFO ("Sketch of " << n << " readings takes " << m_into.size () << " bytes");
+  message.payload = Create<Packet> (&m_into[0], m_into.size ());
+  message.sizeModifiers |= DATP_HFF2_SKETCH;
+}
+
+void 
+DatpFunctionSketch::ReceiveNewMessage (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  DatpMessage &message = m_messageStore->Get (handle);
+  ToSketch (message);
+  
+  uint32_t existingHandle = LookupMergePartner (handle);
+  if (existingHandle == 0)
+    {
+      NS_LOG_INFO ("We got a new message with Id: " << handle);
+      NotifyNewMessage (handle);
+      return;
+    }
+  
+  NS_LOG_INFO ("Merging the sketch of Id: " << handle << " into Id: " << existingHandle);
+  DatpMessage &existing = m_messageStore->Get (existingHandle);
+  m_into.resize (existing.payload->GetSize ());
+  m_from.resize (message.payload->GetSize ());
+  existing.payload->CopyData (&m_into[0], m_into.size ());
+  message.payload->CopyData (&m_from[0], m_from.size ());
+  NS_ASSERT_MSG (m_into.size () >= DATP_SKETCH_HEADER_SIZE && m_from.size () >= DATP_SKETCH_HEADER_SIZE
+                 && memcmp (&m_into[0], &m_from[0], DATP_SKETCH_HEADER_SIZE) == 0,
+                 "Sketches of different kinds in one merge group");
+  Merge (m_into, m_from);
+  existing.payload = Create<Packet> (&m_into[0], m_into.size ());
+  
+  existing.timestamp = (existing.timestamp * existing.count + message.timestamp * message.count) / (existing.count + message.count);
+  existing.hff |= 8;
+  int64_t receiveTime = (existing.receiveTime.GetNanoSeconds () * existing.count
+                         + message.receiveTime.GetNanoSeconds () * message.count) / (existing.count + message.count);
+  existing.receiveTime = NanoSeconds (receiveTime);
+  existing.count += message.count;
+  
+  m_messagesMerged++;
+  m_bytesMerged += m_from.size () + message.headerSize;
+  m_messageStore->Remove (handle);
+  NotifyExistingMessage (existingHandle);
+}
+
+
+TypeId DatpFunctionHyperLogLog::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFunctionHyperLogLog")
+    .SetParent<DatpFunctionSketch> ()
+    .AddConstructor<DatpFunctionHyperLogLog> ()
+    .AddAttribute ("Precision",
+                   "Bits of the hash selecting a register, the sketch has 2^Precision registers",
+                   UintegerValue (8),
+                   MakeUintegerAccessor (&DatpFunctionHyperLogLog::m_precision),
+                   MakeUintegerChecker<uint8_t> (4, 16))
+  ;
+  return tid;
+}
+
+DatpFunctionHyperLogLog::DatpFunctionHyperLogLog ()
+  : m_precision (8)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+DatpFunctionHyperLogLog::Build (std::vector<uint8_t> &sketch, const uint32_t *readings, uint32_t n)
+{
+  sketch.assign (DATP_SKETCH_HEADER_SIZE + (1 << m_precision), 0);
+  WriteSketchHeader (sketch, DATP_SKETCH_HYPERLOGLOG, m_precision, 0);
+  uint8_t *registers = &sketch[DATP_SKETCH_HEADER_SIZE];
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      uint64_t hash = Hash (readings[i], 0);
+      uint32_t index = hash >> (64 - m_precision);
+      //rank of the first set bit among the bits left after the index
+      uint64_t rest = hash << m_precision;
+      uint8_t rank = 1;
+      while (rank <= 64 - m_precision && !(rest & (1ULL << 63)))
+        {
+          ++rank;
+          rest <<= 1;
+        }
+      registers[index] = std::max (registers[index], rank);
+    }
+}
+
+void
+DatpFunctionHyperLogLog::Merge (std::vector<uint8_t> &into, std::vector<uint8_t> const &from)
+{
+  NS_ASSERT (into.size () == from.size ());
+  for (uint32_t i = DATP_SKETCH_HEADER_SIZE; i < into.size (); ++i)
+    into[i] = std::max (into[i], from[i]);
+}
+
+double
+DatpFunctionHyperLogLog::EstimateDistinct (Ptr<const Packet> sketch)
+{
+  std::vector<uint8_t> data (sketch->GetSize ());
+  if (data.size () < DATP_SKETCH_HEADER_SIZE)
+    return 0;
+  sketch->CopyData (&data[0], data.size ());
+  NS_ASSERT (data[0] == DATP_SKETCH_HYPERLOGLOG);
+  double m = 1 << data[1];
+  NS_ASSERT (data.size () == DATP_SKETCH_HEADER_SIZE + m);
+  
+  double sum = 0;
+  uint32_t zeros = 0;
+  for (uint32_t i = DATP_SKETCH_HEADER_SIZE; i < data.size (); ++i)
+    {
+      sum += std::ldexp (1.0, -data[i]);
+      if (data[i] == 0)
+        ++zeros;
+    }
+  double alpha = m == 16 ? 0.673 : m == 32 ? 0.697 : m == 64 ? 0.709 : 0.7213 / (1 + 1.079 / m);
+  double estimate = alpha * m * m / sum;
+  //small range correction, linear counting
+  if (estimate <= 2.5 * m && zeros > 0)
+    estimate = m * std::log (m / zeros);
+  return estimate;
+}
+
+
+TypeId DatpFunctionTDigest::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFunctionTDigest")
+    .SetParent<DatpFunctionSketch> ()
+    .AddConstructor<DatpFunctionTDigest> ()
+    .AddAttribute ("Compression",
+                   "Scale of the t-digest, it keeps about this many centroids at most",
+                   UintegerValue (32),
+                   MakeUintegerAccessor (&DatpFunctionTDigest::m_compression),
+                   MakeUintegerChecker<uint8_t> (8))
+  ;
+  return tid;
+}
+
+DatpFunctionTDigest::DatpFunctionTDigest ()
+  : m_compression (32)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+DatpFunctionTDigest::Read (const uint8_t *data, uint32_t size, std::vector<Centroid> &centroids)
+{
+  for (uint32_t offset = DATP_SKETCH_HEADER_SIZE; offset + 12 <= size; offset += 12)
+    {
+      uint64_t bits = ((uint64_t) ReadNtohU32 (data + offset) << 32) | ReadNtohU32 (data + offset + 4);
+      Centroid centroid;
+      memcpy (&centroid.mean, &bits, 8);
+      centroid.weight = ReadNtohU32 (data + offset + 8);
+      centroids.push_back (centroid);
+    }
+}
+
+void
+DatpFunctionTDigest::Write (std::vector<uint8_t> &sketch)
+{
+  sketch.resize (DATP_SKETCH_HEADER_SIZE + 12 * m_centroids.size ());
+  WriteSketchHeader (sketch, DATP_SKETCH_TDIGEST, m_compression, 0);
+  uint8_t *p = &sketch[DATP_SKETCH_HEADER_SIZE];
+  for (uint32_t i = 0; i < m_centroids.size (); ++i, p += 12)
+    {
+      uint64_t bits;
+      memcpy (&bits, &m_centroids[i].mean, 8);
+      WriteHtonU32 (p, bits >> 32);
+      WriteHtonU32 (p + 4, bits);
+      WriteHtonU32 (p + 8, m_centroids[i].weight);
+    }
+}
+
+void
+DatpFunctionTDigest::Compress (void)
+{
+  if (m_centroids.empty ())
+    return;
+  std::sort (m_centroids.begin (), m_centroids.end ());
+  double total = 0;
+  for (uint32_t i = 0; i < m_centroids.size (); ++i)
+    total += m_centroids[i].weight;
+
+  //k1 scale function: neighbours merge while they span at most one unit of k
+  double scale = m_compression / (2 * 3.14159265358979);
+  double weightLeft = 0;
+  double kLeft = scale * std::asin (-1.0);
+  m_compressed.clear ();
+  Centroid current = m_centroids[0];
+  for (uint32_t i = 1; i < m_centroids.size (); ++i)
+    {
+      double q = (weightLeft + current.weight + m_centroids[i].weight) / total;
+      if (scale * std::asin (2 * q - 1) - kLeft <= 1)
+        {
+          uint32_t weight = current.weight + m_centroids[i].weight;
+          current.mean += (m_centroids[i].mean - current.mean) * m_centroids[i].weight / weight;
+          current.weight = weight;
+        }
+      else
+        {
+          m_compressed.push_back (current);
+          weightLeft += current.weight;
+          kLeft = scale * std::asin (2 * weightLeft / total - 1);
+          current = m_centroids[i];
+        }
+    }
+  m_compressed.push_back (current);
+  m_centroids.swap (m_compressed);
+}
+
+void
+DatpFunctionTDigest::Build (std::vector<uint8_t> &sketch, const uint32_t *readings, uint32_t n)
+{
+  m_centroids.resize (n);
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      m_centroids[i].mean = readings[i];
+      m_centroids[i].weight = 1;
+    }
+  Compress ();
+  Write (sketch);
+}
+
+void
+DatpFunctionTDigest::Merge (std::vector<uint8_t> &into, std::vector<uint8_t> const &from)
+{
+  m_centroids.clear ();
+  Read (&into[0], into.size (), m_centroids);
+  Read (&from[0], from.size (), m_centroids);
+  Compress ();
+  Write (into);
+}
+
+double
+DatpFunctionTDigest::EstimateQuantile (Ptr<const Packet> sketch, double q)
+{
+  std::vector<uint8_t> data (sketch->GetSize ());
+  if (data.size () < DATP_SKETCH_HEADER_SIZE)
+    return 0;
+  sketch->CopyData (&data[0], data.size ());
+  NS_ASSERT (data[0] == DATP_SKETCH_TDIGEST);
+  std::vector<Centroid> centroids;
+  Read (&data[0], data.size (), centroids);
+  if (centroids.empty ())
+    return 0;
+
+  double total = 0;
+  for (uint32_t i = 0; i < centroids.size (); ++i)
+    total += centroids[i].weight;
+  //interpolate between the centres of the centroids around the target rank
+  double target = q * total;
+  double centre = centroids[0].weight / 2.0;
+  if (target <= centre)
+    return centroids[0].mean;
+  for (uint32_t i = 1; i < centroids.size (); ++i)
+    {
+      double next = centre + (centroids[i - 1].weight + centroids[i].weight) / 2.0;
+      if (target <= next)
+        return centroids[i - 1].mean + (centroids[i].mean - centroids[i - 1].mean) * (target - centre) / (next - centre);
+      centre = next;
+    }
+  return centroids.back ().mean;
+}
+
+
+TypeId DatpFunctionCountMin::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFunctionCountMin")
+    .SetParent<DatpFunctionSketch> ()
+    .AddConstructor<DatpFunctionCountMin> ()
+    .AddAttribute ("Depth",
+                   "Rows of counters, each with its own hash",
+                   UintegerValue (4),
+                   MakeUintegerAccessor (&DatpFunctionCountMin::m_depth),
+                   MakeUintegerChecker<uint8_t> (1, 16))
+    .AddAttribute ("Width",
+                   "Counters per row",
+                   UintegerValue (32),
+                   MakeUintegerAccessor (&DatpFunctionCountMin::m_width),
+                   MakeUintegerChecker<uint16_t> (1, 4096))
+  ;
+  return tid;
+}
+
+DatpFunctionCountMin::DatpFunctionCountMin ()
+  : m_depth (4),
+    m_width (32)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+DatpFunctionCountMin::Build (std::vector<uint8_t> &sketch, const uint32_t *readings, uint32_t n)
+{
+  sketch.assign (DATP_SKETCH_HEADER_SIZE + 4 * m_depth * m_width, 0);
+  WriteSketchHeader (sketch, DATP_SKETCH_COUNTMIN, m_depth, m_width);
+  uint8_t *counters = &sketch[DATP_SKETCH_HEADER_SIZE];
+  for (uint32_t i = 0; i < n; ++i)
+    for (uint32_t row = 0; row < m_depth; ++row)
+      {
+        uint8_t *counter = counters + 4 * (row * m_width + Hash (readings[i], row + 1) % m_width);
+        WriteHtonU32 (counter, ReadNtohU32 (counter) + 1);
+      }
+}
+
+void
+DatpFunctionCountMin::Merge (std::vector<uint8_t> &into, std::vector<uint8_t> const &from)
+{
+  NS_ASSERT (into.size () == from.size ());
+  for (uint32_t i = DATP_SKETCH_HEADER_SIZE; i + 4 <= into.size (); i += 4)
+    WriteHtonU32 (&into[i], ReadNtohU32 (&into[i]) + ReadNtohU32 (&from[i]));
+}
+
+uint32_t
+DatpFunctionCountMin::EstimateCount (Ptr<const Packet> sketch, uint32_t reading)
+{
+  std::vector<uint8_t> data (sketch->GetSize ());
+  if (data.size () < DATP_SKETCH_HEADER_SIZE)
+    return 0;
+  sketch->CopyData (&data[0], data.size ());
+  NS_ASSERT (data[0] == DATP_SKETCH_COUNTMIN);
+  uint32_t depth = data[1];
+  uint32_t width = (data[2] << 8) | data[3];
+  NS_ASSERT (data.size () == DATP_SKETCH_HEADER_SIZE + 4 * depth * width);
+  uint32_t count = 0xffffffff;
+  for (uint32_t row = 0; row < depth; ++row)
+    count = std::min (count, ReadNtohU32 (&data[DATP_SKETCH_HEADER_SIZE + 4 * (row * width + Hash (reading, row + 1) % width)]));
+  return count;
+}
+
+
+TypeId DatpFunctionTopK::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFunctionTopK")
+    .SetParent<DatpFunctionSketch> ()
+    .AddConstructor<DatpFunctionTopK> ()
+    .AddAttribute ("K",
+                   "Counters kept, the sketch lists any reading occurring more than 1/K of the time",
+                   UintegerValue (8),
+                   MakeUintegerAccessor (&DatpFunctionTopK::m_k),
+                   MakeUintegerChecker<uint8_t> (1))
+  ;
+  return tid;
+}
+
+DatpFunctionTopK::DatpFunctionTopK ()
+  : m_k (8)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+static bool
+MoreFrequent (DatpFunctionTopK::Counter const &a, DatpFunctionTopK::Counter const &b)
+{
+  return a.count > b.count || (a.count == b.count && a.reading < b.reading);
+}
+
+void
+DatpFunctionTopK::Read (const uint8_t *data, uint32_t size, std::vector<Counter> &counters)
+{
+  for (uint32_t offset = DATP_SKETCH_HEADER_SIZE; offset + 12 <= size; offset += 12)
+    {
+      Counter counter;
+      counter.reading = ReadNtohU32 (data + offset);
+      counter.count = ReadNtohU32 (data + offset + 4);
+      counter.error = ReadNtohU32 (data + offset + 8);
+      counters.push_back (counter);
+    }
+}
+
+void
+DatpFunctionTopK::Write (std::vector<uint8_t> &sketch)
+{
+  std::sort (m_counters.begin (), m_counters.end (), MoreFrequent);
+  if (m_counters.size () > m_k)
+    m_counters.resize (m_k);
+  sketch.resize (DATP_SKETCH_HEADER_SIZE + 12 * m_counters.size ());
+  WriteSketchHeader (sketch, DATP_SKETCH_TOPK, m_k, 0);
+  uint8_t *p = &sketch[DATP_SKETCH_HEADER_SIZE];
+  for (uint32_t i = 0; i < m_counters.size (); ++i, p += 12)
+    {
+      WriteHtonU32 (p, m_counters[i].reading);
+      WriteHtonU32 (p + 4, m_counters[i].count);
+      WriteHtonU32 (p + 8, m_counters[i].error);
+    }
+}
+
+void
+DatpFunctionTopK::Build (std::vector<uint8_t> &sketch, const uint32_t *readings, uint32_t n)
+{
+  m_counters.clear ();
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      uint32_t smallest = 0;
+      uint32_t j = 0;
+      for (; j < m_counters.size () && m_counters[j].reading != readings[i]; ++j)
+        if (m_counters[j].count < m_counters[smallest].count)
+          smallest = j;
+      if (j < m_counters.size ())
+        ++m_counters[j].count;
+      else if (m_counters.size () < m_k)
+        {
+          Counter counter = { readings[i], 1, 0 };
+          m_counters.push_back (counter);
+        }
+      else
+        {
+          //the new reading takes over the smallest counter, and its count as error
+          m_counters[smallest].reading = readings[i];
+          m_counters[smallest].error = m_counters[smallest].count;
+          ++m_counters[smallest].count;
+        }
+    }
+  Write (sketch);
+}
+
+void
+DatpFunctionTopK::Merge (std::vector<uint8_t> &into, std::vector<uint8_t> const &from)
+{
+  m_counters.clear ();
+  m_from.clear ();
+  Read (&into[0], into.size (), m_counters);
+  Read (&from[0], from.size (), m_from);
+  //a reading missing from a full summary may have occurred up to its smallest count
+  uint32_t intoFloor = m_counters.size () == m_k ? m_counters.back ().count : 0;
+  uint32_t fromFloor = m_from.size () == m_k ? m_from.back ().count : 0;
+
+  std::map<uint32_t,uint32_t> index;
+  for (uint32_t i = 0; i < m_counters.size (); ++i)
+    index[m_counters[i].reading] = i;
+  std::vector<bool> matched (m_counters.size (), false);
+  for (uint32_t i = 0; i < m_from.size (); ++i)
+    {
+      std::map<uint32_t,uint32_t>::iterator it = index.find (m_from[i].reading);
+      if (it != index.end ())
+        {
+          m_counters[it->second].count += m_from[i].count;
+          m_counters[it->second].error += m_from[i].error;
+          matched[it->second] = true;
+        }
+      else
+        {
+          Counter counter = m_from[i];
+          counter.count += intoFloor;
+          counter.error += intoFloor;
+          m_counters.push_back (counter);
+        }
+    }
+  for (uint32_t i = 0; i < matched.size (); ++i)
+    if (!matched[i])
+      {
+        m_counters[i].count += fromFloor;
+        m_counters[i].error += fromFloor;
+      }
+  Write (into);
+}
+
+void
+DatpFunctionTopK::GetTopK (Ptr<const Packet> sketch, std::vector<Counter> &counters)
+{
+  counters.clear ();
+  std::vector<uint8_t> data (sketch->GetSize ());
+  if (data.size () < DATP_SKETCH_HEADER_SIZE)
+    return;
+  sketch->CopyData (&data[0], data.size ());
+  NS_ASSERT (data[0] == DATP_SKETCH_TOPK);
+  Read (&data[0], data.size (), counters);
+}
+
+} // namespace ns3
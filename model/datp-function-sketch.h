@@ -0,0 +1,203 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_FUNCTION_SKETCH_H__
+#define __DATP_FUNCTION_SKETCH_H__
+
+#include "datp-function.h"
+#include <vector>
+
+namespace ns3 {
+
+#define DATP_SKETCH_HEADER_SIZE 4      //!< kind and parameters in front of every sketch
+#define DATP_SKETCH_HYPERLOGLOG 1
+#define DATP_SKETCH_TDIGEST 2
+#define DATP_SKETCH_COUNTMIN 3
+#define DATP_SKETCH_TOPK 4
+
+/**
+ * \ingroup datp
+ * \brief Base of the functions folding readings into a mergeable sketch
+ *
+ * The first function a message meets turns its readings (32 bit, network
+ * order) into a sketch and flags the message with DATP_HFF2_SKETCH, further
+ * hops only merge sketches.  However many readings are folded in, a merge
+ * group leaves as one message of bounded size.  A sketch names its kind
+ * and parameters, so the collector can read it without knowing how the
+ * aggregators were configured:
+ * \verbatim
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |      Kind     |  Parameter 1  |          Parameter 2          |
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |                         Sketch data ...                       |
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   \endverbatim
+ */
+class DatpFunctionSketch : public DatpFunction
+{
+public:
+  static TypeId GetTypeId (void);
+
+  DatpFunctionSketch ();
+  virtual ~DatpFunctionSketch ();
+  
+  virtual void ReceiveNewMessage (uint32_t handle);
+  
+  /// 64 bit hash of a reading, one independent hash per seed
+  static uint64_t Hash (uint32_t reading, uint32_t seed);
+
+protected:
+  /// Build a sketch of n readings, given in host order
+  virtual void Build (std::vector<uint8_t> &sketch, const uint32_t *readings, uint32_t n) = 0;
+  /// Merge from into into, both sketches of the kind and parameters of this function
+  virtual void Merge (std::vector<uint8_t> &into, std::vector<uint8_t> const &from) = 0;
+
+private:
+  /// Replace the readings of message by their sketch, unless it is one already
+  void ToSketch (DatpMessage &message);
+
+  std::vector<uint32_t> m_readings;
+  std::vector<uint8_t> m_into;
+  std::vector<uint8_t> m_from;
+};
+
+/**
+ * \brief Distinct readings, HyperLogLog with 2^Precision one byte registers
+ */
+class DatpFunctionHyperLogLog : public DatpFunctionSketch
+{
+public:
+  static TypeId GetTypeId (void);
+
+  DatpFunctionHyperLogLog ();
+  
+  /// Estimated number of distinct readings in a HyperLogLog sketch payload
+  static double EstimateDistinct (Ptr<const Packet> sketch);
+
+protected:
+  virtual void Build (std::vector<uint8_t> &sketch, const uint32_t *readings, uint32_t n);
+  virtual void Merge (std::vector<uint8_t> &into, std::vector<uint8_t> const &from);
+
+private:
+  uint8_t m_precision;
+};
+
+/**
+ * \brief Quantiles of the readings, a merging t-digest
+ *
+ * Centroids are kept as a 64 bit floating point mean and a 32 bit weight;
+ * the k1 scale function keeps their number below about Compression.
+ */
+class DatpFunctionTDigest : public DatpFunctionSketch
+{
+public:
+  static TypeId GetTypeId (void);
+
+  DatpFunctionTDigest ();
+  
+  /// Estimated q quantile (0 to 1) of the readings in a t-digest sketch payload
+  static double EstimateQuantile (Ptr<const Packet> sketch, double q);
+
+protected:
+  virtual void Build (std::vector<uint8_t> &sketch, const uint32_t *readings, uint32_t n);
+  virtual void Merge (std::vector<uint8_t> &into, std::vector<uint8_t> const &from);
+
+private:
+  struct Centroid
+  {
+    double mean;
+    uint32_t weight;
+    bool operator< (Centroid const &other) const { return mean < other.mean; }
+  };
+  static void Read (const uint8_t *data, uint32_t size, std::vector<Centroid> &centroids);
+  void Write (std::vector<uint8_t> &sketch);
+  /// Sort and merge m_centroids down to the size allowed by m_compression
+  void Compress (void);
+
+  uint8_t m_compression;
+  std::vector<Centroid> m_centroids;
+  std::vector<Centroid> m_compressed;
+};
+
+/**
+ * \brief Occurrences of each reading, a Count-Min sketch of Depth rows of Width counters
+ */
+class DatpFunctionCountMin : public DatpFunctionSketch
+{
+public:
+  static TypeId GetTypeId (void);
+
+  DatpFunctionCountMin ();
+  
+  /// Estimated occurrences (never too low) of reading in a Count-Min sketch payload
+  static uint32_t EstimateCount (Ptr<const Packet> sketch, uint32_t reading);
+
+protected:
+  virtual void Build (std::vector<uint8_t> &sketch, const uint32_t *readings, uint32_t n);
+  virtual void Merge (std::vector<uint8_t> &into, std::vector<uint8_t> const &from);
+
+private:
+  uint8_t m_depth;
+  uint16_t m_width;
+};
+
+/**
+ * \brief Most frequent readings, a Space-Saving summary of at most K counters
+ *
+ * Each counter holds a reading, its count and the error that count may be
+ * too high by, counters are sent most frequent first.  Summaries merge by
+ * adding the counts of the same reading, a reading missing from a full
+ * summary being counted as its smallest count, then keeping the K largest
+ * (Agarwal et al., Mergeable Summaries).  Any reading occurring more than
+ * 1/K of the time is listed, and no count is ever too low.
+ */
+class DatpFunctionTopK : public DatpFunctionSketch
+{
+public:
+  static TypeId GetTypeId (void);
+
+  DatpFunctionTopK ();
+
+  struct Counter
+  {
+    uint32_t reading;
+    uint32_t count;         //!< occurrences, never too low
+    uint32_t error;         //!< largest amount count may be too high by
+  };
+  
+  /// Counters of a top-k sketch payload, most frequent first
+  static void GetTopK (Ptr<const Packet> sketch, std::vector<Counter> &counters);
+
+protected:
+  virtual void Build (std::vector<uint8_t> &sketch, const uint32_t *readings, uint32_t n);
+  virtual void Merge (std::vector<uint8_t> &into, std::vector<uint8_t> const &from);
+
+private:
+  static void Read (const uint8_t *data, uint32_t size, std::vector<Counter> &counters);
+  void Write (std::vector<uint8_t> &sketch);
+
+  uint8_t m_k;
+  std::vector<Counter> m_counters;
+  std::vector<Counter> m_from;
+};
+
+} // namespace ns3
+
+#endif /* __DATP_FUNCTION_SKETCH_H__ */
@@ -0,0 +1,355 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "datp-function-typed.h"
+#include "datp-merge-kernel.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DatpFunctionTyped");
+
+NS_OBJECT_ENSURE_REGISTERED (DatpFunctionTyped);
+NS_OBJECT_ENSURE_REGISTERED (DatpFunctionSum);
+NS_OBJECT_ENSURE_REGISTERED (DatpFunctionMin);
+NS_OBJECT_ENSURE_REGISTERED (DatpFunctionMax);
+NS_OBJECT_ENSURE_REGISTERED (DatpFunctionMean);
+NS_OBJECT_ENSURE_REGISTERED (DatpFunctionLast);
+
+TypeId DatpFunctionTyped::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFunctionTyped")
+    .SetParent<DatpFunction> ()
+    .AddAttribute ("LazyMerge",
+                   "Only record which messages share a buffered message, and reduce them all at once when it is ejected",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DatpFunctionTyped::m_lazyMerge),
+                   MakeBooleanChecker ())
+    .AddAttribute ("Quantize",
+                   "Quantize the readings of applications with an error budget before they leave, see DatpQuantizer",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DatpFunctionTyped::m_quantize),
+                   MakeBooleanChecker ())
+    .AddAttribute ("BudgetShare",
+                   "Share of the error budget left a hop may spend quantizing",
+                   DoubleValue (0.5),
+                   MakeDoubleAccessor (&DatpFunctionTyped::m_budgetShare),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+  ;
+  return tid;
+}
+
+DatpFunctionTyped::DatpFunctionTyped ()
+{
+  NS_LOG_FUNCTION (this);
+  m_lazyMerge=false;
+  m_quantize = false;
+  m_budgetShare = 0.5;
+}
+
+DatpFunctionTyped::~DatpFunctionTyped()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+bool
+DatpFunctionTyped::HasReadings (DatpMessage const &message)
+{
+  return message.IsPlain () && message.payload->GetSize () % 4 == 0;
+}
+
+void 
+DatpFunctionTyped::ReceiveNewMessage (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  DatpMessage &message = m_messageStore->Get (handle);
+  if (message.IsQuantized () && !Dequantize (handle))
+    {
+      NS_LOG_WARN ("Forwarding malformed quantized message Id: " << handle);
+      NotifyNewMessage (handle);
+      return;
+    }
+  uint32_t existing = HasReadings (message) ? LookupMergePartner (handle) : 0;
+  if (existing != 0 && (!HasReadings (m_messageStore->Get (existing))
+                        || m_messageStore->Get (existing).payload->GetSize () != message.payload->GetSize ()))
+    {
+      NS_LOG_INFO ("Id: " << handle << " does not have the readings of Id: " << existing);
+      existing = 0;
+    }
+  if (existing != 0)
+    {
+      NS_LOG_INFO ("Reducing Id: " << handle << " into Id: " << existing);
+      if (m_lazyMerge)
+        {
+          m_messageStore->AddToGroup (existing, handle);
+        }
+      else
+        {
+          m_members.assign (1, handle);
+          Merge (existing, m_members);
+        }
+      NotifyExistingMessage (existing);
+    }
+  else
+    {
+      NS_LOG_INFO ("We got a new message with Id: " << handle);
+      NotifyNewMessage (handle);
+    }
+}
+
+void
+DatpFunctionTyped::Reduce (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  if (m_messageStore->TakeGroup (handle, m_members))
+    Merge (handle, m_members);
+  if (m_quantize)
+    Quantize (handle);
+}
+
+uint64_t
+DatpFunctionTyped::ReduceTimestamp (DatpMessage const &existing, DatpMessage const &message)
+{
+  return (existing.timestamp * existing.count + message.timestamp * message.count) / (existing.count + message.count);
+}
+
+double
+DatpFunctionTyped::ReduceError (DatpMessage const &existing, double existingSpent,
+                                DatpMessage const &message, double messageSpent, bool relative)
+{
+  return std::max (existingSpent, messageSpent);
+}
+
+void
+DatpFunctionTyped::Quantize (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  DatpMessage &message = m_messageStore->Get (handle);
+  double budget = DatpQuantizer::GetErrorBudget (message.application);
+  uint32_t size = message.payload->GetSize ();
+  if (budget <= 0 || !HasReadings (message) || size == 0)
+    return;
+  uint32_t words = size / 4;
+  m_scratch.resize (words + 1);
+  message.payload->CopyData ((uint8_t *) &m_scratch[0], size);
+  for (uint32_t w = 0; w < words; ++w)
+    m_scratch[w] = DatpMergeKernel::NetworkToHost (m_scratch[w]);
+
+  double errorSpent = m_messageStore->GetErrorSpent (handle);
+  double spend = std::max (0.0, budget - errorSpent) * m_budgetShare;
+  m_packed.clear ();
+  double spent = DatpQuantizer::Pack (&m_scratch[0], words, DatpQuantizer::IsRelative (message.application),
+                                      spend, errorSpent, m_packed);
+  //exact readings that do not shrink are sent as they are, the others
+  //must be packed so the error spent on them goes along
+  if (m_packed.size () >= size && errorSpent == 0)
+    return;
+  NS_LOG_INFO ("Quantized Id: " << handle << " from " << size << " to " << m_packed.size () << " bytes, error spent " << spent);
+  message.payload = Create<Packet> (&m_packed[0], m_packed.size ());
+  message.encodingFlags |= DATP_HFF3_QUANTIZED;
+  m_messageStore->SetErrorSpent (handle, spent);
+}
+
+bool
+DatpFunctionTyped::Dequantize (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  DatpMessage &message = m_messageStore->Get (handle);
+  uint32_t size = message.payload->GetSize ();
+  m_packed.resize (size + 1);
+  message.payload->CopyData (&m_packed[0], size);
+  double errorSpent;
+  if (!DatpQuantizer::Unpack (&m_packed[0], size, m_scratch, errorSpent))
+    return false;
+  m_messageStore->SetErrorSpent (handle, errorSpent);
+  for (uint32_t w = 0; w < m_scratch.size (); ++w)
+    m_scratch[w] = DatpMergeKernel::HostToNetwork (m_scratch[w]);
+  message.payload = m_scratch.empty () ? Create<Packet> () : Create<Packet> ((const uint8_t *) &m_scratch[0], m_scratch.size () * 4);
+  message.encodingFlags &= ~DATP_HFF3_QUANTIZED;
+  return true;
+}
+
+void
+DatpFunctionTyped::Merge (uint32_t existingHandle, std::vector<uint32_t> const &members)
+{
+  NS_LOG_FUNCTION (this << existingHandle << members.size ());
+  DatpMessage &existing = m_messageStore->Get (existingHandle);
+  uint32_t size = existing.payload->GetSize ();
+  NS_ASSERT_MSG (HasReadings (existing), "Function cannot parse the data of the message");
+  uint32_t words = size / 4;
+  m_scratch.resize (2 * words + 1);
+  uint32_t *incoming = &m_scratch[0];
+  uint32_t *result = incoming + words;
+  existing.payload->CopyData ((uint8_t *) result, size);
+  for (uint32_t w = 0; w < words; ++w)
+    result[w] = DatpMergeKernel::NetworkToHost (result[w]);
+
+  for (std::vector<uint32_t>::const_iterator it = members.begin (); it != members.end (); ++it)
+    {
+      const DatpMessage &message = m_messageStore->Get (*it);
+      NS_ASSERT_MSG (HasReadings (message) && message.payload->GetSize () == size, "Uneven data in messages for function to parse");
+      message.payload->CopyData ((uint8_t *) incoming, size);
+      for (uint32_t w = 0; w < words; ++w)
+        incoming[w] = DatpMergeKernel::NetworkToHost (incoming[w]);
+
+      ReduceFields (existing, message, result, incoming, words);
+      m_messageStore->SetErrorSpent (existingHandle, ReduceError (existing, m_messageStore->GetErrorSpent (existingHandle),
+                                                                  message, m_messageStore->GetErrorSpent (*it),
+                                                                  DatpQuantizer::IsRelative (existing.application)));
+      existing.timestamp = ReduceTimestamp (existing, message);
+      existing.hff |= 8;
+      int64_t receiveTime = (existing.receiveTime.GetNanoSeconds () * existing.count
+                             + message.receiveTime.GetNanoSeconds () * message.count) / (existing.count + message.count);
+      existing.receiveTime = NanoSeconds (receiveTime);
+      existing.count += message.count;
+
+      m_messagesMerged++;
+      m_bytesMerged += size + message.headerSize;
+      m_messageStore->Remove (*it);
+    }
+
+  for (uint32_t w = 0; w < words; ++w)
+    result[w] = DatpMergeKernel::HostToNetwork (result[w]);
+  existing.payload = Create<Packet> ((const uint8_t *) result, size);
+}
+
+
+TypeId DatpFunctionSum::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFunctionSum")
+    .SetParent<DatpFunctionTyped> ()
+    .AddConstructor<DatpFunctionSum> ()
+  ;
+  return tid;
+}
+
+void
+DatpFunctionSum::ReduceFields (DatpMessage const &existing, DatpMessage const &message,
+                               uint32_t *result, const uint32_t *incoming, uint32_t words)
+{
+  for (uint32_t w = 0; w < words; ++w)
+    result[w] += incoming[w];
+}
+
+double
+DatpFunctionSum::ReduceError (DatpMessage const &existing, double existingSpent,
+                              DatpMessage const &message, double messageSpent, bool relative)
+{
+  //relative errors of a sum of readings stay within the largest one
+  if (relative)
+    return std::max (existingSpent, messageSpent);
+  return existingSpent + messageSpent;
+}
+
+
+TypeId DatpFunctionMin::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFunctionMin")
+    .SetParent<DatpFunctionTyped> ()
+    .AddConstructor<DatpFunctionMin> ()
+  ;
+  return tid;
+}
+
+void
+DatpFunctionMin::ReduceFields (DatpMessage const &existing, DatpMessage const &message,
+                               uint32_t *result, const uint32_t *incoming, uint32_t words)
+{
+  for (uint32_t w = 0; w < words; ++w)
+    if (incoming[w] < result[w])
+      result[w] = incoming[w];
+}
+
+
+TypeId DatpFunctionMax::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFunctionMax")
+    .SetParent<DatpFunctionTyped> ()
+    .AddConstructor<DatpFunctionMax> ()
+  ;
+  return tid;
+}
+
+void
+DatpFunctionMax::ReduceFields (DatpMessage const &existing, DatpMessage const &message,
+                               uint32_t *result, const uint32_t *incoming, uint32_t words)
+{
+  for (uint32_t w = 0; w < words; ++w)
+    if (incoming[w] > result[w])
+      result[w] = incoming[w];
+}
+
+
+TypeId DatpFunctionMean::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFunctionMean")
+    .SetParent<DatpFunctionTyped> ()
+    .AddConstructor<DatpFunctionMean> ()
+  ;
+  return tid;
+}
+
+void
+DatpFunctionMean::ReduceFields (DatpMessage const &existing, DatpMessage const &message,
+                                uint32_t *result, const uint32_t *incoming, uint32_t words)
+{
+  uint64_t count = (uint64_t) existing.count + message.count;
+  for (uint32_t w = 0; w < words; ++w)
+    result[w] = ((uint64_t) result[w] * existing.count + (uint64_t) incoming[w] * message.count + count / 2) / count;
+}
+
+double
+DatpFunctionMean::ReduceError (DatpMessage const &existing, double existingSpent,
+                               DatpMessage const &message, double messageSpent, bool relative)
+{
+  if (relative)
+    return std::max (existingSpent, messageSpent);
+  return (existingSpent * existing.count + messageSpent * message.count) / (existing.count + message.count);
+}
+
+
+TypeId DatpFunctionLast::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFunctionLast")
+    .SetParent<DatpFunctionTyped> ()
+    .AddConstructor<DatpFunctionLast> ()
+  ;
+  return tid;
+}
+
+void
+DatpFunctionLast::ReduceFields (DatpMessage const &existing, DatpMessage const &message,
+                                uint32_t *result, const uint32_t *incoming, uint32_t words)
+{
+  if (message.timestamp >= existing.timestamp)
+    std::copy (incoming, incoming + words, result);
+}
+
+uint64_t
+DatpFunctionLast::ReduceTimestamp (DatpMessage const &existing, DatpMessage const &message)
+{
+  return std::max (existing.timestamp, message.timestamp);
+}
+
+} // namespace ns3
@@ -0,0 +1,151 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_FUNCTION_TYPED_H__
+#define __DATP_FUNCTION_TYPED_H__
+
+#include "datp-function.h"
+#include "datp-quantizer.h"
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup datp
+ * \brief Base of the functions reducing typed readings
+ *
+ * The payload of a message is an array of 32 bit unsigned readings in
+ * network order.  Messages of the same merge key are reduced field by field
+ * into one record of the same size, and the message count (DATP_HFF2_COUNT)
+ * says how many readings each field stands for.  Subclasses only provide
+ * the reduction of the fields.  Sketch, compressed, delta and fused
+ * payloads are not arrays of readings and are forwarded unmerged.
+ *
+ * With Quantize on, the readings of an application with an error budget
+ * (DatpQuantizer::SetErrorBudget) leave quantized, spending BudgetShare of
+ * the budget left at each hop.  Quantized messages are restored on arrival
+ * and the errors they carry reduced along with them.  The budget bounds
+ * the error of each reading: the mean, min, max and last of readings stay
+ * within it, but the absolute errors of a sum add up, so a sum of count
+ * readings is only bounded by count times the budget.
+ */
+class DatpFunctionTyped : public DatpFunction
+{
+public:
+  static TypeId GetTypeId (void);
+
+  DatpFunctionTyped ();
+  virtual ~DatpFunctionTyped ();
+  
+  virtual void ReceiveNewMessage (uint32_t handle);
+  virtual void Reduce (uint32_t handle);
+
+protected:
+  /**
+   * \brief Reduce the readings of message into those of existing
+   * \param result the readings of existing in host order, updated in place
+   * \param incoming the readings of message in host order
+   */
+  virtual void ReduceFields (DatpMessage const &existing, DatpMessage const &message,
+                             uint32_t *result, const uint32_t *incoming, uint32_t words) = 0;
+  /// Timestamp of the reduced message, the mean weighted by the counts unless overridden
+  virtual uint64_t ReduceTimestamp (DatpMessage const &existing, DatpMessage const &message);
+  /// Error spent on the reduced readings from that spent on each, the largest unless overridden
+  virtual double ReduceError (DatpMessage const &existing, double existingSpent,
+                              DatpMessage const &message, double messageSpent, bool relative);
+
+private:
+  /// \returns true if the payload of message is an array of readings
+  static bool HasReadings (DatpMessage const &message);
+  /// Reduce the messages of members, in order, into existingHandle and drop them
+  void Merge (uint32_t existingHandle, std::vector<uint32_t> const &members);
+  /// Quantize the readings of message handle within its error budget, before it leaves
+  void Quantize (uint32_t handle);
+  /// Restore the readings of quantized message handle, \returns false if malformed
+  bool Dequantize (uint32_t handle);
+
+  bool m_lazyMerge;
+  bool m_quantize;
+  double m_budgetShare;
+  std::vector<uint32_t> m_scratch;
+  std::vector<uint32_t> m_members;
+  std::vector<uint8_t> m_packed;
+};
+
+/// Adds up the readings
+class DatpFunctionSum : public DatpFunctionTyped
+{
+public:
+  static TypeId GetTypeId (void);
+protected:
+  virtual void ReduceFields (DatpMessage const &existing, DatpMessage const &message,
+                             uint32_t *result, const uint32_t *incoming, uint32_t words);
+  /// Absolute errors add up, to at most count times the budget
+  virtual double ReduceError (DatpMessage const &existing, double existingSpent,
+                              DatpMessage const &message, double messageSpent, bool relative);
+};
+
+/// Keeps the smallest reading
+class DatpFunctionMin : public DatpFunctionTyped
+{
+public:
+  static TypeId GetTypeId (void);
+protected:
+  virtual void ReduceFields (DatpMessage const &existing, DatpMessage const &message,
+                             uint32_t *result, const uint32_t *incoming, uint32_t words);
+};
+
+/// Keeps the largest reading
+class DatpFunctionMax : public DatpFunctionTyped
+{
+public:
+  static TypeId GetTypeId (void);
+protected:
+  virtual void ReduceFields (DatpMessage const &existing, DatpMessage const &message,
+                             uint32_t *result, const uint32_t *incoming, uint32_t words);
+};
+
+/// Keeps the mean of the readings, rounded, weighted by the message counts
+class DatpFunctionMean : public DatpFunctionTyped
+{
+public:
+  static TypeId GetTypeId (void);
+protected:
+  virtual void ReduceFields (DatpMessage const &existing, DatpMessage const &message,
+                             uint32_t *result, const uint32_t *incoming, uint32_t words);
+  /// Absolute errors average out like the readings
+  virtual double ReduceError (DatpMessage const &existing, double existingSpent,
+                              DatpMessage const &message, double messageSpent, bool relative);
+};
+
+/// Keeps the readings and timestamp of the latest message
+class DatpFunctionLast : public DatpFunctionTyped
+{
+public:
+  static TypeId GetTypeId (void);
+protected:
+  virtual void ReduceFields (DatpMessage const &existing, DatpMessage const &message,
+                             uint32_t *result, const uint32_t *incoming, uint32_t words);
+  virtual uint64_t ReduceTimestamp (DatpMessage const &existing, DatpMessage const &message);
+};
+
+} // namespace ns3
+
+#endif /* __DATP_FUNCTION_TYPED_H__ */
@@ -0,0 +1,227 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "datp-function-window.h"
+#include "datp-function-simple.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/simulator.h"
+#include "ns3/object-factory.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DatpFunctionWindow");
+
+NS_OBJECT_ENSURE_REGISTERED (DatpFunctionWindow);
+
+TypeId DatpFunctionWindow::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFunctionWindow")
+    .SetParent<DatpFunction> ()
+    .AddConstructor<DatpFunctionWindow> ()
+    .AddAttribute ("Size",
+                   "Length of a window",
+                   TimeValue (Seconds (1.0)),
+                   MakeTimeAccessor (&DatpFunctionWindow::m_size),
+                   MakeTimeChecker ())
+    .AddAttribute ("Slide",
+                   "Time between the starts of two windows, zero or Size for tumbling windows",
+                   TimeValue (Seconds (0.0)),
+                   MakeTimeAccessor (&DatpFunctionWindow::m_slide),
+                   MakeTimeChecker ())
+    .AddAttribute ("AllowedLateness",
+                   "How long after its end a window waits for late readings",
+                   TimeValue (MilliSeconds (100)),
+                   MakeTimeAccessor (&DatpFunctionWindow::m_allowedLateness),
+                   MakeTimeChecker ())
+    .AddAttribute ("FunctionType",
+                   "Type of the function reducing the messages of a window",
+                   TypeIdValue (DatpFunctionSimple::GetTypeId ()),   //needs to be set to a child of class function
+                   MakeTypeIdAccessor (&DatpFunctionWindow::m_functionTypeId),
+                   MakeTypeIdChecker ())
+  ;
+  return tid;
+}
+
+DatpFunctionWindow::DatpFunctionWindow ()
+  : m_window (0),
+    m_lateMessages (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+DatpFunctionWindow::~DatpFunctionWindow()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+DatpFunctionWindow::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  for (std::map<uint64_t,EventId>::iterator it = m_emitEvents.begin (); it != m_emitEvents.end (); ++it)
+    Simulator::Cancel (it->second);
+  m_emitEvents.clear ();
+  m_windows.clear ();
+  m_function = 0;
+  DatpFunction::DoDispose ();
+}
+
+uint32_t
+DatpFunctionWindow::GetMessagesMerged (void) const
+{
+  return m_messagesMerged + (m_function ? m_function->GetMessagesMerged () : 0);
+}
+
+uint32_t
+DatpFunctionWindow::GetBytesMerged (void) const
+{
+  return m_bytesMerged + (m_function ? m_function->GetBytesMerged () : 0);
+}
+
+uint32_t
+DatpFunctionWindow::GetLateMessages (void) const
+{
+  return m_lateMessages;
+}
+
+uint64_t
+DatpFunctionWindow::GetSlide (void) const
+{
+  return (m_slide.IsZero () || m_slide > m_size) ? m_size.GetNanoSeconds () : m_slide.GetNanoSeconds ();
+}
+
+Ptr<DatpFunction>
+DatpFunctionWindow::GetFunction (void)
+{
+  if (!m_function)
+    {
+      ObjectFactory factory;
+      factory.SetTypeId (m_functionTypeId);
+      m_function = factory.Create <DatpFunction> ();
+      m_function->SetMessageStore (m_messageStore);
+      m_function->SetMergeLookupCallback (MakeCallback (&DatpFunctionWindow::LookupWindow, this));
+      m_function->SetNewMessageCallback (MakeCallback (&DatpFunctionWindow::OpenAggregate, this));
+      m_function->SetExistingMessageCallback (MakeCallback (&DatpFunctionWindow::MergedAggregate, this));
+    }
+  return m_function;
+}
+
+void 
+DatpFunctionWindow::ReceiveNewMessage (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  const DatpMessage &message = m_messageStore->Get (handle);
+  uint64_t time = (message.hff&8) ? message.timestamp : message.receiveTime.GetNanoSeconds ();
+  uint64_t size = m_size.GetNanoSeconds ();
+  uint64_t slide = GetSlide ();
+  NS_ASSERT_MSG (size > 0, "Window size must not be zero");
+
+  //window k covers [k * slide, k * slide + size), the watermark closes the early ones,
+  //a window aggregate of a child goes into the one window it starts, once
+  int64_t watermark = Simulator::Now ().GetNanoSeconds () - m_allowedLateness.GetNanoSeconds ();
+  uint64_t last = time / slide;
+  uint64_t first = last;
+  if (!message.IsWindow ())
+    first = time >= size ? (time - size) / slide + 1 : 0;
+  while (first <= last && (int64_t) (first * slide + size) <= watermark)
+    ++first;
+  if (first > last)
+    {
+      NS_LOG_INFO ("Late message Id: " << handle);
+      ++m_lateMessages;
+      NotifyNewMessage (handle);
+      return;
+    }
+
+  for (uint64_t k = first; k <= last; ++k)
+    {
+      if (m_windows.find (k) == m_windows.end ())
+        {
+          m_windows[k];
+          Time emit = NanoSeconds (k * slide + size) + m_allowedLateness - Simulator::Now ();
+          m_emitEvents[k] = Simulator::Schedule (emit, &DatpFunctionWindow::Emit, this, k);
+        }
+      //the message itself goes into the last window, copies of a reading into the others
+      m_window = k;
+      GetFunction ()->ReceiveNewMessage (k == last ? handle : m_messageStore->Copy (handle));
+    }
+}
+
+void
+DatpFunctionWindow::Reduce (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  GetFunction ()->Reduce (handle);
+}
+
+void
+DatpFunctionWindow::NotifyParentChange (void)
+{
+  NS_LOG_FUNCTION (this);
+  GetFunction ()->NotifyParentChange ();
+}
+
+uint32_t
+DatpFunctionWindow::LookupWindow (uint64_t mergeKey)
+{
+  std::map<uint64_t,uint32_t> &aggregates = m_windows[m_window];
+  std::map<uint64_t,uint32_t>::const_iterator it = aggregates.find (mergeKey);
+  return it == aggregates.end () ? 0 : it->second;
+}
+
+void
+DatpFunctionWindow::OpenAggregate (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  m_windows[m_window][m_messageStore->GetMergeKey (handle)] = handle;
+}
+
+void
+DatpFunctionWindow::MergedAggregate (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+}
+
+void
+DatpFunctionWindow::Emit (uint64_t window)
+{
+  NS_LOG_FUNCTION (this << window);
+  m_emitEvents.erase (window);
+  std::map<uint64_t,std::map<uint64_t,uint32_t> >::iterator it = m_windows.find (window);
+  if (it == m_windows.end ())
+    return;
+  uint64_t start = window * GetSlide ();
+  std::map<uint64_t,uint32_t> aggregates;
+  aggregates.swap (it->second);
+  m_windows.erase (it);
+  for (std::map<uint64_t,uint32_t>::iterator aggregate = aggregates.begin (); aggregate != aggregates.end (); ++aggregate)
+    {
+      GetFunction ()->Reduce (aggregate->second);
+      DatpMessage &message = m_messageStore->Get (aggregate->second);
+      message.timestamp = start;
+      message.hff |= 8;
+      message.encodingFlags |= DATP_HFF3_WINDOW;
+      NS_LOG_INFO ("Window " << window << " emits Id: " << aggregate->second);
+      NotifyNewMessage (aggregate->second);
+    }
+}
+
+} // namespace ns3
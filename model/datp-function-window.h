@@ -0,0 +1,93 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_FUNCTION_WINDOW_H__
+#define __DATP_FUNCTION_WINDOW_H__
+
+#include "datp-function.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/type-id.h"
+#include <map>
+
+namespace ns3 {
+
+/**
+ * \ingroup datp
+ * \brief Aggregates readings over fixed windows of their timestamps
+ *
+ * A message belongs to the windows its timestamp (or, without one, its
+ * receive time) falls in: one window of Size every Size (tumbling), or
+ * every Slide when Slide is shorter (sliding, the message is copied into
+ * each of its windows).  Inside a window, messages of the same merge key
+ * are reduced by an inner function (FunctionType), whatever the scheduler
+ * hold.  Once the watermark, the current time less AllowedLateness, passes
+ * the end of a window, the window emits one message per merge key, stamped
+ * with the start of the window and marked DATP_HFF3_WINDOW.  A parent files
+ * such an aggregate into the one window starting there, without copies, so
+ * sliding windows count it once; this only lines up when the parent has the
+ * same Size and Slide as its children, and a longer AllowedLateness to cover
+ * their lateness and the hop.  A message whose windows all closed already
+ * is late and is forwarded on its own.
+ */
+class DatpFunctionWindow : public DatpFunction
+{
+public:
+  static TypeId GetTypeId (void);
+
+  DatpFunctionWindow ();
+  virtual ~DatpFunctionWindow ();
+
+  virtual void ReceiveNewMessage (uint32_t handle);
+  virtual void Reduce (uint32_t handle);
+  virtual void NotifyParentChange (void);
+  virtual uint32_t GetMessagesMerged (void) const;
+  virtual uint32_t GetBytesMerged (void) const;
+  /// Messages forwarded on their own, past their windows
+  uint32_t GetLateMessages (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /// The inner function, created on first use
+  Ptr<DatpFunction> GetFunction (void);
+  /// Time between window starts in nanoseconds, the size for tumbling windows
+  uint64_t GetSlide (void) const;
+  /// Merge lookup of the inner function, within the current window
+  uint32_t LookupWindow (uint64_t mergeKey);
+  void OpenAggregate (uint32_t handle);
+  void MergedAggregate (uint32_t handle);
+  void Emit (uint64_t window);
+
+  Time m_size;
+  Time m_slide;
+  Time m_allowedLateness;
+  TypeId m_functionTypeId;
+  Ptr<DatpFunction> m_function;
+  uint64_t m_window;    //window of the message being handed to m_function
+  uint32_t m_lateMessages;
+  std::map<uint64_t,std::map<uint64_t,uint32_t> > m_windows;   //window, merge key, aggregate
+  std::map<uint64_t,EventId> m_emitEvents;
+};
+
+} // namespace ns3
+
+#endif /* __DATP_FUNCTION_WINDOW_H__ */
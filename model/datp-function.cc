@@ -36,6 +36,9 @@ TypeId DatpFunction::GetTypeId (void)
 }
 
 DatpFunction::DatpFunction ()
+  : m_messagesMerged (0),
+    m_bytesMerged (0),
+    m_messagesForwarded (0)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -45,49 +48,95 @@ DatpFunction::~DatpFunction()
   NS_LOG_FUNCTION (this);
 }
 
+uint32_t
+DatpFunction::GetMessagesMerged (void) const
+{
+  return m_messagesMerged;
+}
+
+uint32_t
+DatpFunction::GetBytesMerged (void) const
+{
+  return m_bytesMerged;
+}
+
+uint32_t
+DatpFunction::GetMessagesForwarded (void) const
+{
+  return m_messagesForwarded;
+}
+
+void
+DatpFunction::Reduce (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+}
+
+void
+DatpFunction::NotifyParentChange (void)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+DatpFunction::SetMessageStore (Ptr<DatpMessageStore> messageStore)
+{
+  NS_LOG_FUNCTION (this << messageStore);
+  m_messageStore = messageStore;
+}
+
 void 
-DatpFunction::SetQueryCallback (Callback<void, DatpHeader > query)
+DatpFunction::SetMergeLookupCallback (Callback<uint32_t, uint64_t> mergeLookup)
 {
-  NS_LOG_FUNCTION (this << &query);
-  m_query = query;
+  NS_LOG_FUNCTION (this << &mergeLookup);
+  m_mergeLookup = mergeLookup;
 }
 
 void 
-DatpFunction::SetNewMessageCallback (Callback<void, DatpHeader, Ptr<Packet> > newMessage)
+DatpFunction::SetNewMessageCallback (Callback<void, uint32_t> newMessage)
 {
   NS_LOG_FUNCTION (this << &newMessage);
   m_newMessage = newMessage;
 }
 
 void 
-DatpFunction::SetExistingMessageCallback (Callback<void, DatpHeader, Ptr<Packet> > existingMessage)
+DatpFunction::SetExistingMessageCallback (Callback<void, uint32_t> existingMessage)
 {
   NS_LOG_FUNCTION (this << &existingMessage);
   m_existingMessage = existingMessage;
 }
 
-void 
-DatpFunction::NotifyQuery (DatpHeader datpHeader)
+uint32_t
+DatpFunction::LookupMergePartner (uint32_t handle)
 {
-  NS_LOG_FUNCTION (this);
-  if (!m_query.IsNull ())
-    m_query (datpHeader);
+  NS_LOG_FUNCTION (this << handle);
+  return LookupMergeKey (m_messageStore->GetMergeKey (handle));
+}
+
+uint32_t
+DatpFunction::LookupMergeKey (uint64_t mergeKey)
+{
+  NS_LOG_FUNCTION (this << mergeKey);
+  if (m_mergeLookup.IsNull ())
+    return 0;
+  return m_mergeLookup (mergeKey);
 }
 
 void 
-DatpFunction::NotifyNewMessage (DatpHeader datpHeader, Ptr<Packet> packet)
+DatpFunction::NotifyNewMessage (uint32_t handle)
 {
-  NS_LOG_FUNCTION (this);
+  NS_LOG_FUNCTION (this << handle);
+  ++m_messagesForwarded;
   if (!m_newMessage.IsNull ())
-    m_newMessage (datpHeader, packet);
+    m_newMessage (handle);
 }
 
 void 
-DatpFunction::NotifyExistingMessage (DatpHeader datpHeader, Ptr<Packet> packet)
+DatpFunction::NotifyExistingMessage (uint32_t handle)
 {
-  NS_LOG_FUNCTION (this);
+  NS_LOG_FUNCTION (this << handle);
   if (!m_existingMessage.IsNull ())
-    m_existingMessage (datpHeader, packet);
+    m_existingMessage (handle);
 }
 
 } // namespace ns3
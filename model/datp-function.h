@@ -22,6 +22,7 @@
 #define __DATP_FUNCTION_H__
 
 #include "datp-headers.h"
+#include "datp-message.h"
 #include "ns3/packet.h"
 #include "ns3/callback.h"
 #include "ns3/object.h"
@@ -36,27 +37,42 @@ public:
   DatpFunction ();
   virtual ~DatpFunction ();
   
-  virtual void ReceiveQueryResponse (DatpHeader datpHeader, Ptr<Packet> packet) = 0;
-  virtual void ReceiveNewMessage (DatpHeader datpHeader, Ptr<Packet> packet) = 0;
+  virtual void ReceiveNewMessage (uint32_t handle) = 0;
+  /// Merge the messages waiting in the group of handle, called before it is ejected
+  virtual void Reduce (uint32_t handle);
+  /// The aggregator got a new parent, which holds none of the state sent so far
+  virtual void NotifyParentChange (void);
   
-  void SetQueryCallback (Callback<void, DatpHeader > query);
-  void SetNewMessageCallback (Callback<void, DatpHeader, Ptr<Packet> > newMessage);
-  void SetExistingMessageCallback (Callback<void, DatpHeader, Ptr<Packet> > existingMessage);
+  virtual uint32_t GetMessagesMerged (void) const;
+  virtual uint32_t GetBytesMerged (void) const;
+  /// Messages handed on as new to the next receiver, a stage may hand on more than reached it
+  uint32_t GetMessagesForwarded (void) const;
+  
+  void SetMessageStore (Ptr<DatpMessageStore> messageStore);
+  /// Lookup of the buffered message a new message with the given merge key merges into
+  void SetMergeLookupCallback (Callback<uint32_t, uint64_t> mergeLookup);
+  void SetNewMessageCallback (Callback<void, uint32_t> newMessage);
+  void SetExistingMessageCallback (Callback<void, uint32_t> existingMessage);
   
 protected:
 
-  void NotifyQuery (DatpHeader datpHeader);
-  void NotifyNewMessage (DatpHeader datpHeader, Ptr<Packet> packet);
-  void NotifyExistingMessage (DatpHeader datpHeader, Ptr<Packet> packet);
+  /// Buffered message that handle merges into, 0 if none
+  uint32_t LookupMergePartner (uint32_t handle);
+  /// Buffered message a message with mergeKey merges into, 0 if none
+  uint32_t LookupMergeKey (uint64_t mergeKey);
+  void NotifyNewMessage (uint32_t handle);
+  void NotifyExistingMessage (uint32_t handle);
 
-  DatpHeader m_existingMessageDatpHeader;
-  Ptr<Packet> m_existingMessagePacket;
+  Ptr<DatpMessageStore> m_messageStore;
+  uint32_t m_messagesMerged;
+  uint32_t m_bytesMerged;
 
 private:
+  uint32_t m_messagesForwarded;
   
-  Callback<void, DatpHeader > m_query;
-  Callback<void, DatpHeader, Ptr<Packet> > m_newMessage;
-  Callback<void, DatpHeader, Ptr<Packet> > m_existingMessage;
+  Callback<uint32_t, uint64_t> m_mergeLookup;
+  Callback<void, uint32_t> m_newMessage;
+  Callback<void, uint32_t> m_existingMessage;
 };
 
 } // namespace ns3
@@ -0,0 +1,148 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+#include "datp-header-context.h"
+
+NS_LOG_COMPONENT_DEFINE ("DatpHeaderContext");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (DatpHeaderContext);
+
+TypeId
+DatpHeaderContext::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpHeaderContext")
+    .SetParent<Object> ()
+    .AddConstructor<DatpHeaderContext> ()
+    .AddAttribute ("MaxContexts",
+                   "Number of contexts a sender keeps towards its parent",
+                   UintegerValue (32),
+                   MakeUintegerAccessor (&DatpHeaderContext::m_maxContexts),
+                   MakeUintegerChecker<uint32_t> (1, 128))
+    .AddAttribute ("RefreshInterval",
+                   "Establish a context again after this many uses",
+                   UintegerValue (16),
+                   MakeUintegerAccessor (&DatpHeaderContext::m_refreshInterval),
+                   MakeUintegerChecker<uint32_t> (1))
+  ;
+  return tid;
+}
+
+DatpHeaderContext::DatpHeaderContext ()
+  : m_maxContexts (32),
+    m_refreshInterval (16),
+    m_nextId (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+DatpHeaderContext::~DatpHeaderContext ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+DatpHeaderContext::Compress (DatpHeader &datpHeader)
+{
+  NS_LOG_FUNCTION (this);
+  uint8_t flags = datpHeader.GetHeaderFieldFlags () & (64|32|16);
+  if (!flags)
+    return;  //nothing to leave out
+
+  uint64_t key = ((uint64_t)flags << 48) | ((uint64_t)datpHeader.GetPriority () << 40)
+    | ((uint64_t)datpHeader.GetApplication () << 32) | datpHeader.GetOrigin ();
+  uint8_t id;
+  std::map<uint64_t,uint8_t>::iterator it = m_compressorIds.find (key);
+  if (it != m_compressorIds.end ())
+    {
+      id = it->second;
+    }
+  else
+    {
+      //IDs are taken over round robin, the oldest combination loses its context
+      if (m_compressorKeys.size () < m_maxContexts)
+        {
+          m_compressorKeys.resize (m_maxContexts);
+          m_compressorUses.resize (m_maxContexts, 0);
+        }
+      id = m_nextId;
+      m_nextId = (m_nextId + 1) % m_maxContexts;
+      if (m_compressorUses[id])
+        m_compressorIds.erase (m_compressorKeys[id]);
+      m_compressorIds[key] = id;
+      m_compressorKeys[id] = key;
+      m_compressorUses[id] = 0;
+    }
+
+  bool establish = (m_compressorUses[id] % m_refreshInterval == 0);
+  ++m_compressorUses[id];
+  NS_LOG_LOGIC ("Context " << (uint32_t) id << (establish ? " established" : " used"));
+  datpHeader.SetContext (establish ? (id | DATP_CONTEXT_ESTABLISH) : id);
+}
+
+bool
+DatpHeaderContext::Expand (Address const &from, DatpMessageDescriptor &d)
+{
+  NS_LOG_FUNCTION (this << from << (uint32_t) d.context);
+  std::vector<Context> &contexts = m_decompressor[from];
+  if (contexts.empty ())
+    {
+      Context unknown = { 0, 0, 0, 0 };
+      contexts.resize (128, unknown);
+    }
+  Context &context = contexts[d.context & ~DATP_CONTEXT_ESTABLISH];
+
+  if (d.context & DATP_CONTEXT_ESTABLISH)
+    {
+      context.flags = d.hff & (64|32|16);
+      context.origin = d.origin;
+      context.application = d.application;
+      context.priority = d.priority;
+      return (context.flags != 0);
+    }
+  if (!context.flags)
+    return false;
+
+  //fields carried by the message itself take precedence
+  uint8_t inherited = context.flags & ~d.hff;
+  if (inherited&64)
+    d.origin = context.origin;
+  if (inherited&32)
+    d.application = context.application;
+  if (inherited&16)
+    d.priority = context.priority;
+  d.hff |= inherited;
+  return true;
+}
+
+void
+DatpHeaderContext::Reset (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_compressorIds.clear ();
+  m_compressorKeys.clear ();
+  m_compressorUses.clear ();
+  m_nextId = 0;
+}
+
+} // namespace ns3
@@ -0,0 +1,87 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_HEADER_CONTEXT_H__
+#define __DATP_HEADER_CONTEXT_H__
+
+#include "ns3/object.h"
+#include "ns3/address.h"
+#include "datp-headers.h"
+#include "datp-header-view.h"
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup datp header
+ * \brief Per link contexts for the static fields of Datp messages
+ *
+ * The origin, application and priority of a flow rarely change, so a sender
+ * numbers each combination it sends to its parent and, after the first
+ * message, only carries the context ID (DATP_HFF2_CONTEXT).  The message
+ * defining a context has DATP_CONTEXT_ESTABLISH set and carries every field;
+ * it is repeated every RefreshInterval uses so a lost one only costs the
+ * messages up to the next refresh.  Contexts are forgotten when the parent
+ * changes, the receiver keeps the contexts of each sender apart.
+ */
+class DatpHeaderContext : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  DatpHeaderContext ();
+  virtual ~DatpHeaderContext ();
+
+  /// Sender side: make datpHeader refer to the context of its static fields
+  void Compress (DatpHeader &datpHeader);
+  /**
+   * \brief Receiver side: fill in the static fields of a context member
+   * \returns false if the context was never established by from
+   */
+  bool Expand (Address const &from, DatpMessageDescriptor &descriptor);
+  /// Sender side: forget every context, the next messages establish them again
+  void Reset (void);
+
+private:
+  struct Context
+  {
+    uint8_t flags;        //!< HFF flags of the static fields, zero if unknown
+    uint32_t origin;
+    uint8_t application;
+    uint8_t priority;
+  };
+
+  uint32_t m_maxContexts;
+  uint32_t m_refreshInterval;
+
+  //compressor, static fields packed in a key to context ID
+  std::map<uint64_t,uint8_t> m_compressorIds;
+  std::vector<uint64_t> m_compressorKeys;
+  std::vector<uint32_t> m_compressorUses;
+  uint8_t m_nextId;
+
+  //decompressor, contexts indexed by ID for each sender
+  std::map<Address,std::vector<Context> > m_decompressor;
+};
+
+} // namespace ns3
+
+#endif /* __DATP_HEADER_CONTEXT_H__ */
@@ -0,0 +1,395 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "datp-header-view.h"
+#include "datp-header-context.h"
+#include <cstring>
+
+NS_LOG_COMPONENT_DEFINE ("DatpHeaderView");
+
+namespace ns3 {
+
+static inline uint32_t
+ReadNtohU32 (const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline uint64_t
+ReadNtohU64 (const uint8_t *p)
+{
+  return ((uint64_t)ReadNtohU32 (p) << 32) | (uint64_t)ReadNtohU32 (p + 4);
+}
+
+DatpHeaderView::DatpHeaderView ()
+  : m_valid (false),
+    m_nDropped (0),
+    m_contextMembers (false),
+    m_framed (false)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+DatpHeaderView::DatpHeaderView (Ptr<const Packet> packet)
+  : m_valid (false),
+    m_nDropped (0),
+    m_contextMembers (false),
+    m_framed (false)
+{
+  NS_LOG_FUNCTION (this << packet);
+  Parse (packet);
+}
+
+bool
+DatpHeaderView::Parse (Ptr<const Packet> packet, Ptr<DatpHeaderContext> context, Address const &from)
+{
+  NS_LOG_FUNCTION (this << packet << context << from);
+  m_packet = packet;
+  m_messages.clear ();
+  m_nDropped = 0;
+  m_contextMembers = false;
+  uint32_t size = packet->GetSize ();
+  m_buffer.resize (size);
+  if (size > 0)
+    packet->CopyData (&m_buffer[0], size);
+
+  m_valid = false;
+  if (!ReadFrame ())
+    return m_valid;
+
+  uint32_t offset = m_framed ? m_frameOffsets.front () : 0;
+  uint32_t index = 0;
+  uint32_t bundleFirst = 0;
+  bool bundleDropped = false;
+  bool started = false;
+  while (offset < size)
+    {
+      DatpMessageDescriptor descriptor;
+      if (!Decode (offset, descriptor))
+        {
+          NS_LOG_INFO ("Truncated message at offset " << offset << " of " << size);
+          return m_valid;
+        }
+      offset = descriptor.payloadOffset + descriptor.dataLength;
+      if (m_framed && descriptor.headerSize + descriptor.dataLength != m_frameSizes[index])
+        {
+          NS_LOG_INFO ("Message " << index << " does not match the frame header");
+          return m_valid;
+        }
+      ++index;
+      if (!(descriptor.sizeModifiers & DATP_HFF2_BUNDLE))
+        {
+          started = true;
+          bundleDropped = false;
+          if (descriptor.sizeModifiers & DATP_HFF2_CONTEXT)
+            {
+              m_contextMembers = true;
+              if (!context || !context->Expand (from, descriptor))
+                {
+                  NS_LOG_INFO ("Unknown context " << (uint32_t) descriptor.context << " at offset " << descriptor.offset);
+                  bundleDropped = true;
+                  ++m_nDropped;
+                  continue;
+                }
+            }
+          bundleFirst = m_messages.size ();
+        }
+      else if (!started)
+        {
+          NS_LOG_INFO ("Bundle member without a first message at offset " << descriptor.offset);
+          return m_valid;
+        }
+      else if (bundleDropped)
+        {
+          ++m_nDropped;
+          continue;
+        }
+      else
+        {
+          ExpandBundleMember (descriptor, m_messages[bundleFirst], m_messages.back ());
+        }
+      m_messages.push_back (descriptor);
+    }
+  m_valid = (!m_framed || index == m_frameSizes.size ());
+  return m_valid;
+}
+
+bool
+DatpHeaderView::ParseFrame (Ptr<const Packet> packet)
+{
+  NS_LOG_FUNCTION (this << packet);
+  m_packet = packet;
+  m_messages.clear ();
+  m_nDropped = 0;
+  m_contextMembers = false;
+  uint32_t size = packet->GetSize ();
+  m_buffer.resize (size);
+  if (size > 0)
+    packet->CopyData (&m_buffer[0], size);
+  m_valid = ReadFrame () && m_framed;
+  return m_valid;
+}
+
+bool
+DatpHeaderView::ReadFrame (void)
+{
+  m_framed = false;
+  m_frameSizes.clear ();
+  m_frameOffsets.clear ();
+  if (m_buffer.empty () || !DatpFrameHeader::IsFrame (m_buffer[0]))
+    return true;
+
+  uint32_t offset = DatpFrameHeader::Read (&m_buffer[0], m_buffer.size (), m_frameSizes);
+  if (!offset || m_frameSizes.empty ())
+    {
+      NS_LOG_INFO ("Bad frame header");
+      return false;
+    }
+  for (uint32_t m = 0; m < m_frameSizes.size (); ++m)
+    {
+      m_frameOffsets.push_back (offset);
+      offset += m_frameSizes[m];
+    }
+  if (offset != m_buffer.size ())
+    {
+      NS_LOG_INFO ("Frame header accounts for " << offset << " bytes of " << m_buffer.size ());
+      return false;
+    }
+  m_framed = true;
+  return true;
+}
+
+bool
+DatpHeaderView::HasFrame (void) const
+{
+  return m_framed;
+}
+
+uint32_t
+DatpHeaderView::GetFrameNMessages (void) const
+{
+  return m_frameSizes.size ();
+}
+
+uint32_t
+DatpHeaderView::GetFrameOffset (uint32_t index) const
+{
+  NS_ASSERT (index < m_frameOffsets.size ());
+  return m_frameOffsets[index];
+}
+
+bool
+DatpHeaderView::DecodeFramed (uint32_t index, DatpMessageDescriptor &descriptor) const
+{
+  NS_LOG_FUNCTION (this << index);
+  NS_ASSERT (index < m_frameOffsets.size ());
+  if (!Decode (m_frameOffsets[index], descriptor))
+    return false;
+  if (descriptor.sizeModifiers & (DATP_HFF2_BUNDLE | DATP_HFF2_CONTEXT))
+    return false;
+  return (descriptor.headerSize + descriptor.dataLength == m_frameSizes[index]);
+}
+
+bool
+DatpHeaderView::IsValid (void) const
+{
+  return m_valid;
+}
+
+uint32_t
+DatpHeaderView::GetNMessages (void) const
+{
+  return m_messages.size ();
+}
+
+uint32_t
+DatpHeaderView::GetNDropped (void) const
+{
+  return m_nDropped;
+}
+
+bool
+DatpHeaderView::HasContextMembers (void) const
+{
+  return m_contextMembers;
+}
+
+const DatpMessageDescriptor &
+DatpHeaderView::GetMessage (uint32_t index) const
+{
+  NS_ASSERT (index < m_messages.size ());
+  return m_messages[index];
+}
+
+DatpHeader
+DatpHeaderView::GetHeader (uint32_t index) const
+{
+  const DatpMessageDescriptor &d = GetMessage (index);
+  DatpHeader datpHeader;
+  if (d.hff&64)
+    datpHeader.SetOrigin (d.origin);
+  if (d.hff&32)
+    datpHeader.SetApplication (d.application);
+  if (d.hff&16)
+    datpHeader.SetPriority (d.priority);
+  if (d.hff&8)
+    datpHeader.SetTimestamp (d.timestamp);
+  if (d.hff&4)
+    datpHeader.SetDataLength (d.dataLength);
+  if (d.hff&2)
+    datpHeader.SetSequence (d.sequence);
+  datpHeader.SetCount (d.count);
+  datpHeader.SetSketch (d.sizeModifiers & DATP_HFF2_SKETCH);
+  datpHeader.SetCompressed (d.encodingFlags & DATP_HFF3_COMPRESSED);
+  datpHeader.SetQuantized (d.encodingFlags & DATP_HFF3_QUANTIZED);
+  datpHeader.SetDelta (d.encodingFlags & DATP_HFF3_DELTA);
+  datpHeader.SetFused (d.encodingFlags & DATP_HFF3_FUSED);
+  datpHeader.SetWindow (d.encodingFlags & DATP_HFF3_WINDOW);
+  return datpHeader;
+}
+
+Ptr<Packet>
+DatpHeaderView::GetPayload (uint32_t index) const
+{
+  return GetPayload (GetMessage (index));
+}
+
+Ptr<Packet>
+DatpHeaderView::GetPayload (DatpMessageDescriptor const &d) const
+{
+  return m_packet->CreateFragment (d.payloadOffset, d.dataLength);
+}
+
+uint32_t
+DatpHeaderView::ReadPayloadU32 (uint32_t index, uint32_t word) const
+{
+  const DatpMessageDescriptor &d = GetMessage (index);
+  NS_ASSERT ((word + 1) * 4 <= d.dataLength);
+  return ReadNtohU32 (&m_buffer[d.payloadOffset + word * 4]);
+}
+
+void
+DatpHeaderView::ExpandBundleMember (DatpMessageDescriptor &d, DatpMessageDescriptor const &first, DatpMessageDescriptor const &previous) const
+{
+  uint8_t inherited = previous.hff & (64|32|16) & ~d.hff;
+  if (inherited&64)
+    d.origin = previous.origin;
+  if (inherited&32)
+    d.application = previous.application;
+  if (inherited&16)
+    d.priority = previous.priority;
+  if (first.hff&8)
+    d.timestamp = first.timestamp + ((d.hff&8) ? DatpHeader::DecodeZigZag (d.timestamp) : 0);
+  d.hff |= inherited | (first.hff&8);
+}
+
+bool
+DatpHeaderView::Decode (uint32_t offset, DatpMessageDescriptor &d) const
+{
+  uint32_t left = m_buffer.size () - offset;
+  const uint8_t *p = &m_buffer[offset];
+  uint32_t chainSize = 1;
+
+  d.offset = offset;
+  d.hff = p[0];
+  d.sizeModifiers = 0;
+  d.encodingFlags = 0;
+  if (d.hff & DATP_HFF_CHAIN)
+    {
+      //HFF2 holds the size modifiers, HFF3 the encoding flags, any further HFF is skipped
+      uint8_t hff;
+      do
+        {
+          if (chainSize >= left || chainSize >= DATP_HFF_CHAIN_MAX)
+            return false;
+          hff = p[chainSize++];
+        }
+      while (hff & DATP_HFF_CHAIN);
+      d.sizeModifiers = p[1] & ~DATP_HFF_CHAIN;
+      if (chainSize > 2)
+        d.encodingFlags = p[2] & ~DATP_HFF_CHAIN;
+    }
+  d.context = 0;
+  if (d.sizeModifiers & DATP_HFF2_CONTEXT)
+    {
+      if (chainSize >= left)
+        return false;
+      d.context = p[chainSize++];
+    }
+  const DatpHffLayout &layout = DatpHeader::GetLayout (DatpHeader::GetFixedFlags (d.hff, d.sizeModifiers));
+  uint32_t size = chainSize + layout.size - 1;
+  if (left < size)
+    return false;
+
+  //same straight-line copy as DatpHeader::Deserialize
+  uint8_t buffer[DATP_HFF_SCRATCH];
+  memcpy (buffer + 1, p + chainSize, layout.size - 1);
+  memset (buffer + DATP_HFF_SINK, 0, DATP_HFF_SCRATCH - DATP_HFF_SINK);
+  d.origin = ReadNtohU32 (buffer + layout.origin);
+  d.application = buffer[layout.application];
+  d.priority = buffer[layout.priority];
+  d.timestamp = ReadNtohU64 (buffer + layout.timestamp);
+  d.dataLength = buffer[layout.dataLength];
+  d.sequence = ReadNtohU32 (buffer + layout.sequence);
+  d.count = 1;
+
+  if (d.sizeModifiers)
+    {
+      uint64_t value;
+      uint32_t read;
+      if (d.sizeModifiers & DATP_HFF2_VARINT_TIMESTAMP)
+        {
+          if (!(read = DatpHeader::ReadVarint (p + size, left - size, value)))
+            return false;
+          d.timestamp = value;
+          size += read;
+        }
+      if (d.sizeModifiers & DATP_HFF2_VARINT_LENGTH)
+        {
+          if (!(read = DatpHeader::ReadVarint (p + size, left - size, value)) || value > 0xffffffff)
+            return false;
+          d.dataLength = value;
+          size += read;
+        }
+      if (d.sizeModifiers & DATP_HFF2_VARINT_SEQUENCE)
+        {
+          if (!(read = DatpHeader::ReadVarint (p + size, left - size, value)) || value > 0xffffffff)
+            return false;
+          d.sequence = value;
+          size += read;
+        }
+      if (d.sizeModifiers & DATP_HFF2_COUNT)
+        {
+          //a count of zero readings would divide the averages by zero
+          if (!(read = DatpHeader::ReadVarint (p + size, left - size, value)) || value == 0 || value > 0xffffffff)
+            return false;
+          d.count = value;
+          size += read;
+        }
+    }
+
+  d.headerSize = size;
+  d.payloadOffset = offset + size;
+  return (left - size >= d.dataLength);
+}
+
+} // namespace ns3
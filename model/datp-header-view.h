@@ -0,0 +1,142 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_HEADER_VIEW_H__
+#define __DATP_HEADER_VIEW_H__
+
+#include "ns3/packet.h"
+#include "ns3/address.h"
+#include "datp-headers.h"
+#include <vector>
+
+namespace ns3 {
+
+class DatpHeaderContext;
+
+/**
+ * \ingroup datp header
+ * \brief Flat description of one message found inside a Datp packet
+ *
+ * Fields not flagged in the HFF keep the DatpHeader defaults (zero).
+ * Bundle members are expanded: the fields they inherit are filled in and
+ * flagged in hff, and the timestamp is absolute.  Context members are
+ * expanded the same way from the link context of their sender.
+ */
+struct DatpMessageDescriptor
+{
+  uint32_t offset;          //!< offset of the HFF byte within the packet
+  uint8_t hff;
+  uint8_t sizeModifiers;    //!< HFF2, zero when the HFF is not chained
+  uint8_t encodingFlags;    //!< HFF3, zero when HFF2 is not chained
+  uint8_t context;          //!< context ID byte when HFF2 has DATP_HFF2_CONTEXT
+  uint8_t headerSize;
+  uint32_t origin;
+  uint8_t application;
+  uint8_t priority;
+  uint64_t timestamp;
+  uint32_t dataLength;
+  uint32_t sequence;
+  uint32_t count;           //!< readings reduced into the message, 1 without DATP_HFF2_COUNT
+  uint32_t payloadOffset;   //!< offset of the first payload byte within the packet
+};
+
+/**
+ * \ingroup datp header
+ * \brief Read-only view over the concatenated messages of a Datp packet
+ *
+ * The packet bytes are copied out once and walked in a single pass, filling
+ * a flat array of message descriptors.  No Header objects are built and the
+ * packet itself is never modified, so the same packet may be forwarded as is.
+ * A view can be reused for many packets; its storage keeps its capacity.
+ * Bundle encoded messages (DATP_HFF2_BUNDLE) are expanded transparently,
+ * so are context members (DATP_HFF2_CONTEXT) when a DatpHeaderContext is
+ * given.  A context member whose context is unknown, because the message
+ * establishing it was lost, is dropped along with the rest of its bundle.
+ *
+ * A packet may start with a DatpFrameHeader.  Parse then checks the message
+ * count and sizes against the index before and while decoding.  ParseFrame
+ * only reads the index, so single messages can be picked with DecodeFramed
+ * without decoding the ones before them.
+ */
+class DatpHeaderView
+{
+public:
+  DatpHeaderView ();
+  DatpHeaderView (Ptr<const Packet> packet);
+
+  /**
+   * \brief Walk the messages of a packet, replacing any previous contents
+   * \param context link contexts used to expand context members, if any
+   * \param from the sender of packet, selecting its link contexts
+   * \returns true if the whole packet parsed into complete messages
+   */
+  bool Parse (Ptr<const Packet> packet, Ptr<DatpHeaderContext> context = 0, Address const &from = Address ());
+  bool IsValid (void) const;
+
+  uint32_t GetNMessages (void) const;
+  /// Messages dropped for lack of their context
+  uint32_t GetNDropped (void) const;
+  /// Whether any message of the packet referred to a link context
+  bool HasContextMembers (void) const;
+
+  /**
+   * \brief Read only the frame header of a packet, replacing any previous contents
+   * \returns true if the packet has a frame header matching its size
+   */
+  bool ParseFrame (Ptr<const Packet> packet);
+  bool HasFrame (void) const;
+  uint32_t GetFrameNMessages (void) const;
+  /// Offset of the HFF byte of message index within the packet
+  uint32_t GetFrameOffset (uint32_t index) const;
+  /**
+   * \brief Decode message index of a framed packet on its own
+   * \returns false if the message is truncated, or is a bundle or context
+   *          member and so needs the messages before it (use Parse)
+   */
+  bool DecodeFramed (uint32_t index, DatpMessageDescriptor &descriptor) const;
+  const DatpMessageDescriptor & GetMessage (uint32_t index) const;
+
+  /// Build a DatpHeader carrying the same fields as message index
+  DatpHeader GetHeader (uint32_t index) const;
+  /// Fragment of the packet holding the payload of message index
+  Ptr<Packet> GetPayload (uint32_t index) const;
+  Ptr<Packet> GetPayload (DatpMessageDescriptor const &descriptor) const;
+  /// Read the word-th 32 bit network order value of the payload of message index
+  uint32_t ReadPayloadU32 (uint32_t index, uint32_t word) const;
+
+private:
+  bool ReadFrame (void);
+  bool Decode (uint32_t offset, DatpMessageDescriptor &descriptor) const;
+  void ExpandBundleMember (DatpMessageDescriptor &descriptor, DatpMessageDescriptor const &first, DatpMessageDescriptor const &previous) const;
+
+  Ptr<const Packet> m_packet;
+  std::vector<uint8_t> m_buffer;
+  std::vector<DatpMessageDescriptor> m_messages;
+  bool m_valid;
+  uint32_t m_nDropped;
+  bool m_contextMembers;
+  bool m_framed;
+  std::vector<uint32_t> m_frameSizes;
+  std::vector<uint32_t> m_frameOffsets;
+};
+
+} // namespace ns3
+
+#endif /* __DATP_HEADER_VIEW_H__ */
@@ -23,11 +23,83 @@
 #include "ns3/header.h"
 #include "ns3/nstime.h"
 #include "datp-headers.h"
+#include <cstring>
 
 NS_LOG_COMPONENT_DEFINE ("DatpHeader");
 
 namespace ns3 {
 
+/*
+ * Field offsets for one HFF value, computed by the compiler.  The field
+ * order on the wire is origin, application, priority, timestamp, data
+ * length and sequence, each one present only when its flag is set.
+ */
+template <uint8_t H>
+struct DatpHffLayoutOf
+{
+  enum
+  {
+    ORIGIN = 1,
+    APPLICATION = ORIGIN + ((H&64) ? 4 : 0),
+    PRIORITY = APPLICATION + ((H&32) ? 1 : 0),
+    TIMESTAMP = PRIORITY + ((H&16) ? 1 : 0),
+    DATALENGTH = TIMESTAMP + ((H&8) ? 8 : 0),
+    SEQUENCE = DATALENGTH + ((H&4) ? 1 : 0),
+    SIZE = SEQUENCE + ((H&2) ? 4 : 0)
+  };
+};
+
+#define DATP_HFF_LAYOUT(h) \
+  { DatpHffLayoutOf<h>::SIZE, \
+    ((h)&64) ? DatpHffLayoutOf<h>::ORIGIN : DATP_HFF_SINK, \
+    ((h)&32) ? DatpHffLayoutOf<h>::APPLICATION : DATP_HFF_SINK, \
+    ((h)&16) ? DatpHffLayoutOf<h>::PRIORITY : DATP_HFF_SINK, \
+    ((h)&8) ? DatpHffLayoutOf<h>::TIMESTAMP : DATP_HFF_SINK, \
+    ((h)&4) ? DatpHffLayoutOf<h>::DATALENGTH : DATP_HFF_SINK, \
+    ((h)&2) ? DatpHffLayoutOf<h>::SEQUENCE : DATP_HFF_SINK }
+#define DATP_HFF_LAYOUT8(h) \
+  DATP_HFF_LAYOUT (h), DATP_HFF_LAYOUT (h + 1), DATP_HFF_LAYOUT (h + 2), DATP_HFF_LAYOUT (h + 3), \
+  DATP_HFF_LAYOUT (h + 4), DATP_HFF_LAYOUT (h + 5), DATP_HFF_LAYOUT (h + 6), DATP_HFF_LAYOUT (h + 7)
+
+// one entry for each of the 128 combinations of the seven low HFF bits
+static const DatpHffLayout g_datpHffLayout[128] = {
+  DATP_HFF_LAYOUT8 (0), DATP_HFF_LAYOUT8 (8), DATP_HFF_LAYOUT8 (16), DATP_HFF_LAYOUT8 (24),
+  DATP_HFF_LAYOUT8 (32), DATP_HFF_LAYOUT8 (40), DATP_HFF_LAYOUT8 (48), DATP_HFF_LAYOUT8 (56),
+  DATP_HFF_LAYOUT8 (64), DATP_HFF_LAYOUT8 (72), DATP_HFF_LAYOUT8 (80), DATP_HFF_LAYOUT8 (88),
+  DATP_HFF_LAYOUT8 (96), DATP_HFF_LAYOUT8 (104), DATP_HFF_LAYOUT8 (112), DATP_HFF_LAYOUT8 (120)
+};
+
+#undef DATP_HFF_LAYOUT8
+#undef DATP_HFF_LAYOUT
+
+static inline void
+WriteHtonU32 (uint8_t *p, uint32_t value)
+{
+  p[0] = value >> 24;
+  p[1] = value >> 16;
+  p[2] = value >> 8;
+  p[3] = value;
+}
+
+static inline void
+WriteHtonU64 (uint8_t *p, uint64_t value)
+{
+  WriteHtonU32 (p, value >> 32);
+  WriteHtonU32 (p + 4, value);
+}
+
+static inline uint32_t
+ReadNtohU32 (const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline uint64_t
+ReadNtohU64 (const uint8_t *p)
+{
+  return ((uint64_t)ReadNtohU32 (p) << 32) | (uint64_t)ReadNtohU32 (p + 4);
+}
+
 NS_OBJECT_ENSURE_REGISTERED (DatpHeader);
 
 TypeId
@@ -42,16 +114,17 @@ DatpHeader::GetTypeId (void)
 
 DatpHeader::DatpHeader ()
   : m_hff (128),
-    //m_sizeModifier (0),
+    m_sizeModifiers (0),
+    m_sizeModifiersLength (0),
+    m_encodingFlags (0),
+    m_context (0),
     m_origin (0),
     m_application (0),
     m_priority (0),
     m_timestamp (Seconds (0.0).GetNanoSeconds ()),   // or auto set time ---> Simulator::Now ().GetTimeStep ()
     m_dataLength (0),
     m_sequence (0),
-    m_internalHeaderSize (1),
-    m_internalReceiveTime (Seconds (0.0)),
-    m_internalMessageIdentifier (0)
+    m_count (1)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -67,15 +140,17 @@ DatpHeader::GetHeaderFieldFlags (void) const
   return m_hff;
 }
 
+uint8_t 
+DatpHeader::GetSizeModifiers (void) const
+{
+  return m_sizeModifiers & ~DATP_HFF_CHAIN;
+}
+
 void 
 DatpHeader::SetOrigin (uint32_t origin)
 {
   m_origin = origin;
-  if (!(m_hff&64))
-    { 
-      m_hff += 64;
-      m_internalHeaderSize += 4;
-    }
+  m_hff |= 64;
 }
 
 uint32_t 
@@ -88,11 +163,7 @@ void
 DatpHeader::SetApplication (uint8_t application)
 {
   m_application = application;
-  if (!(m_hff&32))
-    { 
-      m_hff += 32;
-      m_internalHeaderSize += 1;
-    }
+  m_hff |= 32;
 }
 
 uint8_t 
@@ -105,11 +176,7 @@ void
 DatpHeader::SetPriority (uint8_t priority)
 {
   m_priority = priority;
-  if (!(m_hff&16))
-    { 
-      m_hff += 16;
-      m_internalHeaderSize += 1;
-    }
+  m_hff |= 16;
 }
 
 uint8_t 
@@ -122,11 +189,8 @@ void
 DatpHeader::SetTimestamp (uint64_t timestamp)
 {
   m_timestamp = timestamp;
-  if (!(m_hff&8))
-    { 
-      m_hff += 8;
-      m_internalHeaderSize += 8;
-    }
+  m_hff |= 8;
+  UpdateSizeModifiers ();
 }
 
 uint64_t 
@@ -136,17 +200,14 @@ DatpHeader::GetTimestamp (void) const
 }
 
 void 
-DatpHeader::SetDataLength (uint8_t dataLength)
+DatpHeader::SetDataLength (uint32_t dataLength)
 {
   m_dataLength = dataLength;
-  if (!(m_hff&4))
-    { 
-      m_hff += 4;
-      m_internalHeaderSize += 1;
-    }
+  m_hff |= 4;
+  UpdateSizeModifiers ();
 }
 
-uint8_t 
+uint32_t 
 DatpHeader::GetDataLength (void) const
 {
   return m_dataLength;
@@ -156,11 +217,8 @@ void
 DatpHeader::SetSequence (uint32_t sequence)
 {
   m_sequence = sequence;
-  if (!(m_hff&2))
-    { 
-      m_hff += 2;
-      m_internalHeaderSize += 4;
-    }
+  m_hff |= 2;
+  UpdateSizeModifiers ();
 }
 
 uint32_t 
@@ -169,40 +227,297 @@ DatpHeader::GetSequence (void) const
   return m_sequence;
 }
 
+void
+DatpHeader::SetCount (uint32_t count)
+{
+  m_count = count;
+  if (count > 1)
+    m_sizeModifiers |= DATP_HFF2_COUNT;
+  else
+    m_sizeModifiers &= ~DATP_HFF2_COUNT;
+  UpdateSizeModifiers ();
+}
+
+uint32_t
+DatpHeader::GetCount (void) const
+{
+  return m_count;
+}
+
+void
+DatpHeader::SetSketch (bool sketch)
+{
+  if (sketch)
+    m_sizeModifiers |= DATP_HFF2_SKETCH;
+  else
+    m_sizeModifiers &= ~DATP_HFF2_SKETCH;
+  UpdateSizeModifiers ();
+}
+
+bool
+DatpHeader::IsSketch (void) const
+{
+  return m_sizeModifiers & DATP_HFF2_SKETCH;
+}
+
+void
+DatpHeader::SetCompressed (bool compressed)
+{
+  if (compressed)
+    m_encodingFlags |= DATP_HFF3_COMPRESSED;
+  else
+    m_encodingFlags &= ~DATP_HFF3_COMPRESSED;
+  UpdateSizeModifiers ();
+}
+
+bool
+DatpHeader::IsCompressed (void) const
+{
+  return m_encodingFlags & DATP_HFF3_COMPRESSED;
+}
+
+void
+DatpHeader::SetQuantized (bool quantized)
+{
+  if (quantized)
+    m_encodingFlags |= DATP_HFF3_QUANTIZED;
+  else
+    m_encodingFlags &= ~DATP_HFF3_QUANTIZED;
+  UpdateSizeModifiers ();
+}
+
+bool
+DatpHeader::IsQuantized (void) const
+{
+  return m_encodingFlags & DATP_HFF3_QUANTIZED;
+}
+
+void
+DatpHeader::SetDelta (bool delta)
+{
+  if (delta)
+    m_encodingFlags |= DATP_HFF3_DELTA;
+  else
+    m_encodingFlags &= ~DATP_HFF3_DELTA;
+  UpdateSizeModifiers ();
+}
+
+bool
+DatpHeader::IsDelta (void) const
+{
+  return m_encodingFlags & DATP_HFF3_DELTA;
+}
+
+void
+DatpHeader::SetFused (bool fused)
+{
+  if (fused)
+    m_encodingFlags |= DATP_HFF3_FUSED;
+  else
+    m_encodingFlags &= ~DATP_HFF3_FUSED;
+  UpdateSizeModifiers ();
+}
+
+bool
+DatpHeader::IsFused (void) const
+{
+  return m_encodingFlags & DATP_HFF3_FUSED;
+}
+
+void
+DatpHeader::SetWindow (bool window)
+{
+  if (window)
+    m_encodingFlags |= DATP_HFF3_WINDOW;
+  else
+    m_encodingFlags &= ~DATP_HFF3_WINDOW;
+  UpdateSizeModifiers ();
+}
+
+bool
+DatpHeader::IsWindow (void) const
+{
+  return m_encodingFlags & DATP_HFF3_WINDOW;
+}
+
+uint8_t
+DatpHeader::GetEncodingFlags (void) const
+{
+  return m_encodingFlags;
+}
+
 uint8_t 
 DatpHeader::GetInternalHeaderSize (void) const
 {
-  return m_internalHeaderSize;
+  return GetLayout (GetFixedFlags (m_hff, m_sizeModifiers)).size + m_sizeModifiersLength;
 }
 
-void 
-DatpHeader::SetInternalReceiveTime (Time receiveTime)
+const DatpHffLayout &
+DatpHeader::GetLayout (uint8_t hff)
 {
-  m_internalReceiveTime = receiveTime;
+  return g_datpHffLayout[hff&127];
 }
 
-Time 
-DatpHeader::GetInternalReceiveTime (void) const
+uint8_t
+DatpHeader::GetFixedFlags (uint8_t hff, uint8_t sizeModifiers)
 {
-  return m_internalReceiveTime;
+  return hff & ~((sizeModifiers & DATP_HFF2_VARINT_MASK) >> 4);
 }
 
-void 
-DatpHeader::SetInternalMessageIdentifier (uint32_t messageIdentifier)
+uint32_t
+DatpHeader::GetVarintSize (uint64_t value)
 {
-  m_internalMessageIdentifier = messageIdentifier;
+  uint32_t size = 1;
+  while (value >= 128)
+    {
+      value >>= 7;
+      ++size;
+    }
+  return size;
 }
 
-uint32_t 
-DatpHeader::GetInternalMessageIdentifier (void) const
+uint32_t
+DatpHeader::WriteVarint (uint8_t *buffer, uint64_t value)
 {
-  return m_internalMessageIdentifier;
+  uint32_t size = 0;
+  while (value >= 128)
+    {
+      buffer[size++] = (value & 127) | 128;
+      value >>= 7;
+    }
+  buffer[size++] = value;
+  return size;
+}
+
+uint32_t
+DatpHeader::ReadVarint (const uint8_t *buffer, uint32_t size, uint64_t &value)
+{
+  value = 0;
+  for (uint32_t i = 0; i < size && i < 10; ++i)
+    {
+      value |= (uint64_t)(buffer[i] & 127) << (7 * i);
+      if (!(buffer[i] & 128))
+        return i + 1;
+    }
+  return 0;
+}
+
+uint64_t
+DatpHeader::ReadVarint (Buffer::Iterator &i)
+{
+  uint64_t value = 0;
+  for (uint32_t n = 0; n < 10; ++n)
+    {
+      uint8_t byte = i.ReadU8 ();
+      value |= (uint64_t)(byte & 127) << (7 * n);
+      if (!(byte & 128))
+        break;
+    }
+  return value;
+}
+
+uint64_t
+DatpHeader::EncodeZigZag (int64_t value)
+{
+  return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+int64_t
+DatpHeader::DecodeZigZag (uint64_t value)
+{
+  return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
 }
 
 bool
-DatpHeader::operator< (DatpHeader const & datpHeader) const
+DatpHeader::MakeBundleMember (DatpHeader const &first, DatpHeader const &previous)
 {
-  return (GetInternalMessageIdentifier () < datpHeader.GetInternalMessageIdentifier ());
+  NS_LOG_FUNCTION (this);
+  //a left out field is taken from previous, so previous fields must all be here
+  if ((previous.m_hff & 112 & ~m_hff) || (m_hff&8) != (first.m_hff&8))
+    return false;
+
+  uint8_t hff = m_hff & ~(64|32|16|8);
+  if ((m_hff&64) && (!(previous.m_hff&64) || m_origin != previous.m_origin))
+    hff |= 64;
+  if ((m_hff&32) && (!(previous.m_hff&32) || m_application != previous.m_application))
+    hff |= 32;
+  if ((m_hff&16) && (!(previous.m_hff&16) || m_priority != previous.m_priority))
+    hff |= 16;
+  if ((m_hff&8) && m_timestamp != first.m_timestamp)
+    {
+      hff |= 8;
+      m_timestamp = EncodeZigZag ((int64_t)(m_timestamp - first.m_timestamp));
+    }
+  m_hff = hff;
+  m_sizeModifiers = DATP_HFF2_BUNDLE | (m_sizeModifiers & (DATP_HFF2_COUNT | DATP_HFF2_SKETCH));
+  UpdateSizeModifiers ();
+  return true;
+}
+
+void
+DatpHeader::SetContext (uint8_t context)
+{
+  NS_LOG_FUNCTION (this << (uint32_t) context);
+  m_context = context;
+  if (!(context & DATP_CONTEXT_ESTABLISH))
+    m_hff &= ~(64|32|16);
+  m_sizeModifiers |= DATP_HFF2_CONTEXT;
+  UpdateSizeModifiers ();
+}
+
+uint8_t
+DatpHeader::GetContext (void) const
+{
+  return m_context;
+}
+
+void
+DatpHeader::UpdateSizeModifiers (void)
+{
+  //varints only pay off when they save more than the HFF2 byte they need,
+  //unless the length does not fit its one byte slot at all,
+  //a bundle member always has HFF2 and its timestamp delta is always a varint,
+  //a context member, a message with a count or a sketch always has HFF2,
+  //so does a message with HFF3, chained from it
+  uint8_t sizeModifiers = m_sizeModifiers & (DATP_HFF2_BUNDLE | DATP_HFF2_CONTEXT | DATP_HFF2_COUNT | DATP_HFF2_SKETCH);
+  if (m_encodingFlags)
+    sizeModifiers |= DATP_HFF_CHAIN;
+  uint32_t fixedSize = 0;
+  uint32_t varintSize = ((sizeModifiers & DATP_HFF2_CONTEXT) ? 1 : 0) + (sizeModifiers & DATP_HFF_CHAIN);
+  if (sizeModifiers & DATP_HFF2_COUNT)
+    varintSize += GetVarintSize (m_count);
+  if ((m_hff&8) && ((sizeModifiers & DATP_HFF2_BUNDLE) || GetVarintSize (m_timestamp) < 8))
+    {
+      sizeModifiers |= DATP_HFF2_VARINT_TIMESTAMP;
+      fixedSize += 8;
+      varintSize += GetVarintSize (m_timestamp);
+    }
+  if ((m_hff&4) && m_dataLength > 255)
+    {
+      sizeModifiers |= DATP_HFF2_VARINT_LENGTH;
+      fixedSize += 1;
+      varintSize += GetVarintSize (m_dataLength);
+    }
+  if ((m_hff&2) && GetVarintSize (m_sequence) < 4)
+    {
+      sizeModifiers |= DATP_HFF2_VARINT_SEQUENCE;
+      fixedSize += 4;
+      varintSize += GetVarintSize (m_sequence);
+    }
+  if (!(sizeModifiers & (DATP_HFF2_VARINT_LENGTH | DATP_HFF2_BUNDLE | DATP_HFF2_CONTEXT | DATP_HFF2_COUNT | DATP_HFF2_SKETCH | DATP_HFF_CHAIN)) && fixedSize <= varintSize + 1)
+    sizeModifiers = 0;
+
+  m_sizeModifiers = sizeModifiers;
+  if (sizeModifiers)
+    {
+      m_hff |= DATP_HFF_CHAIN;
+      m_sizeModifiersLength = 1 + varintSize;
+    }
+  else
+    {
+      m_hff &= ~DATP_HFF_CHAIN;
+      m_sizeModifiersLength = 0;
+    }
 }
 
 TypeId
@@ -215,34 +530,66 @@ void
 DatpHeader::Print (std::ostream &os) const
 {
   NS_LOG_FUNCTION (this << &os);
-  os << "Datp Header: " << m_origin << m_application << m_priority << m_timestamp << m_dataLength << m_sequence;
+  os << "Datp Header: " << (uint32_t) m_sizeModifiers << m_origin << m_application << m_priority << m_timestamp << m_dataLength << m_sequence;
 }
 
 uint32_t
 DatpHeader::GetSerializedSize (void) const
 {
   NS_LOG_FUNCTION (this);
-  return m_internalHeaderSize;  //max size 20, min 1
+  return GetInternalHeaderSize ();
 }
 
 void
 DatpHeader::Serialize (Buffer::Iterator start) const
 {
   NS_LOG_FUNCTION (this << &start);
-  Buffer::Iterator i = start;
-  i.WriteU8 (m_hff);
-  if (m_hff&64)
-     i.WriteHtonU32 (m_origin);
-  if (m_hff&32)
-    i.WriteU8 (m_application);
-  if (m_hff&16)
-    i.WriteU8 (m_priority);
-  if (m_hff&8)
-    i.WriteHtonU64 (m_timestamp);
-  if (m_hff&4)
-    i.WriteU8 (m_dataLength);
-  if (m_hff&2)
-    i.WriteHtonU32 (m_sequence);
+  uint8_t buffer[DATP_HFF_SCRATCH];
+  start.Write (buffer, Encode (buffer));
+}
+
+uint32_t
+DatpHeader::Write (uint8_t *buffer) const
+{
+  NS_LOG_FUNCTION (this);
+  uint8_t scratch[DATP_HFF_SCRATCH];
+  uint32_t size = Encode (scratch);
+  memcpy (buffer, scratch, size);
+  return size;
+}
+
+uint32_t
+DatpHeader::Encode (uint8_t *buffer) const
+{
+  const DatpHffLayout &layout = GetLayout (GetFixedFlags (m_hff, m_sizeModifiers));
+  //with HFF2, HFF3 and the context ID present the fixed width fields move further
+  uint8_t *context = buffer + 1 + (m_hff & DATP_HFF_CHAIN) + (m_sizeModifiers & DATP_HFF_CHAIN);
+  uint8_t *fixed = context - 1 + ((m_sizeModifiers & DATP_HFF2_CONTEXT) ? 1 : 0);
+  buffer[0] = m_hff;
+  WriteHtonU32 (fixed + layout.origin, m_origin);
+  fixed[layout.application] = m_application;
+  fixed[layout.priority] = m_priority;
+  WriteHtonU64 (fixed + layout.timestamp, m_timestamp);
+  fixed[layout.dataLength] = m_dataLength;
+  WriteHtonU32 (fixed + layout.sequence, m_sequence);
+  uint32_t size = (fixed - buffer) + layout.size;
+  if (m_hff & DATP_HFF_CHAIN)
+    {
+      buffer[1] = m_sizeModifiers;
+      if (m_sizeModifiers & DATP_HFF_CHAIN)
+        buffer[2] = m_encodingFlags;
+      if (m_sizeModifiers & DATP_HFF2_CONTEXT)
+        *context = m_context;
+      if (m_sizeModifiers & DATP_HFF2_VARINT_TIMESTAMP)
+        size += WriteVarint (buffer + size, m_timestamp);
+      if (m_sizeModifiers & DATP_HFF2_VARINT_LENGTH)
+        size += WriteVarint (buffer + size, m_dataLength);
+      if (m_sizeModifiers & DATP_HFF2_VARINT_SEQUENCE)
+        size += WriteVarint (buffer + size, m_sequence);
+      if (m_sizeModifiers & DATP_HFF2_COUNT)
+        size += WriteVarint (buffer + size, m_count);
+    }
+  return size;
 }
 
 uint32_t
@@ -250,48 +597,233 @@ DatpHeader::Deserialize (Buffer::Iterator start)
 {
   NS_LOG_FUNCTION (this << &start);
   Buffer::Iterator i = start;
-  m_hff = i.ReadU8 ();  //might need error checking to ensure we get every piece
-  NS_LOG_INFO ("Deserialized HFF = "<<(bool)(m_hff&128)<<(bool)(m_hff&64)
-                                    <<(bool)(m_hff&32)<<(bool)(m_hff&16)<<(bool)(m_hff&8)
-                                    <<(bool)(m_hff&4)<<(bool)(m_hff&2)<<(bool)(m_hff&1));
-  m_internalHeaderSize = 1;
-  if (m_hff&64)
-    {
-      m_origin = i.ReadNtohU32 ();
-      m_internalHeaderSize += 4;
-    }
-  if (m_hff&32)
-    {
-      m_application = i.ReadU8 ();
-      m_internalHeaderSize += 1;
-    }
-  if (m_hff&16)
-    {
-      m_priority = i.ReadU8 ();
-      m_internalHeaderSize += 1;
-    }
-  if (m_hff&8)
+  uint8_t buffer[DATP_HFF_SCRATCH];
+  m_hff = i.ReadU8 ();
+  m_sizeModifiers = 0;
+  m_encodingFlags = 0;
+  m_context = 0;
+  if (m_hff & DATP_HFF_CHAIN)
     {
-      m_timestamp = i.ReadNtohU64 ();
-      m_internalHeaderSize += 8;
+      m_sizeModifiers = i.ReadU8 ();
+      uint8_t hff = m_sizeModifiers;
+      uint32_t chainSize = 2;
+      if (hff & DATP_HFF_CHAIN)
+        {
+          m_encodingFlags = hff = i.ReadU8 ();
+          ++chainSize;
+        }
+      while (hff & DATP_HFF_CHAIN)
+        {
+          if (chainSize++ >= DATP_HFF_CHAIN_MAX)
+            {
+              NS_LOG_WARN ("Datp header chains more than " << DATP_HFF_CHAIN_MAX << " HFFs");
+              return 0;
+            }
+          hff = i.ReadU8 ();  //no fields defined past HFF3
+        }
+      if (m_sizeModifiers & DATP_HFF2_CONTEXT)
+        m_context = i.ReadU8 ();
     }
-  if (m_hff&4)
+  const DatpHffLayout &layout = GetLayout (GetFixedFlags (m_hff, m_sizeModifiers));
+  i.Read (buffer + 1, layout.size - 1);
+  //absent fields are read back from the zeroed sink, i.e. their defaults
+  memset (buffer + DATP_HFF_SINK, 0, DATP_HFF_SCRATCH - DATP_HFF_SINK);
+  m_origin = ReadNtohU32 (buffer + layout.origin);
+  m_application = buffer[layout.application];
+  m_priority = buffer[layout.priority];
+  m_timestamp = ReadNtohU64 (buffer + layout.timestamp);
+  m_dataLength = buffer[layout.dataLength];
+  m_sequence = ReadNtohU32 (buffer + layout.sequence);
+  uint64_t dataLength = m_dataLength;
+  uint64_t sequence = m_sequence;
+  uint64_t count = 1;
+  if (m_sizeModifiers & DATP_HFF2_VARINT_TIMESTAMP)
+    m_timestamp = ReadVarint (i);
+  if (m_sizeModifiers & DATP_HFF2_VARINT_LENGTH)
+    dataLength = ReadVarint (i);
+  if (m_sizeModifiers & DATP_HFF2_VARINT_SEQUENCE)
+    sequence = ReadVarint (i);
+  if (m_sizeModifiers & DATP_HFF2_COUNT)
+    count = ReadVarint (i);
+  if (dataLength > 0xffffffff || sequence > 0xffffffff || count == 0 || count > 0xffffffff)
     {
-      m_dataLength = i.ReadU8 ();
-      m_internalHeaderSize += 1;
+      NS_LOG_WARN ("Datp header length " << dataLength << ", sequence " << sequence << " or count " << count << " out of range");
+      return 0;
     }
-  if (m_hff&2)
+  m_dataLength = dataLength;
+  m_sequence = sequence;
+  m_count = count;
+  //HFFs past HFF3 are dropped, a forwarded header is rewritten without them
+  m_encodingFlags &= ~DATP_HFF_CHAIN;
+  m_sizeModifiers &= ~DATP_HFF_CHAIN;
+  if (m_encodingFlags)
+    m_sizeModifiers |= DATP_HFF_CHAIN;
+  m_sizeModifiersLength = 0;
+  if (m_hff & DATP_HFF_CHAIN)
     {
-      m_sequence = i.ReadNtohU32 ();
-      m_internalHeaderSize += 4;
+      m_sizeModifiersLength = ((m_sizeModifiers & DATP_HFF2_CONTEXT) ? 2 : 1) + (m_sizeModifiers & DATP_HFF_CHAIN);
+      if (m_sizeModifiers & DATP_HFF2_VARINT_TIMESTAMP)
+        m_sizeModifiersLength += GetVarintSize (m_timestamp);
+      if (m_sizeModifiers & DATP_HFF2_VARINT_LENGTH)
+        m_sizeModifiersLength += GetVarintSize (m_dataLength);
+      if (m_sizeModifiers & DATP_HFF2_VARINT_SEQUENCE)
+        m_sizeModifiersLength += GetVarintSize (m_sequence);
+      if (m_sizeModifiers & DATP_HFF2_COUNT)
+        m_sizeModifiersLength += GetVarintSize (m_count);
     }
-  NS_LOG_INFO ("Deserialized Datp Header: " << (uint32_t) m_application 
+  NS_LOG_INFO ("Deserialized Datp Header: " << (uint32_t) m_hff
+                                            << " " << (uint32_t) m_sizeModifiers
+                                            << " " << (uint32_t) m_application 
                                             << " " << (uint32_t) m_priority 
                                             << " " << m_timestamp 
-                                            << " " << (uint32_t) m_dataLength 
+                                            << " " << m_dataLength 
                                             << " " << m_sequence);
   
-  return GetSerializedSize ();
+  return i.GetDistanceFrom (start);
+}
+
+
+
+
+NS_OBJECT_ENSURE_REGISTERED (DatpFrameHeader);
+
+TypeId
+DatpFrameHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpFrameHeader")
+    .SetParent<Header> ()
+    .AddConstructor<DatpFrameHeader> ()
+  ;
+  return tid;
+}
+
+DatpFrameHeader::DatpFrameHeader ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+DatpFrameHeader::~DatpFrameHeader ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+DatpFrameHeader::AddMessage (uint32_t messageSize)
+{
+  m_messageSizes.push_back (messageSize);
+}
+
+uint32_t
+DatpFrameHeader::GetNMessages (void) const
+{
+  return m_messageSizes.size ();
+}
+
+uint32_t
+DatpFrameHeader::GetMessageSize (uint32_t index) const
+{
+  NS_ASSERT (index < m_messageSizes.size ());
+  return m_messageSizes[index];
+}
+
+uint32_t
+DatpFrameHeader::GetMessagesSize (void) const
+{
+  uint32_t size = 0;
+  for (uint32_t i = 0; i < m_messageSizes.size (); ++i)
+    size += m_messageSizes[i];
+  return size;
+}
+
+bool
+DatpFrameHeader::IsFrame (uint8_t firstByte)
+{
+  return !(firstByte & 128);
+}
+
+uint32_t
+DatpFrameHeader::Read (const uint8_t *buffer, uint32_t size, std::vector<uint32_t> &messageSizes)
+{
+  messageSizes.clear ();
+  if (size < 1 || !IsFrame (buffer[0]))
+    return 0;
+  uint64_t count;
+  uint32_t read;
+  uint32_t offset = 1;
+  if (!(read = DatpHeader::ReadVarint (buffer + offset, size - offset, count)))
+    return 0;
+  offset += read;
+  //each size takes at least one byte, a bogus count cannot run away
+  if (count > size - offset)
+    return 0;
+  messageSizes.reserve (count);
+  for (uint64_t m = 0; m < count; ++m)
+    {
+      uint64_t messageSize;
+      if (!(read = DatpHeader::ReadVarint (buffer + offset, size - offset, messageSize)))
+        return 0;
+      offset += read;
+      messageSizes.push_back (messageSize);
+    }
+  return offset;
+}
+
+TypeId
+DatpFrameHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void
+DatpFrameHeader::Print (std::ostream &os) const
+{
+  NS_LOG_FUNCTION (this << &os);
+  os << "Datp Frame Header: " << m_messageSizes.size ();
+}
+
+uint32_t
+DatpFrameHeader::GetSerializedSize (void) const
+{
+  NS_LOG_FUNCTION (this);
+  uint32_t size = 1 + DatpHeader::GetVarintSize (m_messageSizes.size ());
+  for (uint32_t m = 0; m < m_messageSizes.size (); ++m)
+    size += DatpHeader::GetVarintSize (m_messageSizes[m]);
+  return size;
+}
+
+uint32_t
+DatpFrameHeader::Write (uint8_t *buffer) const
+{
+  NS_LOG_FUNCTION (this);
+  uint32_t size = 1;
+  buffer[0] = DATP_FRAME;
+  size += DatpHeader::WriteVarint (buffer + size, m_messageSizes.size ());
+  for (uint32_t m = 0; m < m_messageSizes.size (); ++m)
+    size += DatpHeader::WriteVarint (buffer + size, m_messageSizes[m]);
+  return size;
+}
+
+void
+DatpFrameHeader::Serialize (Buffer::Iterator start) const
+{
+  NS_LOG_FUNCTION (this << &start);
+  std::vector<uint8_t> buffer (GetSerializedSize ());
+  start.Write (&buffer[0], Write (&buffer[0]));
+}
+
+uint32_t
+DatpFrameHeader::Deserialize (Buffer::Iterator start)
+{
+  NS_LOG_FUNCTION (this << &start);
+  Buffer::Iterator i = start;
+  
+  i.ReadU8 ();
+  uint64_t count = DatpHeader::ReadVarint (i);
+  m_messageSizes.clear ();
+  for (uint64_t m = 0; m < count; ++m)
+    m_messageSizes.push_back (DatpHeader::ReadVarint (i));
+  
+  return i.GetDistanceFrom (start);
 }
 
 
@@ -23,24 +23,87 @@
 
 #include "ns3/header.h"
 #include "ns3/nstime.h"
+#include <vector>
 
 namespace ns3 { 
 
+/**
+ * \ingroup datp header
+ * \brief Byte layout of a DatpHeader for one HFF value
+ *
+ * Offsets are counted from the HFF byte.  A field that is not flagged points
+ * at the scratch area past the largest header (DATP_HFF_SINK), so encode and
+ * decode can copy every field without testing the flags.
+ */
+struct DatpHffLayout
+{
+  uint8_t size;           //!< serialized size including the HFF byte
+  uint8_t origin;
+  uint8_t application;
+  uint8_t priority;
+  uint8_t timestamp;
+  uint8_t dataLength;
+  uint8_t sequence;
+};
+
+#define DATP_HFF_SINK 20      //!< largest fixed width header, absent fields are copied here
+#define DATP_HFF_SCRATCH 40   //!< room for the widest header, or the sink and the widest field
+
+#define DATP_HFF_CHAIN 1                   //!< final flag of any HFF, another HFF follows
+#define DATP_HFF_CHAIN_MAX 4               //!< HFF bytes a header may chain, keeps its size within a byte
+#define DATP_HFF2_VARINT_TIMESTAMP 128     //!< timestamp is a varint after the fixed fields
+#define DATP_HFF2_VARINT_LENGTH 64         //!< message length is a varint after the fixed fields
+#define DATP_HFF2_VARINT_SEQUENCE 32       //!< sequence is a varint after the fixed fields
+#define DATP_HFF2_VARINT_MASK 224          //!< shifted right by 4 these are the HFF flags they modify
+#define DATP_HFF2_BUNDLE 16                //!< bundle member, see DatpHeader::MakeBundleMember
+#define DATP_HFF2_CONTEXT 8                //!< a context ID byte follows the HFFs, see DatpHeaderContext
+#define DATP_HFF2_COUNT 4                  //!< readings reduced into the message, a varint after the others
+#define DATP_HFF2_SKETCH 2                 //!< the payload is a mergeable sketch, see DatpFunctionSketch
+#define DATP_HFF3_COMPRESSED 128           //!< the payload is a compressed run of messages, see DatpFunctionCompress
+#define DATP_HFF3_QUANTIZED 64             //!< the payload is quantized readings, see DatpQuantizer
+#define DATP_HFF3_DELTA 32                 //!< the payload is the change of a running aggregate, see DatpFunctionIncremental
+#define DATP_HFF3_FUSED 16                 //!< the payload fuses records of several applications, see DatpFunctionFusion
+#define DATP_HFF3_WINDOW 8                 //!< the timestamp is the start of the window the message aggregates, see DatpFunctionWindow
+#define DATP_CONTEXT_ESTABLISH 128         //!< context ID flag, the message (re)defines the context
+
 /**
 * \ingroup datp header
 * \brief   Datp flexible application header (* marks optional field)
-      The size modifier field is not implemented
-      Nor are the system specific fields implemented
+      The system specific fields are not implemented
       Note that as per DATP, all fields except HFF are optional
       Note that all field defaults are the same except the HFF and timestamp
-      The HFF is implemented in the one byte form
       The timestamp is implemented with the same class used in ns-3
       The HFF can indicate the presence of another HFF with its final flag value
+      The second HFF (HFF2) holds the size modifiers: each one moves the
+      timestamp, message length or sequence out of its fixed width slot
+      into an unsigned LEB128 varint written after the fixed width fields,
+      in that order.  The size modifiers are chosen by the header itself,
+      only when they save bytes or when the length does not fit one byte.
+      HFF2 also marks bundle members: inside one packet a message may leave
+      out the origin, application and priority of the message before it,
+      and carries its timestamp as a zigzag varint delta from the first
+      message of the bundle (left out when the delta is zero).
+      HFF2 may add a context ID byte right after the HFFs: the origin,
+      application and priority a message leaves out come from the context
+      its sender established on the link (see DatpHeaderContext).
+      HFF2 may also carry the count of readings a function reduced into the
+      message, as the last varint; without it the message holds one reading.
+      A sketch flag in HFF2 tells the payload is a sketch summarising the
+      readings rather than the readings themselves.
+      A third HFF (HFF3), chained from HFF2, holds payload encoding flags:
+      a compressed flag tells the payload packs whole messages compressed
+      together, a quantized flag that it holds readings rounded within the
+      error budget of their application, a delta flag that it holds the
+      change of a running aggregate since its sender last reported it, a
+      fused flag that it holds the records of several applications of the
+      same origin.  Any HFF after HFF3 is skipped, no fields are defined for it yet.
   \verbatim
    0                   1                   2                   3
    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-  |       HFF     |          Size Modifiers (not included)        |
+  |       HFF     |     HFF2*     |     HFF3*     |  Context ID*  |
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+                                (fields shift left if these are absent)
   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
   |                            Origin*                            |
   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
@@ -52,6 +115,8 @@ namespace ns3 {
   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
   |                            Sequence*                          |
   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  | Varint Timestamp*, Length*, Sequence*, Count*                 |
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
   |           System Specific Fields (not implemented)            |
   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
   \endverbatim
@@ -66,8 +131,7 @@ public:
   virtual ~DatpHeader ();
   
   uint8_t GetHeaderFieldFlags (void) const;
-  
-  //Size Modifier is left out... Consider replacing it with Another HFF field
+  uint8_t GetSizeModifiers (void) const;
   
   void SetOrigin (uint32_t origin);
   uint32_t GetOrigin (void) const;
@@ -81,42 +145,151 @@ public:
   void SetTimestamp (uint64_t timestamp);
   uint64_t GetTimestamp (void) const;
   
-  void SetDataLength (uint8_t dataLength);
-  uint8_t GetDataLength (void) const;
+  void SetDataLength (uint32_t dataLength);
+  uint32_t GetDataLength (void) const;
   
   void SetSequence (uint32_t sequence);
   uint32_t GetSequence (void) const;
   
+  /// Readings reduced into the message, only sent (DATP_HFF2_COUNT) when more than one
+  void SetCount (uint32_t count);
+  uint32_t GetCount (void) const;
+  
+  /// Mark the payload as a sketch (DATP_HFF2_SKETCH)
+  void SetSketch (bool sketch);
+  bool IsSketch (void) const;
+  
+  /// Mark the payload as compressed messages (DATP_HFF3_COMPRESSED)
+  void SetCompressed (bool compressed);
+  bool IsCompressed (void) const;
+  /// Mark the payload as quantized readings (DATP_HFF3_QUANTIZED)
+  void SetQuantized (bool quantized);
+  bool IsQuantized (void) const;
+  /// Mark the payload as the change of a running aggregate (DATP_HFF3_DELTA)
+  void SetDelta (bool delta);
+  bool IsDelta (void) const;
+  /// Mark the payload as fused records of several applications (DATP_HFF3_FUSED)
+  void SetFused (bool fused);
+  bool IsFused (void) const;
+  /// Mark the timestamp as the start of an aggregated window (DATP_HFF3_WINDOW)
+  void SetWindow (bool window);
+  bool IsWindow (void) const;
+  /// HFF3, zero when HFF2 is not chained
+  uint8_t GetEncodingFlags (void) const;
+  
   uint8_t GetInternalHeaderSize (void) const;
+  /// Serialize into buffer, which needs GetInternalHeaderSize bytes, \returns bytes written
+  uint32_t Write (uint8_t *buffer) const;
   
-  void SetInternalReceiveTime (Time receiveTime);
-  Time GetInternalReceiveTime (void) const;
+  /// Layout of the header fields for the given HFF (table lookup)
+  static const DatpHffLayout & GetLayout (uint8_t hff);
+  /// HFF flags of the fields kept in their fixed width slots
+  static uint8_t GetFixedFlags (uint8_t hff, uint8_t sizeModifiers);
   
-  void SetInternalMessageIdentifier (uint32_t messageIdentifier);
-  uint32_t GetInternalMessageIdentifier (void) const;
+  static uint32_t GetVarintSize (uint64_t value);
+  static uint32_t WriteVarint (uint8_t *buffer, uint64_t value);
+  /// \returns bytes consumed, 0 if the varint runs past size
+  static uint32_t ReadVarint (const uint8_t *buffer, uint32_t size, uint64_t &value);
+  static uint64_t ReadVarint (Buffer::Iterator &i);
+  static uint64_t EncodeZigZag (int64_t value);
+  static int64_t DecodeZigZag (uint64_t value);
   
-  virtual bool operator< (DatpHeader const & datpHeader) const;
+  /**
+   * \brief Re-encode as a bundle member following previous in the same packet
+   * \param first the first, fully encoded, message of the bundle
+   * \param previous the message just before this one, as it was before encoding
+   * \returns false, leaving the header untouched, if a field present in
+   *          previous or the timestamp of first could not be carried over
+   *
+   * A bundle member only keeps the origin, application and priority that
+   * differ from previous; its timestamp becomes the delta from first.
+   */
+  bool MakeBundleMember (DatpHeader const &first, DatpHeader const &previous);
+  
+  /**
+   * \brief Refer to a link context, see DATP_HFF2_CONTEXT
+   * Unless context has DATP_CONTEXT_ESTABLISH set, the origin, application
+   * and priority are left out and taken from the context by the receiver.
+   */
+  void SetContext (uint8_t context);
+  uint8_t GetContext (void) const;
   
 private:
   virtual TypeId GetInstanceTypeId (void) const;
   virtual void Print (std::ostream &os) const;
   virtual uint32_t GetSerializedSize (void) const;
   virtual void Serialize (Buffer::Iterator start) const;
+  /// \returns 0, nothing read, if the header is malformed
   virtual uint32_t Deserialize (Buffer::Iterator start);
+  
+  void UpdateSizeModifiers (void);
+  uint32_t Encode (uint8_t *scratch) const;
 
   uint8_t m_hff;
-  // uint8_t m_sizeModifier;
+  uint8_t m_sizeModifiers;
+  uint8_t m_sizeModifiersLength;   //bytes taken by HFF2, HFF3, the context ID and the varints
+  uint8_t m_encodingFlags;
+  uint8_t m_context;
   uint32_t m_origin;
   uint8_t m_application;
   uint8_t m_priority;
   uint64_t m_timestamp;
-  uint8_t m_dataLength;
+  uint32_t m_dataLength;
   uint32_t m_sequence;
-  
-  uint8_t m_internalHeaderSize;
-  Time m_internalReceiveTime;
-  uint32_t m_internalMessageIdentifier;
+  uint32_t m_count;
+
+};
+
+
+#define DATP_FRAME 0     //!< first byte of a frame header, the HFF default flag is never clear
+
+/**
+* \ingroup datp header
+* \brief   Optional index in front of the messages of a Datp packet
+      Written by the scheduler when the packet is ejected.  It holds the
+      message count and the size (header and payload) of every message as
+      varints, so a receiver can check the packet adds up and find message
+      N without decoding the messages before it.  A packet starting with a
+      byte whose HFF default flag is clear has a frame header.
+  \verbatim
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  |   DATP_FRAME  | Varint Count  | Varint Message Size (Count)...|
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  \endverbatim
+*/
 
+class DatpFrameHeader : public Header
+{
+public:
+  static TypeId GetTypeId (void);
+  
+  DatpFrameHeader ();
+  virtual ~DatpFrameHeader ();
+  
+  void AddMessage (uint32_t messageSize);
+  uint32_t GetNMessages (void) const;
+  uint32_t GetMessageSize (uint32_t index) const;
+  /// Sum of the message sizes, the packet size past the frame header
+  uint32_t GetMessagesSize (void) const;
+  
+  /// Serialize into buffer, which needs GetSerializedSize bytes, \returns bytes written
+  uint32_t Write (uint8_t *buffer) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  
+  static bool IsFrame (uint8_t firstByte);
+  /**
+   * \brief Read a frame header from raw packet bytes
+   * \returns bytes of the frame header, 0 if it runs past size
+   */
+  static uint32_t Read (const uint8_t *buffer, uint32_t size, std::vector<uint32_t> &messageSizes);
+  
+private:
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual void Print (std::ostream &os) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+  
+  std::vector<uint32_t> m_messageSizes;
 };
 
 
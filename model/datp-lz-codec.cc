@@ -0,0 +1,212 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "datp-lz-codec.h"
+#include "ns3/simulator.h"
+#include <cstring>
+#include <map>
+
+namespace ns3 {
+
+#define DATP_LZ_HASH_BITS 12
+#define DATP_LZ_MIN_MATCH 4
+#define DATP_LZ_MAX_OFFSET 65535
+
+static std::map<uint8_t,std::string> &
+GetDictionaries (void)
+{
+  static std::map<uint8_t,std::string> dictionaries;
+  return dictionaries;
+}
+
+//whether Simulator::Destroy is due to clear the dictionaries
+static bool g_clearScheduled = false;
+
+/// Extra length bytes after a nibble of 15, \returns false if they run past size
+static bool
+ReadLength (const uint8_t *block, uint32_t size, uint32_t &pos, uint32_t &length)
+{
+  uint8_t byte;
+  do
+    {
+      if (pos >= size)
+        return false;
+      byte = block[pos++];
+      length += byte;
+    }
+  while (byte == 255);
+  return true;
+}
+
+DatpLzCodec::DatpLzCodec ()
+{
+}
+
+uint32_t
+DatpLzCodec::Hash (const uint8_t *p)
+{
+  uint32_t word = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+  return (word * 2654435761U) >> (32 - DATP_LZ_HASH_BITS);
+}
+
+void
+DatpLzCodec::WriteLength (std::vector<uint8_t> &block, uint32_t length)
+{
+  for (; length >= 255; length -= 255)
+    block.push_back (255);
+  block.push_back (length);
+}
+
+void
+DatpLzCodec::WriteSequence (std::vector<uint8_t> &block, const uint8_t *literals, uint32_t nLiterals,
+                            uint32_t offset, uint32_t matchLength)
+{
+  uint32_t extra = matchLength ? matchLength - DATP_LZ_MIN_MATCH : 0;
+  block.push_back (((nLiterals < 15 ? nLiterals : 15) << 4) | (extra < 15 ? extra : 15));
+  if (nLiterals >= 15)
+    WriteLength (block, nLiterals - 15);
+  block.insert (block.end (), literals, literals + nLiterals);
+  if (matchLength)
+    {
+      block.push_back (offset);
+      block.push_back (offset >> 8);
+      if (extra >= 15)
+        WriteLength (block, extra - 15);
+    }
+}
+
+uint32_t
+DatpLzCodec::Compress (const uint8_t *data, uint32_t size, std::string const &dictionary, std::vector<uint8_t> &block)
+{
+  //the dictionary is matched against as if it came right before the data
+  m_window.assign (dictionary.begin (), dictionary.end ());
+  m_window.insert (m_window.end (), data, data + size);
+  m_table.assign (1 << DATP_LZ_HASH_BITS, 0);   //positions plus one, zero is empty
+  uint32_t blockStart = block.size ();
+  uint32_t start = dictionary.size ();
+  uint32_t end = m_window.size ();
+  if (size == 0)
+    {
+      WriteSequence (block, 0, 0, 0, 0);
+      return block.size () - blockStart;
+    }
+  const uint8_t *w = &m_window[0];
+  for (uint32_t i = 0; i + DATP_LZ_MIN_MATCH <= start; ++i)
+    m_table[Hash (w + i)] = i + 1;
+
+  uint32_t anchor = start;
+  uint32_t i = start;
+  while (i + DATP_LZ_MIN_MATCH <= end)
+    {
+      uint32_t h = Hash (w + i);
+      uint32_t candidate = m_table[h];
+      m_table[h] = i + 1;
+      if (candidate == 0 || i - (candidate - 1) > DATP_LZ_MAX_OFFSET
+          || memcmp (w + candidate - 1, w + i, DATP_LZ_MIN_MATCH) != 0)
+        {
+          ++i;
+          continue;
+        }
+      uint32_t match = candidate - 1;
+      uint32_t length = DATP_LZ_MIN_MATCH;
+      while (i + length < end && w[match + length] == w[i + length])
+        ++length;
+      WriteSequence (block, w + anchor, i - anchor, i - match, length);
+      i += length;
+      anchor = i;
+    }
+  WriteSequence (block, w + anchor, end - anchor, 0, 0);
+  return block.size () - blockStart;
+}
+
+bool
+DatpLzCodec::Decompress (const uint8_t *block, uint32_t size, std::string const &dictionary, uint32_t rawSize, std::vector<uint8_t> &data)
+{
+  uint32_t start = dictionary.size ();
+  uint32_t end = start + rawSize;
+  data.assign (dictionary.begin (), dictionary.end ());
+  data.reserve (end);
+  uint32_t pos = 0;
+  while (pos < size)
+    {
+      uint8_t token = block[pos++];
+      uint32_t nLiterals = token >> 4;
+      if (nLiterals == 15 && !ReadLength (block, size, pos, nLiterals))
+        return false;
+      if (size - pos < nLiterals || end - data.size () < nLiterals)
+        return false;
+      data.insert (data.end (), block + pos, block + pos + nLiterals);
+      pos += nLiterals;
+      if (pos == size)
+        break;   //the last sequence has no match
+
+      if (size - pos < 2)
+        return false;
+      uint32_t offset = block[pos] | ((uint32_t) block[pos + 1] << 8);
+      pos += 2;
+      uint32_t length = (token & 15) + DATP_LZ_MIN_MATCH;
+      if ((token & 15) == 15 && !ReadLength (block, size, pos, length))
+        return false;
+      if (offset == 0 || offset > data.size () || end - data.size () < length)
+        return false;
+      //byte by byte, a match may overlap the bytes it produces
+      uint32_t from = data.size () - offset;
+      for (uint32_t l = 0; l < length; ++l)
+        data.push_back (data[from + l]);
+    }
+  if (data.size () != end)
+    return false;
+  data.erase (data.begin (), data.begin () + start);
+  return true;
+}
+
+void
+DatpLzCodec::SetDictionary (uint8_t application, std::string const &dictionary)
+{
+  if (dictionary.empty ())
+    {
+      GetDictionaries ().erase (application);
+      return;
+    }
+  GetDictionaries ()[application] = dictionary;
+  //the next simulation starts without them
+  if (!g_clearScheduled)
+    {
+      Simulator::ScheduleDestroy (&DatpLzCodec::ClearDictionaries);
+      g_clearScheduled = true;
+    }
+}
+
+const std::string &
+DatpLzCodec::GetDictionary (uint8_t application)
+{
+  static const std::string none;
+  std::map<uint8_t,std::string>::const_iterator it = GetDictionaries ().find (application);
+  return it == GetDictionaries ().end () ? none : it->second;
+}
+
+void
+DatpLzCodec::ClearDictionaries (void)
+{
+  GetDictionaries ().clear ();
+  g_clearScheduled = false;
+}
+
+} // namespace ns3
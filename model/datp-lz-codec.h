@@ -0,0 +1,81 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_LZ_CODEC_H__
+#define __DATP_LZ_CODEC_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup datp
+ * \brief Small LZ77 block codec for runs of Datp messages
+ *
+ * A block is a list of sequences, each a token byte (literal count in the
+ * high nibble, match length less 4 in the low nibble, 15 meaning 255-runs
+ * of extra length bytes follow), the literals, then a 2 byte little endian
+ * offset back into the output and the extra match length.  The last
+ * sequence has literals only.  Matches are found through a hash table of
+ * 4 byte prefixes, one candidate per slot, with no chaining, trading ratio
+ * for speed.  A dictionary, when given, is the text before the data: both
+ * ends must use the same one.  Per application dictionaries are kept in a
+ * static registry (SetDictionary), shared by all the nodes of the
+ * simulation and cleared by Simulator::Destroy.  A codec can be reused;
+ * its storage keeps its capacity.
+ */
+class DatpLzCodec
+{
+public:
+  DatpLzCodec ();
+
+  /**
+   * \brief Compress size bytes of data, appending the block to block
+   * \returns the size of the block
+   */
+  uint32_t Compress (const uint8_t *data, uint32_t size, std::string const &dictionary, std::vector<uint8_t> &block);
+  /**
+   * \brief Decompress a block into data, replacing its contents
+   * \returns false if the block is malformed or does not hold exactly rawSize bytes
+   */
+  bool Decompress (const uint8_t *block, uint32_t size, std::string const &dictionary, uint32_t rawSize, std::vector<uint8_t> &data);
+
+  /// Use dictionary for the messages of application, an empty one removes it
+  static void SetDictionary (uint8_t application, std::string const &dictionary);
+  /// Dictionary of application, empty if none
+  static const std::string & GetDictionary (uint8_t application);
+  /// Remove the dictionaries of all applications
+  static void ClearDictionaries (void);
+
+private:
+  static uint32_t Hash (const uint8_t *p);
+  static void WriteLength (std::vector<uint8_t> &block, uint32_t length);
+  static void WriteSequence (std::vector<uint8_t> &block, const uint8_t *literals, uint32_t nLiterals,
+                             uint32_t offset, uint32_t matchLength);
+
+  std::vector<uint8_t> m_window;
+  std::vector<uint32_t> m_table;
+};
+
+} // namespace ns3
+
+#endif /* __DATP_LZ_CODEC_H__ */
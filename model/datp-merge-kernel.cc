@@ -0,0 +1,91 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "datp-merge-kernel.h"
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace ns3 {
+
+uint32_t
+DatpMergeKernel::NetworkToHost (uint32_t word)
+{
+  const uint8_t *p = (const uint8_t *) &word;
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+uint32_t
+DatpMergeKernel::HostToNetwork (uint32_t value)
+{
+  uint32_t word;
+  uint8_t *p = (uint8_t *) &word;
+  p[0] = value >> 24;
+  p[1] = value >> 16;
+  p[2] = value >> 8;
+  p[3] = value;
+  return word;
+}
+
+void
+DatpMergeKernel::MergeGenericScalar (uint32_t *result, const uint32_t *a, const uint32_t *b, uint32_t words)
+{
+  for (uint32_t i = 0; i < words; ++i)
+    {
+      uint32_t x = NetworkToHost (a[i]);
+      uint32_t y = NetworkToHost (b[i]);
+      result[i] = HostToNetwork (x + y + (x == 0) + (y == 0));
+    }
+}
+
+#ifdef __SSE2__
+//SSE2 has no byte shuffle, the swap is done with shifts and masks
+static inline __m128i
+ByteSwap32 (__m128i x)
+{
+  __m128i outer = _mm_or_si128 (_mm_slli_epi32 (x, 24), _mm_srli_epi32 (x, 24));
+  __m128i inner = _mm_or_si128 (_mm_and_si128 (_mm_slli_epi32 (x, 8), _mm_set1_epi32 (0x00ff0000)),
+                                _mm_and_si128 (_mm_srli_epi32 (x, 8), _mm_set1_epi32 (0x0000ff00)));
+  return _mm_or_si128 (outer, inner);
+}
+#endif
+
+void
+DatpMergeKernel::MergeGeneric (uint32_t *result, const uint32_t *a, const uint32_t *b, uint32_t words)
+{
+  uint32_t i = 0;
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128 ();
+  for (; i + 4 <= words; i += 4)
+    {
+      __m128i x = ByteSwap32 (_mm_loadu_si128 ((const __m128i *)(a + i)));
+      __m128i y = ByteSwap32 (_mm_loadu_si128 ((const __m128i *)(b + i)));
+      //a compare sets all ones (-1) where a reading is zero, subtracting adds one
+      __m128i sum = _mm_add_epi32 (x, y);
+      sum = _mm_sub_epi32 (sum, _mm_cmpeq_epi32 (x, zero));
+      sum = _mm_sub_epi32 (sum, _mm_cmpeq_epi32 (y, zero));
+      _mm_storeu_si128 ((__m128i *)(result + i), ByteSwap32 (sum));
+    }
+#endif
+  MergeGenericScalar (result + i, a + i, b + i, words - i);
+}
+
+} // namespace ns3
@@ -0,0 +1,55 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_MERGE_KERNEL_H__
+#define __DATP_MERGE_KERNEL_H__
+
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup datp
+ * \brief Word-wise merge of generic application payloads
+ *
+ * Payloads are arrays of 32 bit readings in network byte order, copied out
+ * of their packets in one go.  A zero reading counts as one message, so two
+ * words a and b merge into a + b + (a == 0) + (b == 0).  With SSE2 four words
+ * are merged per instruction, byte order swaps included; the scalar version
+ * handles the tail and builds without SSE2.  The vector loads and stores
+ * are unaligned on purpose: the second half of a scratch buffer starts at
+ * any word, and unaligned accesses to data that happens to be aligned cost
+ * the same as aligned ones on current cores.
+ */
+class DatpMergeKernel
+{
+public:
+  /// result, a and b hold words network order readings, result may alias a or b
+  static void MergeGeneric (uint32_t *result, const uint32_t *a, const uint32_t *b, uint32_t words);
+  /// Same as MergeGeneric without vector instructions
+  static void MergeGenericScalar (uint32_t *result, const uint32_t *a, const uint32_t *b, uint32_t words);
+
+  static uint32_t NetworkToHost (uint32_t word);
+  static uint32_t HostToNetwork (uint32_t value);
+};
+
+} // namespace ns3
+
+#endif /* __DATP_MERGE_KERNEL_H__ */
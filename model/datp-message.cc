@@ -0,0 +1,243 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/boolean.h"
+#include "ns3/uinteger.h"
+#include "datp-message.h"
+
+NS_LOG_COMPONENT_DEFINE ("DatpMessageStore");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (DatpMessageStore);
+
+TypeId
+DatpMessageStore::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DatpMessageStore")
+    .SetParent<Object> ()
+    .AddConstructor<DatpMessageStore> ()
+    .AddAttribute ("MergeOnPriority",
+                   "Only merge messages of the same priority",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DatpMessageStore::m_mergeOnPriority),
+                   MakeBooleanChecker ())
+    .AddAttribute ("OriginGroupSize",
+                   "Only merge messages whose origins fall in the same block of this many consecutive origins, 0 ignores the origin",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&DatpMessageStore::m_originGroupSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("SequenceWindow",
+                   "Only merge messages whose sequence numbers fall in the same window of this size, 0 ignores the sequence",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&DatpMessageStore::m_sequenceWindow),
+                   MakeUintegerChecker<uint32_t> ())
+  ;
+  return tid;
+}
+
+DatpMessageStore::DatpMessageStore ()
+  : m_lastHandle (0),
+    m_mergeOnPriority (false),
+    m_originGroupSize (0),
+    m_sequenceWindow (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+DatpMessageStore::~DatpMessageStore ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+uint32_t
+DatpMessageStore::Add (DatpMessageDescriptor const &descriptor, Ptr<Packet> payload, Time receiveTime, uint32_t sender)
+{
+  NS_LOG_FUNCTION (this << payload << receiveTime << sender);
+  if (++m_lastHandle == 0)
+    ++m_lastHandle;
+  NS_ASSERT (m_messages.count (m_lastHandle) == 0);
+  DatpMessage &message = m_messages[m_lastHandle];
+  message.hff = descriptor.hff & (64|32|16|8|2);
+  message.sizeModifiers = descriptor.sizeModifiers & DATP_HFF2_SKETCH;
+  message.encodingFlags = descriptor.encodingFlags & (DATP_HFF3_COMPRESSED|DATP_HFF3_QUANTIZED|DATP_HFF3_DELTA|DATP_HFF3_FUSED|DATP_HFF3_WINDOW);
+  message.application = descriptor.application;
+  message.priority = descriptor.priority;
+  message.headerSize = descriptor.headerSize;
+  message.origin = descriptor.origin;
+  message.sequence = descriptor.sequence;
+  message.count = descriptor.count;
+  message.sender = sender;
+  message.timestamp = descriptor.timestamp;
+  message.receiveTime = receiveTime;
+  message.payload = payload;
+  return m_lastHandle;
+}
+
+bool
+DatpMessageStore::Contains (uint32_t handle) const
+{
+  return m_messages.count (handle) != 0;
+}
+
+DatpMessage &
+DatpMessageStore::Get (uint32_t handle)
+{
+  std::map<uint32_t,DatpMessage>::iterator it = m_messages.find (handle);
+  NS_ASSERT_MSG (it != m_messages.end (), "No message for handle " << handle);
+  return it->second;
+}
+
+const DatpMessage &
+DatpMessageStore::Get (uint32_t handle) const
+{
+  std::map<uint32_t,DatpMessage>::const_iterator it = m_messages.find (handle);
+  NS_ASSERT_MSG (it != m_messages.end (), "No message for handle " << handle);
+  return it->second;
+}
+
+void
+DatpMessageStore::Remove (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  m_messages.erase (handle);
+  m_errorSpent.erase (handle);
+  //messages still waiting for handle go with it
+  std::map<uint32_t,std::vector<uint32_t> >::iterator it = m_groups.find (handle);
+  if (it != m_groups.end ())
+    {
+      for (uint32_t i = 0; i < it->second.size (); ++i)
+        {
+          m_messages.erase (it->second[i]);
+          m_errorSpent.erase (it->second[i]);
+        }
+      m_groups.erase (it);
+    }
+}
+
+uint32_t
+DatpMessageStore::Copy (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  DatpMessage message = Get (handle);
+  message.payload = message.payload->Copy ();
+  if (++m_lastHandle == 0)
+    ++m_lastHandle;
+  NS_ASSERT (m_messages.count (m_lastHandle) == 0);
+  m_messages[m_lastHandle] = message;
+  SetErrorSpent (m_lastHandle, GetErrorSpent (handle));
+  return m_lastHandle;
+}
+
+uint32_t
+DatpMessageStore::GetNMessages (void) const
+{
+  return m_messages.size ();
+}
+
+uint64_t
+DatpMessageStore::GetMergeKey (uint32_t handle) const
+{
+  //application 0-7, priority 8-15, origin group 16-39, sequence window 40-63
+  const DatpMessage &message = Get (handle);
+  uint64_t key = message.application;
+  if (m_mergeOnPriority)
+    key |= (uint64_t) message.priority << 8;
+  if (m_originGroupSize)
+    key |= (uint64_t) ((message.origin / m_originGroupSize) & 0xffffff) << 16;
+  if (m_sequenceWindow)
+    key |= (uint64_t) ((message.sequence / m_sequenceWindow) & 0xffffff) << 40;
+  return key;
+}
+
+void
+DatpMessageStore::AddToGroup (uint32_t head, uint32_t member)
+{
+  NS_LOG_FUNCTION (this << head << member);
+  NS_ASSERT (Contains (head) && Contains (member));
+  m_groups[head].push_back (member);
+}
+
+bool
+DatpMessageStore::TakeGroup (uint32_t head, std::vector<uint32_t> &members)
+{
+  NS_LOG_FUNCTION (this << head);
+  members.clear ();
+  std::map<uint32_t,std::vector<uint32_t> >::iterator it = m_groups.find (head);
+  if (it == m_groups.end ())
+    return false;
+  members.swap (it->second);
+  m_groups.erase (it);
+  return true;
+}
+
+DatpHeader
+DatpMessageStore::GetHeader (uint32_t handle) const
+{
+  const DatpMessage &message = Get (handle);
+  DatpHeader datpHeader;
+  if (message.hff&64)
+    datpHeader.SetOrigin (message.origin);
+  if (message.hff&32)
+    datpHeader.SetApplication (message.application);
+  if (message.hff&16)
+    datpHeader.SetPriority (message.priority);
+  if (message.hff&8)
+    datpHeader.SetTimestamp (message.timestamp);
+  datpHeader.SetDataLength (message.payload->GetSize ());
+  if (message.hff&2)
+    datpHeader.SetSequence (message.sequence);
+  if (message.count > 1)
+    datpHeader.SetCount (message.count);
+  if (message.IsSketch ())
+    datpHeader.SetSketch (true);
+  if (message.IsCompressed ())
+    datpHeader.SetCompressed (true);
+  if (message.IsQuantized ())
+    datpHeader.SetQuantized (true);
+  if (message.IsDelta ())
+    datpHeader.SetDelta (true);
+  if (message.IsFused ())
+    datpHeader.SetFused (true);
+  if (message.IsWindow ())
+    datpHeader.SetWindow (true);
+  return datpHeader;
+}
+
+double
+DatpMessageStore::GetErrorSpent (uint32_t handle) const
+{
+  std::map<uint32_t,double>::const_iterator it = m_errorSpent.find (handle);
+  return it == m_errorSpent.end () ? 0 : it->second;
+}
+
+void
+DatpMessageStore::SetErrorSpent (uint32_t handle, double errorSpent)
+{
+  NS_ASSERT (Contains (handle));
+  if (errorSpent == 0)
+    m_errorSpent.erase (handle);
+  else
+    m_errorSpent[handle] = errorSpent;
+}
+
+} // namespace ns3
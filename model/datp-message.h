@@ -0,0 +1,139 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_MESSAGE_H__
+#define __DATP_MESSAGE_H__
+
+#include "ns3/object.h"
+#include "ns3/packet.h"
+#include "ns3/nstime.h"
+#include "datp-headers.h"
+#include "datp-header-view.h"
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup datp
+ * \brief A message held by an aggregator, between receive and eject
+ *
+ * Only the header fields are kept, not a DatpHeader, and the message length
+ * is the payload size.  The payload encoding is kept as the raw HFF2 and
+ * HFF3 flag bytes.  The wire header is rebuilt once, when the message
+ * leaves (DatpMessageStore::GetHeader).
+ */
+struct DatpMessage
+{
+  uint8_t hff;              //!< HFF flags of the fields present
+  uint8_t sizeModifiers;    //!< HFF2 flags of the payload, only DATP_HFF2_SKETCH is kept
+  uint8_t encodingFlags;    //!< HFF3 flags of the payload (DATP_HFF3_COMPRESSED and on)
+  uint8_t application;
+  uint8_t priority;
+  uint8_t headerSize;       //!< size of the header the message arrived with
+  uint32_t sender;          //!< IPv4 address the message was received from, 0 if unknown
+  uint32_t origin;
+  uint32_t sequence;
+  uint32_t count;           //!< readings reduced into the message
+  uint64_t timestamp;
+  Time receiveTime;
+  Ptr<Packet> payload;
+
+  /// The payload is a sketch (DATP_HFF2_SKETCH)
+  bool IsSketch (void) const { return sizeModifiers & DATP_HFF2_SKETCH; }
+  /// The payload is compressed messages (DATP_HFF3_COMPRESSED)
+  bool IsCompressed (void) const { return encodingFlags & DATP_HFF3_COMPRESSED; }
+  /// The payload is quantized readings (DATP_HFF3_QUANTIZED)
+  bool IsQuantized (void) const { return encodingFlags & DATP_HFF3_QUANTIZED; }
+  /// The payload is the change of a running aggregate (DATP_HFF3_DELTA)
+  bool IsDelta (void) const { return encodingFlags & DATP_HFF3_DELTA; }
+  /// The payload is fused records of several applications (DATP_HFF3_FUSED)
+  bool IsFused (void) const { return encodingFlags & DATP_HFF3_FUSED; }
+  /// The timestamp is the start of an aggregated window (DATP_HFF3_WINDOW)
+  bool IsWindow (void) const { return encodingFlags & DATP_HFF3_WINDOW; }
+  /// The payload is the readings or records as the application sent them, windowed or not
+  bool IsPlain (void) const { return sizeModifiers == 0 && (encodingFlags & ~DATP_HFF3_WINDOW) == 0; }
+};
+
+/**
+ * \ingroup datp
+ * \brief Owns the messages of an aggregator, handed around by handle
+ *
+ * The aggregator adds every received message here and passes only its
+ * handle to the function and the scheduler, which read and update the
+ * message in place.  A handle is never zero, zero stands for no message.
+ * Messages may also wait in the group of another message, to be merged into
+ * it in one go when it leaves (see DatpFunction::Reduce).
+ */
+class DatpMessageStore : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  DatpMessageStore ();
+  virtual ~DatpMessageStore ();
+
+  /// Store a message found by a DatpHeaderView, \returns its handle
+  uint32_t Add (DatpMessageDescriptor const &descriptor, Ptr<Packet> payload, Time receiveTime, uint32_t sender = 0);
+  bool Contains (uint32_t handle) const;
+  DatpMessage & Get (uint32_t handle);
+  const DatpMessage & Get (uint32_t handle) const;
+  void Remove (uint32_t handle);
+  /// Store a copy of message handle, payload included, \returns its handle
+  uint32_t Copy (uint32_t handle);
+  uint32_t GetNMessages (void) const;
+  /**
+   * \brief Messages with the same merge key may be merged
+   *
+   * The key is the application, and, as configured, the priority
+   * (MergeOnPriority), the group of consecutive origins (OriginGroupSize)
+   * and the window of sequence numbers (SequenceWindow) of the message.
+   * Origin groups and windows are kept to 24 bits each, they wrap around.
+   */
+  uint64_t GetMergeKey (uint32_t handle) const;
+
+  /// Record that member waits to be merged into head
+  void AddToGroup (uint32_t head, uint32_t member);
+  /**
+   * \brief Hand over the messages waiting for head, in arrival order
+   * \returns false if none are waiting
+   */
+  bool TakeGroup (uint32_t head, std::vector<uint32_t> &members);
+
+  /// Wire header of message handle
+  DatpHeader GetHeader (uint32_t handle) const;
+
+  /// Error budget spent on the readings of message handle so far, see DatpQuantizer
+  double GetErrorSpent (uint32_t handle) const;
+  void SetErrorSpent (uint32_t handle, double errorSpent);
+
+private:
+  std::map<uint32_t,DatpMessage> m_messages;
+  std::map<uint32_t,double> m_errorSpent;  //!< only the messages that spent some
+  std::map<uint32_t,std::vector<uint32_t> > m_groups;
+  uint32_t m_lastHandle;
+  bool m_mergeOnPriority;
+  uint32_t m_originGroupSize;
+  uint32_t m_sequenceWindow;
+};
+
+} // namespace ns3
+
+#endif /* __DATP_MESSAGE_H__ */
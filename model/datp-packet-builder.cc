@@ -0,0 +1,124 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "datp-packet-builder.h"
+
+NS_LOG_COMPONENT_DEFINE ("DatpPacketBuilder");
+
+namespace ns3 {
+
+DatpPacketBuilder::DatpPacketBuilder ()
+  : m_bundleHeaders (false),
+    m_frameHeader (false),
+    m_messagesSize (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+DatpPacketBuilder::SetBundleHeaders (bool bundleHeaders)
+{
+  m_bundleHeaders = bundleHeaders;
+}
+
+void
+DatpPacketBuilder::SetFrameHeader (bool frameHeader)
+{
+  m_frameHeader = frameHeader;
+}
+
+void
+DatpPacketBuilder::SetHeaderContext (Ptr<DatpHeaderContext> headerContext)
+{
+  m_headerContext = headerContext;
+}
+
+void
+DatpPacketBuilder::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_headers.clear ();
+  m_payloads.clear ();
+  m_frame = DatpFrameHeader ();
+  m_messagesSize = 0;
+}
+
+void
+DatpPacketBuilder::AddMessage (DatpHeader const &datpHeader, Ptr<const Packet> payload)
+{
+  NS_LOG_FUNCTION (this << payload);
+  //all but the first message may be reduced to the fields that change,
+  //the first one of a bundle may refer to a link context instead
+  DatpHeader wireHeader = datpHeader;
+  if (!(m_bundleHeaders && !m_headers.empty () && wireHeader.MakeBundleMember (m_bundleFirst, m_bundlePrevious)))
+    {
+      m_bundleFirst = datpHeader;
+      if (m_headerContext)
+        m_headerContext->Compress (wireHeader);
+    }
+  m_bundlePrevious = datpHeader;
+
+  uint32_t messageSize = wireHeader.GetInternalHeaderSize () + payload->GetSize ();
+  m_frame.AddMessage (messageSize);
+  m_messagesSize += messageSize;
+  m_headers.push_back (wireHeader);
+  m_payloads.push_back (payload);
+}
+
+uint32_t
+DatpPacketBuilder::GetNMessages (void) const
+{
+  return m_headers.size ();
+}
+
+uint32_t
+DatpPacketBuilder::GetSize (void) const
+{
+  return m_messagesSize + ((m_frameHeader && !m_headers.empty ()) ? m_frame.GetSerializedSize () : 0);
+}
+
+Ptr<Packet>
+DatpPacketBuilder::Build (void)
+{
+  NS_LOG_FUNCTION (this);
+  uint32_t size = GetSize ();
+  if (size == 0)
+    {
+      Clear ();
+      return Create<Packet> (0);
+    }
+  m_buffer.resize (size);
+  uint8_t *p = &m_buffer[0];
+  if (m_frameHeader)
+    p += m_frame.Write (p);
+  for (uint32_t m = 0; m < m_headers.size (); ++m)
+    {
+      p += m_headers[m].Write (p);
+      p += m_payloads[m]->CopyData (p, m_payloads[m]->GetSize ());
+    }
+  NS_ASSERT ((uint32_t)(p - &m_buffer[0]) == size);
+  NS_LOG_INFO ("Built packet of " << m_headers.size () << " messages, " << size << " bytes");
+  Clear ();
+  return Create<Packet> (&m_buffer[0], size);
+}
+
+} // namespace ns3
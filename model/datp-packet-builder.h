@@ -0,0 +1,83 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_PACKET_BUILDER_H__
+#define __DATP_PACKET_BUILDER_H__
+
+#include "ns3/packet.h"
+#include "datp-headers.h"
+#include "datp-header-context.h"
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup datp
+ * \brief Builds a Datp packet out of messages in one contiguous buffer
+ *
+ * Messages are queued with their wire headers encoded as they come (bundle
+ * members, link contexts), so the exact packet size is known before anything
+ * is written.  Build then serializes the frame header, every header and every
+ * payload into a single buffer in one pass and wraps it in a packet, instead
+ * of growing a packet fragment by fragment.  A builder can be reused; its
+ * storage keeps its capacity.
+ */
+class DatpPacketBuilder
+{
+public:
+  DatpPacketBuilder ();
+
+  void SetBundleHeaders (bool bundleHeaders);
+  void SetFrameHeader (bool frameHeader);
+  /// Link contexts used to compress the first message of every bundle, may be 0
+  void SetHeaderContext (Ptr<DatpHeaderContext> headerContext);
+
+  /// Forget the queued messages, the next message starts a new packet
+  void Clear (void);
+  /**
+   * \brief Queue a message
+   * \param datpHeader the full header, encoded for the wire here
+   * \param payload message payload, only referenced until Build
+   */
+  void AddMessage (DatpHeader const &datpHeader, Ptr<const Packet> payload);
+
+  uint32_t GetNMessages (void) const;
+  /// Exact size of the packet Build returns
+  uint32_t GetSize (void) const;
+  /// Serialize the queued messages into one packet and Clear
+  Ptr<Packet> Build (void);
+
+private:
+  bool m_bundleHeaders;
+  bool m_frameHeader;
+  Ptr<DatpHeaderContext> m_headerContext;
+
+  std::vector<DatpHeader> m_headers;
+  std::vector<Ptr<const Packet> > m_payloads;
+  DatpFrameHeader m_frame;
+  DatpHeader m_bundleFirst;
+  DatpHeader m_bundlePrevious;
+  uint32_t m_messagesSize;
+  std::vector<uint8_t> m_buffer;
+};
+
+} // namespace ns3
+
+#endif /* __DATP_PACKET_BUILDER_H__ */
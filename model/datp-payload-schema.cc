@@ -0,0 +1,335 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "datp-payload-schema.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/simulator.h"
+#include <map>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+
+NS_LOG_COMPONENT_DEFINE ("DatpPayloadSchema");
+
+namespace ns3 {
+
+static std::map<uint8_t,DatpPayloadSchema> &
+GetSchemas (void)
+{
+  static std::map<uint8_t,DatpPayloadSchema> schemas;
+  return schemas;
+}
+
+//whether Simulator::Destroy is due to clear the schemas
+static bool g_clearScheduled = false;
+
+DatpPayloadSchema::DatpPayloadSchema ()
+  : m_size (0)
+{
+}
+
+void
+DatpPayloadSchema::AddField (FieldType type, Reduction reduction, double scale)
+{
+  NS_LOG_FUNCTION (this << type << reduction << scale);
+  NS_ASSERT (scale > 0);
+  Field field;
+  field.type = type;
+  field.reduction = reduction;
+  field.width = (type == U16 || type == Q16) ? 2 : 4;
+  field.offset = m_size;
+  field.scale = scale;
+  switch (type)
+    {
+    case U16:
+      field.min = 0;
+      field.max = 0xffff;
+      break;
+    case U32:
+      field.min = 0;
+      field.max = 0xffffffffLL;
+      break;
+    case Q16:
+      field.min = -0x8000;
+      field.max = 0x7fff;
+      break;
+    default:
+      field.min = -0x80000000LL;
+      field.max = 0x7fffffffLL;
+      break;
+    }
+  m_fields.push_back (field);
+  m_size += field.width;
+}
+
+bool
+DatpPayloadSchema::Parse (std::string const &fields)
+{
+  NS_LOG_FUNCTION (this << fields);
+  m_fields.clear ();
+  m_size = 0;
+  std::istringstream declarations (fields);
+  std::string declaration;
+  while (declarations >> declaration)
+    if (!ParseField (declaration))
+      {
+        NS_LOG_WARN ("Cannot parse payload schema field " << declaration);
+        m_fields.clear ();
+        m_size = 0;
+        return false;
+      }
+  return true;
+}
+
+bool
+DatpPayloadSchema::ParseField (std::string const &declaration)
+{
+  std::string::size_type colon = declaration.find (':');
+  if (colon == std::string::npos)
+    return false;
+  std::string type = declaration.substr (0, colon);
+  std::string reduction = declaration.substr (colon + 1);
+  double scale = 1.0;
+  std::string::size_type slash = type.find ('/');
+  if (slash != std::string::npos)
+    {
+      scale = atof (type.substr (slash + 1).c_str ());
+      type = type.substr (0, slash);
+      if (scale <= 0 || (type != "q16" && type != "q32"))
+        return false;
+    }
+  else if (type == "q16" || type == "q32")
+    return false;
+
+  FieldType fieldType;
+  if (type == "u16")
+    fieldType = U16;
+  else if (type == "u32")
+    fieldType = U32;
+  else if (type == "i32")
+    fieldType = I32;
+  else if (type == "f32")
+    fieldType = F32;
+  else if (type == "q16")
+    fieldType = Q16;
+  else if (type == "q32")
+    fieldType = Q32;
+  else
+    return false;
+
+  Reduction fieldReduction;
+  if (reduction == "sum")
+    fieldReduction = SUM;
+  else if (reduction == "min")
+    fieldReduction = MIN;
+  else if (reduction == "max")
+    fieldReduction = MAX;
+  else if (reduction == "mean")
+    fieldReduction = MEAN;
+  else if (reduction == "last")
+    fieldReduction = LAST;
+  else
+    return false;
+  AddField (fieldType, fieldReduction, scale);
+  return true;
+}
+
+uint32_t
+DatpPayloadSchema::GetNFields (void) const
+{
+  return m_fields.size ();
+}
+
+uint32_t
+DatpPayloadSchema::GetSize (void) const
+{
+  return m_size;
+}
+
+int64_t
+DatpPayloadSchema::ReadInteger (const uint8_t *record, Field const &field) const
+{
+  const uint8_t *p = record + field.offset;
+  if (field.width == 2)
+    {
+      uint16_t value = (p[0] << 8) | p[1];
+      return field.type == U16 ? (int64_t) value : (int64_t) (int16_t) value;
+    }
+  uint32_t value = ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+  return field.type == U32 ? (int64_t) value : (int64_t) (int32_t) value;
+}
+
+void
+DatpPayloadSchema::WriteInteger (uint8_t *record, Field const &field, int64_t value) const
+{
+  if (value < field.min)
+    value = field.min;
+  if (value > field.max)
+    value = field.max;
+  uint8_t *p = record + field.offset;
+  if (field.width == 2)
+    {
+      p[0] = value >> 8;
+      p[1] = value;
+      return;
+    }
+  p[0] = value >> 24;
+  p[1] = value >> 16;
+  p[2] = value >> 8;
+  p[3] = value;
+}
+
+float
+DatpPayloadSchema::ReadFloat (const uint8_t *record, Field const &field) const
+{
+  uint32_t bits = (uint32_t) ReadInteger (record, field);
+  float value;
+  memcpy (&value, &bits, 4);
+  return value;
+}
+
+void
+DatpPayloadSchema::WriteFloat (uint8_t *record, Field const &field, float value) const
+{
+  uint32_t bits;
+  memcpy (&bits, &value, 4);
+  uint8_t *p = record + field.offset;
+  p[0] = bits >> 24;
+  p[1] = bits >> 16;
+  p[2] = bits >> 8;
+  p[3] = bits;
+}
+
+double
+DatpPayloadSchema::Read (const uint8_t *record, uint32_t field) const
+{
+  NS_ASSERT (field < m_fields.size ());
+  Field const &f = m_fields[field];
+  if (f.type == F32)
+    return ReadFloat (record, f);
+  return ReadInteger (record, f) / f.scale;
+}
+
+void
+DatpPayloadSchema::Write (uint8_t *record, uint32_t field, double value) const
+{
+  NS_ASSERT (field < m_fields.size ());
+  Field const &f = m_fields[field];
+  if (f.type == F32)
+    WriteFloat (record, f, value);
+  else
+    {
+      double scaled = floor (value * f.scale + 0.5);
+      //saturate before converting, out of range conversions are undefined
+      WriteInteger (record, f, scaled < f.min ? f.min : scaled > f.max ? f.max : (int64_t) scaled);
+    }
+}
+
+void
+DatpPayloadSchema::Reduce (uint8_t *result, const uint8_t *incoming, uint32_t resultCount, uint32_t incomingCount,
+                           bool incomingLater) const
+{
+  double count = (double) resultCount + incomingCount;
+  for (std::vector<Field>::const_iterator f = m_fields.begin (); f != m_fields.end (); ++f)
+    {
+      if (f->reduction == LAST)
+        {
+          if (incomingLater)
+            memcpy (result + f->offset, incoming + f->offset, f->width);
+          continue;
+        }
+      if (f->type == F32)
+        {
+          float a = ReadFloat (result, *f);
+          float b = ReadFloat (incoming, *f);
+          switch (f->reduction)
+            {
+            case SUM:
+              a += b;
+              break;
+            case MIN:
+              a = b < a ? b : a;
+              break;
+            case MAX:
+              a = b > a ? b : a;
+              break;
+            default:
+              a = ((double) a * resultCount + (double) b * incomingCount) / count;
+              break;
+            }
+          WriteFloat (result, *f, a);
+          continue;
+        }
+      int64_t a = ReadInteger (result, *f);
+      int64_t b = ReadInteger (incoming, *f);
+      switch (f->reduction)
+        {
+        case SUM:
+          a += b;
+          break;
+        case MIN:
+          a = b < a ? b : a;
+          break;
+        case MAX:
+          a = b > a ? b : a;
+          break;
+        default:
+          a = (int64_t) floor (((double) a * resultCount + (double) b * incomingCount) / count + 0.5);
+          break;
+        }
+      WriteInteger (result, *f, a);
+    }
+}
+
+void
+DatpPayloadSchema::Register (uint8_t application, DatpPayloadSchema const &schema)
+{
+  if (schema.GetNFields () == 0)
+    {
+      GetSchemas ().erase (application);
+      return;
+    }
+  GetSchemas ()[application] = schema;
+  //the next simulation starts without them
+  if (!g_clearScheduled)
+    {
+      Simulator::ScheduleDestroy (&DatpPayloadSchema::Clear);
+      g_clearScheduled = true;
+    }
+}
+
+const DatpPayloadSchema *
+DatpPayloadSchema::Lookup (uint8_t application)
+{
+  std::map<uint8_t,DatpPayloadSchema>::const_iterator it = GetSchemas ().find (application);
+  return it == GetSchemas ().end () ? 0 : &it->second;
+}
+
+void
+DatpPayloadSchema::Clear (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  GetSchemas ().clear ();
+  g_clearScheduled = false;
+}
+
+} // namespace ns3
@@ -0,0 +1,134 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_PAYLOAD_SCHEMA_H__
+#define __DATP_PAYLOAD_SCHEMA_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup datp
+ * \brief Typed layout of the payload records of an application
+ *
+ * A record is a run of fields in network order, each at its natural width
+ * and with its own reduction.  Fields are declared in a string, one
+ * type:reduction pair per field separated by spaces, e.g.
+ * "u16:sum q16/100:mean i32:min":
+ *   - u16, u32, i32: integers of 2, 4 and 4 bytes
+ *   - f32: IEEE single precision float, 4 bytes
+ *   - q16/S, q32/S: a float packed in a signed fixed point integer of 2 or 4
+ *     bytes counting 1/S units, e.g. q16/100 spans -327.68 to 327.67
+ *   - sum, min, max, mean (weighted by the readings of each record), last
+ *
+ * Parse compiles the fields into a flat table of offsets and operations
+ * once, Reduce then walks it over raw record bytes.  Integer and fixed
+ * point fields are reduced in 64 bit integers and saturate at the limits
+ * of their width; scaling does not change a sum, min, max or mean, so fixed
+ * point fields never go through floating point.  Schemas are kept per
+ * application in a registry (Register) shared by all the nodes of the
+ * simulation, and cleared by Simulator::Destroy.
+ */
+class DatpPayloadSchema
+{
+public:
+  enum FieldType
+  {
+    U16,
+    U32,
+    I32,
+    F32,
+    Q16,
+    Q32
+  };
+
+  enum Reduction
+  {
+    SUM,
+    MIN,
+    MAX,
+    MEAN,
+    LAST
+  };
+
+  DatpPayloadSchema ();
+
+  /// Append a field, scale is the units per 1.0 of a fixed point field
+  void AddField (FieldType type, Reduction reduction, double scale = 1.0);
+  /**
+   * \brief Replace the fields by those declared in fields
+   * \returns false, leaving the schema empty, if fields does not parse
+   */
+  bool Parse (std::string const &fields);
+
+  uint32_t GetNFields (void) const;
+  /// Bytes of one record
+  uint32_t GetSize (void) const;
+
+  /// Value of field of a record, fixed point fields scaled back
+  double Read (const uint8_t *record, uint32_t field) const;
+  /// Store value in field of a record, rounded and saturated to the field
+  void Write (uint8_t *record, uint32_t field, double value) const;
+
+  /**
+   * \brief Reduce record incoming into result, field by field
+   * \param resultCount readings result stands for, weighting a mean
+   * \param incomingCount readings incoming stands for
+   * \param incomingLater incoming is the latest, its last fields win
+   */
+  void Reduce (uint8_t *result, const uint8_t *incoming, uint32_t resultCount, uint32_t incomingCount,
+               bool incomingLater) const;
+
+  /// Use schema for the payloads of application, an empty one removes it
+  static void Register (uint8_t application, DatpPayloadSchema const &schema);
+  /// Schema of application, 0 if none
+  static const DatpPayloadSchema * Lookup (uint8_t application);
+  /// Remove the schemas of all applications
+  static void Clear (void);
+
+private:
+  struct Field
+  {
+    uint8_t type;
+    uint8_t reduction;
+    uint8_t width;
+    uint16_t offset;
+    double scale;
+    int64_t min;            //!< smallest integer the field holds
+    int64_t max;            //!< largest integer the field holds
+  };
+
+  /// Append the field declared as type:reduction, \returns false if it does not parse
+  bool ParseField (std::string const &declaration);
+  int64_t ReadInteger (const uint8_t *record, Field const &field) const;
+  void WriteInteger (uint8_t *record, Field const &field, int64_t value) const;
+  float ReadFloat (const uint8_t *record, Field const &field) const;
+  void WriteFloat (uint8_t *record, Field const &field, float value) const;
+
+  std::vector<Field> m_fields;
+  uint32_t m_size;
+};
+
+} // namespace ns3
+
+#endif /* __DATP_PAYLOAD_SCHEMA_H__ */
@@ -0,0 +1,196 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#include "datp-quantizer.h"
+#include "datp-headers.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include <map>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+NS_LOG_COMPONENT_DEFINE ("DatpQuantizer");
+
+namespace ns3 {
+
+struct DatpErrorBudget
+{
+  double budget;
+  bool relative;
+};
+
+static std::map<uint8_t,DatpErrorBudget> &
+GetErrorBudgets (void)
+{
+  static std::map<uint8_t,DatpErrorBudget> budgets;
+  return budgets;
+}
+
+//whether Simulator::Destroy is due to clear the budgets
+static bool g_clearScheduled = false;
+
+void
+DatpQuantizer::SetErrorBudget (uint8_t application, double budget, bool relative)
+{
+  if (budget <= 0)
+    {
+      GetErrorBudgets ().erase (application);
+      return;
+    }
+  DatpErrorBudget &errorBudget = GetErrorBudgets ()[application];
+  errorBudget.budget = budget;
+  errorBudget.relative = relative;
+  //the next simulation starts without them
+  if (!g_clearScheduled)
+    {
+      Simulator::ScheduleDestroy (&DatpQuantizer::ClearErrorBudgets);
+      g_clearScheduled = true;
+    }
+}
+
+double
+DatpQuantizer::GetErrorBudget (uint8_t application)
+{
+  std::map<uint8_t,DatpErrorBudget>::const_iterator it = GetErrorBudgets ().find (application);
+  return it == GetErrorBudgets ().end () ? 0 : it->second.budget;
+}
+
+bool
+DatpQuantizer::IsRelative (uint8_t application)
+{
+  std::map<uint8_t,DatpErrorBudget>::const_iterator it = GetErrorBudgets ().find (application);
+  return it != GetErrorBudgets ().end () && it->second.relative;
+}
+
+void
+DatpQuantizer::ClearErrorBudgets (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  GetErrorBudgets ().clear ();
+  g_clearScheduled = false;
+}
+
+/// Reading restored from its quantized value
+static inline uint32_t
+Restore (uint64_t quantized, uint32_t shift)
+{
+  uint64_t reading = quantized << shift;
+  return reading > 0xffffffffULL ? 0xffffffff : reading;
+}
+
+double
+DatpQuantizer::Pack (const uint32_t *readings, uint32_t n, bool relative, double spend, double spent,
+                     std::vector<uint8_t> &payload)
+{
+  NS_LOG_FUNCTION (n << relative << spend << spent);
+  //a relative budget holds for the smallest reading, so for all of them
+  uint32_t smallest = 0;
+  for (uint32_t i = 0; i < n; ++i)
+    if (readings[i] != 0 && (smallest == 0 || readings[i] < smallest))
+      smallest = readings[i];
+  double allowed = relative ? spend * smallest : spend;
+  //rounding to a step of 2^shift is off by 2^(shift - 1) at most
+  uint32_t shift = 0;
+  while (shift < 31 && std::ldexp (1.0, shift) <= allowed)
+    ++shift;
+
+  uint64_t largest = 0;
+  double error = 0;
+  std::vector<uint64_t> quantized (n);
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      quantized[i] = shift ? ((uint64_t) readings[i] + (1ULL << (shift - 1))) >> shift : readings[i];
+      largest = std::max (largest, quantized[i]);
+      if (readings[i] != 0)
+        {
+          double off = std::fabs ((double) Restore (quantized[i], shift) - readings[i]);
+          error = std::max (error, relative ? off / readings[i] : off);
+        }
+    }
+  uint32_t width = n > 0 ? 1 : 0;
+  while (width < 64 && (largest >> width) != 0)
+    ++width;
+
+  spent += error;
+  //never tell the next hops less was spent than was
+  float spentValue = spent;
+  if (spentValue < spent)
+    spentValue = nextafterf (spentValue, 2 * spentValue + 1);
+  uint32_t spentBits;
+  memcpy (&spentBits, &spentValue, 4);
+  uint32_t start = payload.size ();
+  payload.resize (start + 2 + DatpHeader::GetVarintSize (n) + 4 + (n * width + 7) / 8, 0);
+  uint8_t *p = &payload[start];
+  *p++ = shift;
+  *p++ = width;
+  p += DatpHeader::WriteVarint (p, n);
+  *p++ = spentBits >> 24;
+  *p++ = spentBits >> 16;
+  *p++ = spentBits >> 8;
+  *p++ = spentBits;
+  //most significant bit first
+  uint64_t bit = 0;
+  for (uint32_t i = 0; i < n; ++i)
+    for (int32_t b = width - 1; b >= 0; --b, ++bit)
+      if ((quantized[i] >> b) & 1)
+        p[bit / 8] |= 0x80 >> (bit % 8);
+  NS_LOG_INFO ("Quantized " << n << " readings with shift " << shift << " into " << width << " bits each, error " << error);
+  return spent;
+}
+
+bool
+DatpQuantizer::Unpack (const uint8_t *data, uint32_t size, std::vector<uint32_t> &readings, double &spent)
+{
+  NS_LOG_FUNCTION (size);
+  if (size < 2)
+    return false;
+  uint32_t shift = data[0];
+  uint32_t width = data[1];
+  uint64_t n;
+  uint32_t read = DatpHeader::ReadVarint (data + 2, size - 2, n);
+  uint32_t offset = 2 + read;
+  if (read == 0 || shift > 31 || width > 33 || offset + 4 > size)
+    return false;
+  //bound n by the bits left before n * width can overflow
+  uint64_t bits = 8ULL * (size - offset - 4);
+  if ((width == 0 && n > 0) || (width > 0 && n > bits / width)
+      || (n * width + 7) / 8 != size - offset - 4)
+    return false;
+  uint32_t spentBits = ((uint32_t) data[offset] << 24) | ((uint32_t) data[offset + 1] << 16)
+                       | ((uint32_t) data[offset + 2] << 8) | data[offset + 3];
+  float spentValue;
+  memcpy (&spentValue, &spentBits, 4);
+  spent = spentValue;
+  const uint8_t *p = data + offset + 4;
+
+  readings.resize (n);
+  uint64_t bit = 0;
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      uint64_t quantized = 0;
+      for (uint32_t b = 0; b < width; ++b, ++bit)
+        quantized = (quantized << 1) | ((p[bit / 8] >> (7 - bit % 8)) & 1);
+      readings[i] = Restore (quantized, shift);
+    }
+  return true;
+}
+
+} // namespace ns3
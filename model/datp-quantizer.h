@@ -0,0 +1,84 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2009 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Andrew Stanton <acstanton515@gmail.com>
+ */
+
+#ifndef __DATP_QUANTIZER_H__
+#define __DATP_QUANTIZER_H__
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup datp
+ * \brief Error-budgeted quantization of 32 bit readings
+ *
+ * An application may declare the largest error each of its readings may
+ * reach the collector with (SetErrorBudget), absolute in reading units, or
+ * relative to each reading; an aggregate of several readings may carry the
+ * error of each, see DatpFunctionTyped.  The budgets are shared by all the nodes of the simulation
+ * and cleared by Simulator::Destroy.  Pack rounds the readings to the coarsest power of two step
+ * whose error fits the share of the budget it is allowed to spend, then
+ * packs the rounded readings in as few bits as the largest needs.  The
+ * error spent along the way travels in front of the readings, so the next
+ * hops know what is left:
+ * \verbatim
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |     Shift     |     Width     |  Readings (varint) ...        |
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |                   Error spent (float, 32 bit)                 |
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |             Readings >> Shift, Width bits each ...            |
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   \endverbatim
+ * Zero readings are always exact, so are all readings with a zero shift.
+ * Every reading takes at least one bit, so the size of a payload bounds the
+ * readings it may claim.
+ */
+class DatpQuantizer
+{
+public:
+  /// Declare the error budget of application, a zero budget removes it
+  static void SetErrorBudget (uint8_t application, double budget, bool relative);
+  /// Error budget of application, zero if it has none
+  static double GetErrorBudget (uint8_t application);
+  /// Whether the error budget of application is relative to each reading
+  static bool IsRelative (uint8_t application);
+  /// Remove the error budgets of all applications
+  static void ClearErrorBudgets (void);
+
+  /**
+   * \brief Quantize n readings, given in host order, into payload
+   * \param spend error this hop may add, in the units of the budget
+   * \param spent error already spent on the readings
+   * \returns the error spent on the packed readings, spent included
+   */
+  static double Pack (const uint32_t *readings, uint32_t n, bool relative, double spend, double spent,
+                      std::vector<uint8_t> &payload);
+  /**
+   * \brief Restore the readings of a packed payload, in host order
+   * \returns false if the payload is malformed
+   */
+  static bool Unpack (const uint8_t *data, uint32_t size, std::vector<uint32_t> &readings, double &spent);
+};
+
+} // namespace ns3
+
+#endif /* __DATP_QUANTIZER_H__ */
@@ -22,6 +22,7 @@
 #include "ns3/log.h"
 #include "ns3/assert.h"
 #include "ns3/simulator.h"
+#include "ns3/boolean.h"
 
 namespace ns3 {
 
@@ -44,6 +45,16 @@ TypeId DatpSchedulerSimple::GetTypeId (void)
                    TimeValue (MicroSeconds (500)),
                    MakeTimeAccessor (&DatpSchedulerSimple::m_minimumHold),
                    MakeTimeChecker ())
+    .AddAttribute ("BundleHeaders",
+                   "Encode concatenated messages as a bundle, carrying only the fields that change", 
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DatpSchedulerSimple::m_bundleHeaders),
+                   MakeBooleanChecker ())
+    .AddAttribute ("FrameHeader",
+                   "Put a frame header with the message count and sizes in front of ejected packets",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DatpSchedulerSimple::m_frameHeader),
+                   MakeBooleanChecker ())
   ;
   return tid;
 }
@@ -80,107 +91,88 @@ DatpSchedulerSimple::GetSchedulerDelay ()
 }
 
 void 
-DatpSchedulerSimple::ReceiveQuery (DatpHeader datpHeader)
+DatpSchedulerSimple::ReceiveNewMessage (uint32_t handle)
 {
-  NS_LOG_FUNCTION (this);
-  DatpHeader existingDatpHeader;
-  Ptr<Packet> existingPacket = NULL;
-  
-  for (std::map<uint32_t,DatpHeader> ::iterator it = m_headerBuffer.begin (); it != m_headerBuffer.end (); ++it)
-    {
-      if (it->second.GetApplication () == datpHeader.GetApplication ())
-        {
-          existingDatpHeader = it->second;
-          existingPacket = m_messageBuffer[it->first];
-          break;
-        }
-    }
-
-  NotifyQueryResponse( existingDatpHeader, existingPacket);
-}
-
-void 
-DatpSchedulerSimple::ReceiveNewMessage (DatpHeader datpHeader, Ptr<Packet> packet)
-{
-  NS_LOG_FUNCTION (this);
+  NS_LOG_FUNCTION (this << handle);
   
-  uint32_t mId = datpHeader.GetInternalMessageIdentifier ();
-  NS_ASSERT (mId != 0);
-  NS_ASSERT (m_messageBuffer.count (mId) == 0);
-  m_headerBuffer[mId] = datpHeader;
+  NS_ASSERT (handle != 0);
+  NS_ASSERT (m_messageStore->Contains (handle));
+  NS_ASSERT (m_timerBuffer.count (handle) == 0);
   
-  uint32_t sizeBefore = m_messageBuffer.size ();
-  m_messageBuffer[mId] = packet;
-  uint32_t sizeAfter = m_messageBuffer.size ();
-  NS_LOG_INFO ("Buffer Add: Size from " << sizeBefore << " to " << sizeAfter << " mId=" << mId);
-  NS_ASSERT (sizeBefore != sizeAfter);
-
+  uint32_t sizeBefore = m_timerBuffer.size ();
   Timer messageEjectTimer (Timer::CANCEL_ON_DESTROY);
-  m_timerBuffer[mId] = messageEjectTimer;
-  m_timerBuffer[mId].SetFunction (&DatpSchedulerSimple::MessageTimerExpired, this);
-  m_timerBuffer[mId].SetDelay (m_maximumHold);
-  m_timerBuffer[mId].Schedule ();
+  m_timerBuffer[handle] = messageEjectTimer;
+  NS_LOG_INFO ("Buffer Add: Size from " << sizeBefore << " to " << m_timerBuffer.size () << " mId=" << handle);
+  m_timerBuffer[handle].SetFunction (&DatpSchedulerSimple::MessageTimerExpired, this);
+  m_timerBuffer[handle].SetDelay (m_maximumHold);
+  m_timerBuffer[handle].Schedule ();
+  IndexMessage (handle);
 }
 
 void 
-DatpSchedulerSimple::ReceiveExistingMessage (DatpHeader datpHeader, Ptr<Packet> packet)
+DatpSchedulerSimple::ReceiveExistingMessage (uint32_t handle)
 {
-  NS_LOG_FUNCTION (this);
-  //should already exist - but lets check anyway
-  uint32_t mId = datpHeader.GetInternalMessageIdentifier ();
-  NS_ASSERT (m_messageBuffer.count (mId));
-  m_messageBuffer[mId] = packet;
-  m_headerBuffer[mId] = datpHeader;
+  NS_LOG_FUNCTION (this << handle);
+  //the function updated the message in the store, it should still be buffered
+  NS_ASSERT (m_timerBuffer.count (handle));
 }
 
 void 
 DatpSchedulerSimple::MessageTimerExpired (void)
 {
   NS_LOG_FUNCTION (this);
-  Ptr<Packet> ejectPacket = Create<Packet> (0);
   bool didTimerExpire = false;
   std::vector<uint32_t> timersToErase;
+  m_packetBuilder.SetBundleHeaders (m_bundleHeaders);
+  m_packetBuilder.SetFrameHeader (m_frameHeader);
+  m_packetBuilder.SetHeaderContext (m_headerContext);
+  m_packetBuilder.Clear ();
   for (std::map<uint32_t,Timer >::iterator it = m_timerBuffer.begin (); it != m_timerBuffer.end (); ++it)
     {
       if (it->second.GetDelayLeft () < m_minimumHold)
         {
           NS_LOG_INFO ("Eject Message: mId=" << it->first);
-          NS_ASSERT (m_messageBuffer.count (it->first));
+          NS_ASSERT (m_messageStore->Contains (it->first));
+          NotifyReduce (it->first);
+          const DatpMessage &message = m_messageStore->Get (it->first);
           
-          DatpGenericApplicationDataHeader dataHeader;
-          m_messageBuffer[it->first]->PeekHeader (dataHeader);
+          //typed functions count the readings, the simple one keeps them in the payload,
+          //schema records may be shorter than the count
+          uint32_t readings = message.count;
+          if (readings <= 1 && message.IsPlain () && message.payload->GetSize () >= 4)
+            {
+              DatpGenericApplicationDataHeader dataHeader;
+              message.payload->PeekHeader (dataHeader);
+              readings = dataHeader.GetValue ();
+            }
           
-          m_messageBuffer[it->first]->AddHeader(m_headerBuffer[it->first]);
-          ejectPacket->AddAtEnd (m_messageBuffer[it->first]);
+          m_packetBuilder.AddMessage (m_messageStore->GetHeader (it->first), message.payload);
           
-          if (dataHeader.GetValue () > 0)
+          if (readings > 0)
             {
-              uint64_t timeDifference = Simulator::Now ().GetNanoSeconds () - m_headerBuffer[it->first].GetInternalReceiveTime ().GetNanoSeconds ();
-              m_schedulerDelay += NanoSeconds (timeDifference * dataHeader.GetValue ());
-              m_messagesTotal += dataHeader.GetValue ();
+              uint64_t timeDifference = Simulator::Now ().GetNanoSeconds () - message.receiveTime.GetNanoSeconds ();
+              m_schedulerDelay += NanoSeconds (timeDifference * readings);
+              m_messagesTotal += readings;
             }
           else
             {
-              m_schedulerDelay += Simulator::Now () - m_headerBuffer[it->first].GetInternalReceiveTime ();
+              m_schedulerDelay += Simulator::Now () - message.receiveTime;
               m_messagesTotal += 1;
             }
           if (didTimerExpire == true)
             m_messagesConcatenated++;
           didTimerExpire = true;
           
-          uint32_t sizeBefore = m_messageBuffer.size ();
-          uint32_t sizeBefore2 = m_headerBuffer.size ();
+          uint32_t sizeBefore = m_messageStore->GetNMessages ();
           it->second.Cancel ();
-          m_messageBuffer.erase (it->first);
-          m_headerBuffer.erase (it->first);
+          UnindexMessage (it->first);
+          m_messageStore->Remove (it->first);
           // m_timerBuffer.erase (it);    //cannot erase now, since we have an active iterator
           timersToErase.push_back(it->first);
-          uint32_t sizeAfter = m_messageBuffer.size ();
-          uint32_t sizeAfter2 = m_headerBuffer.size ();
+          uint32_t sizeAfter = m_messageStore->GetNMessages ();
 
-          NS_LOG_INFO ("Buffer Remove: Size from " << sizeBefore << " " << sizeBefore2 << " (packet, timer) to " << sizeAfter << " " << sizeAfter2);
+          NS_LOG_INFO ("Buffer Remove: Size from " << sizeBefore << " to " << sizeAfter);
           NS_ASSERT (sizeBefore != sizeAfter);
-          NS_ASSERT (sizeBefore2 != sizeAfter2);
         }
         
     } 
@@ -190,7 +182,7 @@ DatpSchedulerSimple::MessageTimerExpired (void)
     }
   NS_ASSERT (didTimerExpire);
   NS_LOG_INFO ("Packet Eject!");
-  NotifyPacketEject (ejectPacket);
+  NotifyPacketEject (m_packetBuilder.Build ());
 }
 
 } // namespace ns3
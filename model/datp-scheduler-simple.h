@@ -23,6 +23,7 @@
 
 #include "datp-headers.h"
 #include "datp-scheduler.h"
+#include "datp-packet-builder.h"
 
 namespace ns3 {
 
@@ -38,14 +39,16 @@ public:
   uint32_t GetMessagesTotal ();
   Time GetSchedulerDelay ();
 
-  virtual void ReceiveQuery (DatpHeader datpHeader);
-  virtual void ReceiveNewMessage (DatpHeader datpHeader, Ptr<Packet> packet);
-  virtual void ReceiveExistingMessage (DatpHeader datpHeader, Ptr<Packet> packet);
+  virtual void ReceiveNewMessage (uint32_t handle);
+  virtual void ReceiveExistingMessage (uint32_t handle);
 
 private:
   Time m_maximumHold;
   Time m_minimumHold;
+  bool m_bundleHeaders;
+  bool m_frameHeader;
   void MessageTimerExpired (void);
+  DatpPacketBuilder m_packetBuilder;
   
   uint32_t m_messagesConcatenated;
   uint32_t m_messagesTotal;
@@ -45,11 +45,11 @@ DatpScheduler::~DatpScheduler()
   NS_LOG_FUNCTION (this);
 }
 
-void 
-DatpScheduler::SetQueryResponseCallback (Callback<void, DatpHeader, Ptr<Packet> > queryResponse)
+void
+DatpScheduler::SetMessageStore (Ptr<DatpMessageStore> messageStore)
 {
-  NS_LOG_FUNCTION (this << &queryResponse);
-  m_queryResponse = queryResponse;
+  NS_LOG_FUNCTION (this << messageStore);
+  m_messageStore = messageStore;
 }
 
 void 
@@ -59,12 +59,42 @@ DatpScheduler::SetPacketEjectCallback (Callback<void, Ptr<Packet> > ejectPacket)
   m_ejectPacket = ejectPacket;
 }
 
-void 
-DatpScheduler::NotifyQueryResponse (DatpHeader datpHeader, Ptr<Packet> packet)
+void
+DatpScheduler::SetReduceCallback (Callback<void, uint32_t> reduce)
 {
-  NS_LOG_FUNCTION (this);
-  if (!m_queryResponse.IsNull ())
-    m_queryResponse (datpHeader, packet);
+  NS_LOG_FUNCTION (this << &reduce);
+  m_reduce = reduce;
+}
+
+void
+DatpScheduler::SetHeaderContext (Ptr<DatpHeaderContext> headerContext)
+{
+  NS_LOG_FUNCTION (this << headerContext);
+  m_headerContext = headerContext;
+}
+
+uint32_t
+DatpScheduler::FindMergePartner (uint64_t mergeKey) const
+{
+  NS_LOG_FUNCTION (this << mergeKey);
+  std::map<uint64_t,uint32_t>::const_iterator it = m_mergeIndex.find (mergeKey);
+  return it == m_mergeIndex.end () ? 0 : it->second;
+}
+
+void
+DatpScheduler::IndexMessage (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  m_mergeIndex[m_messageStore->GetMergeKey (handle)] = handle;
+}
+
+void
+DatpScheduler::UnindexMessage (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  std::map<uint64_t,uint32_t>::iterator it = m_mergeIndex.find (m_messageStore->GetMergeKey (handle));
+  if (it != m_mergeIndex.end () && it->second == handle)
+    m_mergeIndex.erase (it);
 }
 
 void
@@ -75,5 +105,13 @@ DatpScheduler::NotifyPacketEject (Ptr<Packet> packet)
     m_ejectPacket (packet);
 }
 
+void
+DatpScheduler::NotifyReduce (uint32_t handle)
+{
+  NS_LOG_FUNCTION (this << handle);
+  if (!m_reduce.IsNull ())
+    m_reduce (handle);
+}
+
 } // namespace ns3
 
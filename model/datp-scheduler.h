@@ -22,6 +22,8 @@
 #define __DATP_SCHEDULER_H__
 
 #include "datp-headers.h"
+#include "datp-header-context.h"
+#include "datp-message.h"
 #include "ns3/packet.h"
 #include "ns3/callback.h"
 #include "ns3/object.h"
@@ -38,26 +40,35 @@ public:
   DatpScheduler ();
   virtual ~DatpScheduler ();
 
-  virtual void ReceiveQuery (DatpHeader datpHeader) = 0;
-  virtual void ReceiveNewMessage (DatpHeader datpHeader, Ptr<Packet> packet) = 0;
-  virtual void ReceiveExistingMessage (DatpHeader datpHeader, Ptr<Packet> packet) = 0;
+  virtual void ReceiveNewMessage (uint32_t handle) = 0;
+  virtual void ReceiveExistingMessage (uint32_t handle) = 0;
   
-  void SetQueryResponseCallback (Callback<void, DatpHeader, Ptr<Packet> > queryResponse);
+  void SetMessageStore (Ptr<DatpMessageStore> messageStore);
   void SetPacketEjectCallback (Callback<void, Ptr<Packet> > ejectPacket);
+  void SetReduceCallback (Callback<void, uint32_t> reduce);
+  /// Buffered message with the given merge key, 0 if there is none
+  uint32_t FindMergePartner (uint64_t mergeKey) const;
+  /// Link contexts used to compress the static fields of ejected messages
+  void SetHeaderContext (Ptr<DatpHeaderContext> headerContext);
 
 protected:
 
-  void NotifyQueryResponse (DatpHeader datpHeader, Ptr<Packet> packet);
   void NotifyPacketEject (Ptr<Packet> packet);
+  void NotifyReduce (uint32_t handle);
+  /// Make a newly buffered message the merge partner for its key
+  void IndexMessage (uint32_t handle);
+  /// Forget a message leaving the buffer, call before removing it from the store
+  void UnindexMessage (uint32_t handle);
 
-  std::map<uint32_t,Ptr<Packet> > m_messageBuffer;
-  std::map<uint32_t,Timer> m_timerBuffer;
-  std::map<uint32_t,DatpHeader> m_headerBuffer;
+  Ptr<DatpMessageStore> m_messageStore;
+  std::map<uint32_t,Timer> m_timerBuffer;   //buffered messages by handle
+  Ptr<DatpHeaderContext> m_headerContext;
+  std::map<uint64_t,uint32_t> m_mergeIndex;   //buffered message by merge key
   
 private:
 
-  Callback<void, DatpHeader, Ptr<Packet> > m_queryResponse;
   Callback<void, Ptr<Packet> > m_ejectPacket;
+  Callback<void, uint32_t> m_reduce;
 
 };
 
@@ -1,7 +1,14 @@
 /* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
 
 // Include a header file from your module to test.
-#include "ns3/datp.h"
+#include "ns3/datp-module.h"
+#include "ns3/boolean.h"
+#include "ns3/uinteger.h"
+#include "ns3/simulator.h"
+#include "ns3/node.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/inet-socket-address.h"
 
 // An essential include is test.h
 #include "ns3/test.h"
@@ -46,6 +53,1853 @@ DatpTestCase1::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
 }
 
+class DatpHeaderViewTestCase : public TestCase
+{
+public:
+  DatpHeaderViewTestCase ();
+  virtual ~DatpHeaderViewTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DatpHeaderViewTestCase::DatpHeaderViewTestCase ()
+  : TestCase ("Datp header view walks concatenated messages")
+{
+}
+
+DatpHeaderViewTestCase::~DatpHeaderViewTestCase ()
+{
+}
+
+void
+DatpHeaderViewTestCase::DoRun (void)
+{
+  DatpHeader first;
+  first.SetApplication (1);
+  first.SetTimestamp (12345);
+  first.SetDataLength (8);
+  Ptr<Packet> packet = Create<Packet> (8);
+  packet->AddHeader (first);
+
+  DatpHeader second;
+  second.SetOrigin (7);
+  second.SetApplication (3);
+  second.SetPriority (2);
+  second.SetDataLength (4);
+  second.SetSequence (99);
+  Ptr<Packet> secondPacket = Create<Packet> (0);
+  DatpGenericApplicationDataHeader value;
+  value.SetValue (5);
+  secondPacket->AddHeader (value);
+  secondPacket->AddHeader (second);
+  packet->AddAtEnd (secondPacket);
+
+  DatpHeaderView view (packet);
+  NS_TEST_ASSERT_MSG_EQ (view.IsValid (), true, "packet should parse");
+  NS_TEST_ASSERT_MSG_EQ (view.GetNMessages (), 2, "two messages were concatenated");
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (0).application, 1, "wrong application");
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (0).timestamp, 12345, "wrong timestamp");
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (0).headerSize, first.GetInternalHeaderSize (), "wrong header size");
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (1).offset, first.GetInternalHeaderSize () + 8u, "wrong offset");
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (1).origin, 7, "wrong origin");
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (1).sequence, 99, "wrong sequence");
+  NS_TEST_ASSERT_MSG_EQ (view.ReadPayloadU32 (1, 0), 5, "wrong payload value");
+  NS_TEST_ASSERT_MSG_EQ (view.GetPayload (1)->GetSize (), 4, "wrong payload span");
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), first.GetInternalHeaderSize () + 8u + second.GetInternalHeaderSize () + 4u, "view must not modify the packet");
+
+  packet->RemoveAtEnd (2);
+  NS_TEST_ASSERT_MSG_EQ (view.Parse (packet), false, "truncated packet should not parse");
+}
+
+class DatpHeaderLayoutTestCase : public TestCase
+{
+public:
+  DatpHeaderLayoutTestCase ();
+  virtual ~DatpHeaderLayoutTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DatpHeaderLayoutTestCase::DatpHeaderLayoutTestCase ()
+  : TestCase ("Datp header round trips every field combination")
+{
+}
+
+DatpHeaderLayoutTestCase::~DatpHeaderLayoutTestCase ()
+{
+}
+
+void
+DatpHeaderLayoutTestCase::DoRun (void)
+{
+  for (uint32_t flags = 0; flags < 64; ++flags)
+    {
+      DatpHeader datpHeader;
+      uint32_t size = 1;
+      if (flags&32)
+        {
+          datpHeader.SetOrigin (0x01020304);
+          size += 4;
+        }
+      if (flags&16)
+        {
+          datpHeader.SetApplication (5);
+          size += 1;
+        }
+      if (flags&8)
+        {
+          datpHeader.SetPriority (6);
+          size += 1;
+        }
+      if (flags&4)
+        {
+          datpHeader.SetTimestamp (0x0708090a0b0c0d0eULL);
+          size += 8;
+        }
+      if (flags&2)
+        {
+          datpHeader.SetDataLength (0);
+          size += 1;
+        }
+      if (flags&1)
+        {
+          datpHeader.SetSequence (0x0f101112);
+          size += 4;
+        }
+      NS_TEST_ASSERT_MSG_EQ ((uint32_t) datpHeader.GetInternalHeaderSize (), size, "wrong size for flags " << flags);
+
+      Ptr<Packet> packet = Create<Packet> (0);
+      packet->AddHeader (datpHeader);
+      NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), size, "wrong serialized size for flags " << flags);
+
+      DatpHeader copy;
+      packet->RemoveHeader (copy);
+      NS_TEST_ASSERT_MSG_EQ (copy.GetHeaderFieldFlags (), datpHeader.GetHeaderFieldFlags (), "wrong HFF");
+      NS_TEST_ASSERT_MSG_EQ (copy.GetOrigin (), datpHeader.GetOrigin (), "wrong origin");
+      NS_TEST_ASSERT_MSG_EQ (copy.GetApplication (), datpHeader.GetApplication (), "wrong application");
+      NS_TEST_ASSERT_MSG_EQ (copy.GetPriority (), datpHeader.GetPriority (), "wrong priority");
+      NS_TEST_ASSERT_MSG_EQ (copy.GetTimestamp (), datpHeader.GetTimestamp (), "wrong timestamp");
+      NS_TEST_ASSERT_MSG_EQ (copy.GetSequence (), datpHeader.GetSequence (), "wrong sequence");
+    }
+}
+
+class DatpHeaderSizeModifiersTestCase : public TestCase
+{
+public:
+  DatpHeaderSizeModifiersTestCase ();
+  virtual ~DatpHeaderSizeModifiersTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DatpHeaderSizeModifiersTestCase::DatpHeaderSizeModifiersTestCase ()
+  : TestCase ("Datp header chains HFF2 for varint length, timestamp and sequence")
+{
+}
+
+DatpHeaderSizeModifiersTestCase::~DatpHeaderSizeModifiersTestCase ()
+{
+}
+
+void
+DatpHeaderSizeModifiersTestCase::DoRun (void)
+{
+  //a typical reading: 10s timestamp fits a 5 byte varint, saving 2 bytes
+  DatpHeader reading;
+  reading.SetApplication (1);
+  reading.SetPriority (0);
+  reading.SetTimestamp (Seconds (10.0).GetNanoSeconds ());
+  reading.SetDataLength (20);
+  NS_TEST_ASSERT_MSG_EQ (reading.GetSizeModifiers (), DATP_HFF2_VARINT_TIMESTAMP, "timestamp should be a varint");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t) reading.GetInternalHeaderSize (), 10, "reading header should shrink from 12 bytes");
+
+  //a length over 255 has to use the varint form
+  DatpHeader large;
+  large.SetDataLength (1476);
+  large.SetSequence (3);
+  NS_TEST_ASSERT_MSG_EQ (large.GetSizeModifiers (), DATP_HFF2_VARINT_LENGTH | DATP_HFF2_VARINT_SEQUENCE, "wrong size modifiers");
+  Ptr<Packet> packet = Create<Packet> (1476);
+  packet->AddHeader (large);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), 1476 + 1 + 1 + 2 + 1, "wrong chained header size");
+
+  DatpHeaderView view (packet);
+  NS_TEST_ASSERT_MSG_EQ (view.IsValid (), true, "packet should parse");
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (0).dataLength, 1476, "wrong view length");
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (0).sequence, 3, "wrong view sequence");
+
+  DatpHeader copy;
+  packet->RemoveHeader (copy);
+  NS_TEST_ASSERT_MSG_EQ (copy.GetDataLength (), 1476, "length was truncated");
+  NS_TEST_ASSERT_MSG_EQ (copy.GetSequence (), 3, "wrong sequence");
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), 1476, "header not fully removed");
+
+  //a count of zero, a length past 32 bits and a runaway HFF chain
+  const uint8_t zeroCount[3] = { 128 | DATP_HFF_CHAIN, DATP_HFF2_COUNT, 0 };
+  const uint8_t longLength[7] = { 128 | 4 | DATP_HFF_CHAIN, DATP_HFF2_VARINT_LENGTH, 0x80, 0x80, 0x80, 0x80, 0x10 };
+  const uint8_t longChain[8] = { 128 | DATP_HFF_CHAIN, DATP_HFF_CHAIN, DATP_HFF_CHAIN, DATP_HFF_CHAIN, DATP_HFF_CHAIN, DATP_HFF_CHAIN, DATP_HFF_CHAIN, 0 };
+  NS_TEST_ASSERT_MSG_EQ (view.Parse (Create<Packet> (zeroCount, 3)), false, "a zero count should be rejected");
+  NS_TEST_ASSERT_MSG_EQ (view.Parse (Create<Packet> (longLength, 7)), false, "a length over 32 bits should be rejected");
+  NS_TEST_ASSERT_MSG_EQ (view.Parse (Create<Packet> (longChain, 8)), false, "a long HFF chain should be rejected");
+  NS_TEST_ASSERT_MSG_EQ (Create<Packet> (zeroCount, 3)->PeekHeader (copy), 0, "a zero count should not deserialize");
+  NS_TEST_ASSERT_MSG_EQ (Create<Packet> (longLength, 7)->PeekHeader (copy), 0, "a length over 32 bits should not deserialize");
+  NS_TEST_ASSERT_MSG_EQ (Create<Packet> (longChain, 8)->PeekHeader (copy), 0, "a long HFF chain should not deserialize");
+}
+
+class DatpHeaderBundleTestCase : public TestCase
+{
+public:
+  DatpHeaderBundleTestCase ();
+  virtual ~DatpHeaderBundleTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DatpHeaderBundleTestCase::DatpHeaderBundleTestCase ()
+  : TestCase ("Datp header view expands bundle members")
+{
+}
+
+DatpHeaderBundleTestCase::~DatpHeaderBundleTestCase ()
+{
+}
+
+void
+DatpHeaderBundleTestCase::DoRun (void)
+{
+  DatpHeader first;
+  first.SetApplication (1);
+  first.SetPriority (0);
+  first.SetTimestamp (Seconds (10.0).GetNanoSeconds ());
+  first.SetDataLength (4);
+  Ptr<Packet> packet = Create<Packet> (4);
+  packet->AddHeader (first);
+
+  DatpHeader second;
+  second.SetApplication (1);
+  second.SetPriority (2);
+  second.SetTimestamp (Seconds (10.0).GetNanoSeconds () - 300);
+  second.SetDataLength (8);
+  DatpHeader member = second;
+  NS_TEST_ASSERT_MSG_EQ (member.MakeBundleMember (first, first), true, "second message should bundle");
+  NS_TEST_ASSERT_MSG_LT (member.GetInternalHeaderSize (), second.GetInternalHeaderSize (), "bundle member should be smaller");
+  Ptr<Packet> secondPacket = Create<Packet> (8);
+  secondPacket->AddHeader (member);
+  packet->AddAtEnd (secondPacket);
+
+  DatpHeader unrelated;
+  unrelated.SetDataLength (0);
+  NS_TEST_ASSERT_MSG_EQ (unrelated.MakeBundleMember (first, second), false, "fields of previous cannot be left out");
+
+  DatpHeaderView view (packet);
+  NS_TEST_ASSERT_MSG_EQ (view.IsValid (), true, "packet should parse");
+  NS_TEST_ASSERT_MSG_EQ (view.GetNMessages (), 2, "two messages were bundled");
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (1).application, 1, "application should be inherited");
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (1).priority, 2, "priority changed");
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (1).timestamp, second.GetTimestamp (), "timestamp delta not applied");
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (1).dataLength, 8, "wrong length");
+}
+
+class DatpHeaderContextTestCase : public TestCase
+{
+public:
+  DatpHeaderContextTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DatpHeaderContextTestCase::DatpHeaderContextTestCase ()
+  : TestCase ("Datp link contexts replace the static fields")
+{
+}
+
+void
+DatpHeaderContextTestCase::DoRun (void)
+{
+  Ptr<DatpHeaderContext> sender = CreateObject<DatpHeaderContext> ();
+  Ptr<DatpHeaderContext> receiver = CreateObject<DatpHeaderContext> ();
+  Address child = Ipv4Address ("10.1.1.2");
+  DatpHeaderView view;
+
+  for (uint32_t i = 0; i < 2; ++i)
+    {
+      DatpHeader datpHeader;
+      datpHeader.SetOrigin (7);
+      datpHeader.SetApplication (1);
+      datpHeader.SetPriority (2);
+      datpHeader.SetTimestamp (Seconds (10.0).GetNanoSeconds () + i);
+      datpHeader.SetDataLength (4);
+      DatpHeader wire = datpHeader;
+      sender->Compress (wire);
+      if (i == 0)
+        NS_TEST_ASSERT_MSG_EQ ((wire.GetContext () & DATP_CONTEXT_ESTABLISH), DATP_CONTEXT_ESTABLISH, "first use should establish the context");
+      else
+        NS_TEST_ASSERT_MSG_LT (wire.GetInternalHeaderSize (), datpHeader.GetInternalHeaderSize (), "context member should be smaller");
+      Ptr<Packet> packet = Create<Packet> (4);
+      packet->AddHeader (wire);
+
+      view.Parse (packet, receiver, child);
+      NS_TEST_ASSERT_MSG_EQ (view.GetNMessages (), 1, "message should be expanded");
+      NS_TEST_ASSERT_MSG_EQ (view.GetMessage (0).origin, 7, "origin not taken from the context");
+      NS_TEST_ASSERT_MSG_EQ (view.GetMessage (0).application, 1, "application not taken from the context");
+      NS_TEST_ASSERT_MSG_EQ (view.GetMessage (0).priority, 2, "priority not taken from the context");
+
+      //another sender never established the context
+      view.Parse (packet, receiver, Ipv4Address ("10.1.1.3"));
+      NS_TEST_ASSERT_MSG_EQ (view.GetNMessages (), (i == 0) ? 1 : 0, "unknown context should be dropped");
+    }
+}
+
+class DatpFrameHeaderTestCase : public TestCase
+{
+public:
+  DatpFrameHeaderTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DatpFrameHeaderTestCase::DatpFrameHeaderTestCase ()
+  : TestCase ("Datp frame header indexes the messages of a packet")
+{
+}
+
+void
+DatpFrameHeaderTestCase::DoRun (void)
+{
+  Ptr<Packet> packet = Create<Packet> (0);
+  DatpFrameHeader frameHeader;
+  for (uint32_t i = 0; i < 3; ++i)
+    {
+      DatpHeader datpHeader;
+      datpHeader.SetApplication (i);
+      datpHeader.SetPriority (i);
+      datpHeader.SetDataLength (4 * (i + 1));
+      Ptr<Packet> message = Create<Packet> (4 * (i + 1));
+      message->AddHeader (datpHeader);
+      frameHeader.AddMessage (message->GetSize ());
+      packet->AddAtEnd (message);
+    }
+  packet->AddHeader (frameHeader);
+
+  DatpHeaderView view;
+  NS_TEST_ASSERT_MSG_EQ (view.ParseFrame (packet), true, "frame header should parse");
+  NS_TEST_ASSERT_MSG_EQ (view.GetFrameNMessages (), 3, "wrong message count");
+  DatpMessageDescriptor descriptor;
+  NS_TEST_ASSERT_MSG_EQ (view.DecodeFramed (2, descriptor), true, "last message should decode alone");
+  NS_TEST_ASSERT_MSG_EQ (descriptor.priority, 2, "wrong message decoded");
+  NS_TEST_ASSERT_MSG_EQ (descriptor.dataLength, 12, "wrong length");
+
+  NS_TEST_ASSERT_MSG_EQ (view.Parse (packet), true, "framed packet should parse");
+  NS_TEST_ASSERT_MSG_EQ (view.GetNMessages (), 3, "wrong message count");
+  packet->RemoveAtEnd (1);
+  NS_TEST_ASSERT_MSG_EQ (view.Parse (packet), false, "truncated packet no longer matches its frame header");
+}
+
+class DatpPacketBuilderTestCase : public TestCase
+{
+public:
+  DatpPacketBuilderTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DatpPacketBuilderTestCase::DatpPacketBuilderTestCase ()
+  : TestCase ("Datp packet builder writes the size it announces")
+{
+}
+
+void
+DatpPacketBuilderTestCase::DoRun (void)
+{
+  DatpPacketBuilder packetBuilder;
+  packetBuilder.SetBundleHeaders (true);
+  packetBuilder.SetFrameHeader (true);
+  for (uint32_t i = 0; i < 4; ++i)
+    {
+      DatpHeader datpHeader;
+      datpHeader.SetApplication (1);
+      datpHeader.SetTimestamp (Seconds (10.0).GetNanoSeconds () + i);
+      datpHeader.SetDataLength (4);
+      packetBuilder.AddMessage (datpHeader, Create<Packet> (4));
+    }
+  uint32_t size = packetBuilder.GetSize ();
+  Ptr<Packet> packet = packetBuilder.Build ();
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), size, "built packet does not have the announced size");
+  NS_TEST_ASSERT_MSG_EQ (packetBuilder.GetNMessages (), 0, "builder should be cleared");
+
+  DatpHeaderView view;
+  NS_TEST_ASSERT_MSG_EQ (view.Parse (packet), true, "built packet should parse");
+  NS_TEST_ASSERT_MSG_EQ (view.GetNMessages (), 4, "wrong message count");
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (3).timestamp, (uint64_t) Seconds (10.0).GetNanoSeconds () + 3, "wrong timestamp");
+}
+
+/**
+ * Store a message of datpHeader carrying payload as a receiver does, through
+ * a DatpHeaderView of the wire packet, \returns its handle
+ */
+static uint32_t
+StoreMessage (Ptr<DatpMessageStore> messageStore, DatpHeader datpHeader, Ptr<Packet> payload,
+              Time receiveTime = Seconds (0.0), uint32_t sender = 0)
+{
+  Ptr<Packet> packet = payload->Copy ();
+  datpHeader.SetDataLength (packet->GetSize ());
+  packet->AddHeader (datpHeader);
+  DatpHeaderView view (packet);
+  return messageStore->Add (view.GetMessage (0), view.GetPayload (0), receiveTime, sender);
+}
+
+class DatpMessageStoreTestCase : public TestCase
+{
+public:
+  DatpMessageStoreTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DatpMessageStoreTestCase::DatpMessageStoreTestCase ()
+  : TestCase ("Datp message store keeps messages by handle")
+{
+}
+
+void
+DatpMessageStoreTestCase::DoRun (void)
+{
+  DatpHeader datpHeader;
+  datpHeader.SetApplication (3);
+  datpHeader.SetTimestamp (Seconds (10.0).GetNanoSeconds ());
+  Ptr<DatpMessageStore> messageStore = CreateObject<DatpMessageStore> ();
+  uint32_t handle = StoreMessage (messageStore, datpHeader, Create<Packet> (8), Seconds (1.0));
+  NS_TEST_ASSERT_MSG_NE (handle, 0, "zero is not a handle");
+  NS_TEST_ASSERT_MSG_EQ (messageStore->Get (handle).application, 3, "wrong application");
+
+  //the wire header follows the payload of the stored message
+  messageStore->Get (handle).payload = Create<Packet> (4);
+  DatpHeader wire = messageStore->GetHeader (handle);
+  NS_TEST_ASSERT_MSG_EQ (wire.GetApplication (), 3, "wrong application");
+  NS_TEST_ASSERT_MSG_EQ (wire.GetTimestamp (), datpHeader.GetTimestamp (), "wrong timestamp");
+  NS_TEST_ASSERT_MSG_EQ (wire.GetDataLength (), 4, "length should follow the payload");
+
+  messageStore->Remove (handle);
+  NS_TEST_ASSERT_MSG_EQ (messageStore->Contains (handle), false, "message should be gone");
+}
+
+class DatpMergeKernelTestCase : public TestCase
+{
+public:
+  DatpMergeKernelTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DatpMergeKernelTestCase::DatpMergeKernelTestCase ()
+  : TestCase ("Datp merge kernel matches its scalar version")
+{
+}
+
+void
+DatpMergeKernelTestCase::DoRun (void)
+{
+  //odd length so both the vector loop and the scalar tail run
+  uint32_t a[11], b[11], vector[11], scalar[11];
+  for (uint32_t i = 0; i < 11; ++i)
+    {
+      a[i] = DatpMergeKernel::HostToNetwork ((i % 3) ? 1000 * i : 0);
+      b[i] = DatpMergeKernel::HostToNetwork ((i % 4) ? i : 0);
+    }
+  DatpMergeKernel::MergeGeneric (vector, a, b, 11);
+  DatpMergeKernel::MergeGenericScalar (scalar, a, b, 11);
+  for (uint32_t i = 0; i < 11; ++i)
+    NS_TEST_ASSERT_MSG_EQ (vector[i], scalar[i], "kernels differ at word " << i);
+  NS_TEST_ASSERT_MSG_EQ (DatpMergeKernel::NetworkToHost (vector[0]), 2, "two zero readings count two messages");
+  NS_TEST_ASSERT_MSG_EQ (DatpMergeKernel::NetworkToHost (vector[4]), 4001, "zero reading counts one message");
+  NS_TEST_ASSERT_MSG_EQ (DatpMergeKernel::NetworkToHost (vector[5]), 5005, "readings should add up");
+}
+
+/**
+ * Shared fixture of the function test cases, standing in for the scheduler
+ * a DatpFunction reports to.  By default every message merges into the last
+ * one forwarded as new.
+ */
+class DatpFunctionTestCase : public TestCase
+{
+public:
+  DatpFunctionTestCase (std::string name);
+
+protected:
+  /// Report the messages of function to this fixture and reset it
+  void Connect (Ptr<DatpFunction> function);
+  /// Payload of a single reading, as the applications send it
+  static Ptr<Packet> CreateReading (uint32_t value);
+  virtual uint32_t Lookup (uint64_t mergeKey);
+  virtual void NewMessage (uint32_t handle);
+  virtual void ExistingMessage (uint32_t handle);
+
+  uint32_t m_buffered;  //!< last message forwarded as new, 0 if none
+  uint32_t m_new;       //!< messages forwarded as new
+  uint32_t m_existing;  //!< updates of buffered messages
+};
+
+DatpFunctionTestCase::DatpFunctionTestCase (std::string name)
+  : TestCase (name),
+    m_buffered (0),
+    m_new (0),
+    m_existing (0)
+{
+}
+
+void
+DatpFunctionTestCase::Connect (Ptr<DatpFunction> function)
+{
+  function->SetMergeLookupCallback (MakeCallback (&DatpFunctionTestCase::Lookup, this));
+  function->SetNewMessageCallback (MakeCallback (&DatpFunctionTestCase::NewMessage, this));
+  function->SetExistingMessageCallback (MakeCallback (&DatpFunctionTestCase::ExistingMessage, this));
+  m_buffered = 0;
+  m_new = 0;
+  m_existing = 0;
+}
+
+Ptr<Packet>
+DatpFunctionTestCase::CreateReading (uint32_t value)
+{
+  Ptr<Packet> payload = Create<Packet> ();
+  DatpGenericApplicationDataHeader reading;
+  reading.SetValue (value);
+  payload->AddHeader (reading);
+  return payload;
+}
+
+uint32_t
+DatpFunctionTestCase::Lookup (uint64_t mergeKey)
+{
+  return m_buffered;
+}
+
+void
+DatpFunctionTestCase::NewMessage (uint32_t handle)
+{
+  m_buffered = handle;
+  ++m_new;
+}
+
+void
+DatpFunctionTestCase::ExistingMessage (uint32_t handle)
+{
+  ++m_existing;
+}
+
+class DatpLazyMergeTestCase : public DatpFunctionTestCase
+{
+public:
+  DatpLazyMergeTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Run (bool lazy, Ptr<Packet> &payload, uint64_t &timestamp);
+  virtual void ExistingMessage (uint32_t handle);
+
+  Ptr<DatpFunction> m_function;
+};
+
+DatpLazyMergeTestCase::DatpLazyMergeTestCase ()
+  : DatpFunctionTestCase ("Datp lazy merge reduces to the same message as merging eagerly")
+{
+}
+
+void
+DatpLazyMergeTestCase::ExistingMessage (uint32_t handle)
+{
+  NS_TEST_ASSERT_MSG_EQ (handle, m_buffered, "merged into the wrong message");
+}
+
+void
+DatpLazyMergeTestCase::Run (bool lazy, Ptr<Packet> &payload, uint64_t &timestamp)
+{
+  Ptr<DatpMessageStore> messageStore = CreateObject<DatpMessageStore> ();
+  m_function = CreateObjectWithAttributes<DatpFunctionSimple> ("LazyMerge", BooleanValue (lazy));
+  m_function->SetMessageStore (messageStore);
+  Connect (m_function);
+
+  for (uint32_t m = 0; m < 5; ++m)
+    {
+      Ptr<Packet> packet = Create<Packet> ();
+      for (uint32_t w = 0; w < 6; ++w)
+        {
+          DatpGenericApplicationDataHeader value;
+          value.SetValue ((m * 3 + w) % 4);
+          packet->AddHeader (value);
+        }
+      DatpHeader datpHeader;
+      datpHeader.SetApplication (1);
+      datpHeader.SetTimestamp (Seconds (10.0 + m).GetNanoSeconds ());
+      m_function->ReceiveNewMessage (StoreMessage (messageStore, datpHeader, packet, Seconds (m)));
+    }
+  NS_TEST_ASSERT_MSG_EQ (messageStore->GetNMessages (), lazy ? 5 : 1, "lazy merge should keep the messages until reduced");
+
+  m_function->Reduce (m_buffered);
+  NS_TEST_ASSERT_MSG_EQ (messageStore->GetNMessages (), 1, "reduce should leave one message");
+  payload = messageStore->Get (m_buffered).payload;
+  timestamp = messageStore->Get (m_buffered).timestamp;
+}
+
+void
+DatpLazyMergeTestCase::DoRun (void)
+{
+  Ptr<Packet> eager;
+  Ptr<Packet> lazy;
+  uint64_t eagerTimestamp;
+  uint64_t lazyTimestamp;
+  Run (false, eager, eagerTimestamp);
+  Run (true, lazy, lazyTimestamp);
+
+  NS_TEST_ASSERT_MSG_EQ (lazy->GetSize (), eager->GetSize (), "payload sizes differ");
+  uint8_t a[24];
+  uint8_t b[24];
+  eager->CopyData (a, sizeof (a));
+  lazy->CopyData (b, sizeof (b));
+  for (uint32_t i = 0; i < sizeof (a); ++i)
+    NS_TEST_ASSERT_MSG_EQ ((uint32_t) b[i], (uint32_t) a[i], "payload byte " << i << " differs");
+  NS_TEST_ASSERT_MSG_EQ (lazyTimestamp, eagerTimestamp, "timestamps differ");
+}
+
+class DatpMergeIndexTestCase : public TestCase
+{
+public:
+  DatpMergeIndexTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Eject (Ptr<Packet> packet);
+
+  uint32_t m_ejected;
+};
+
+DatpMergeIndexTestCase::DatpMergeIndexTestCase ()
+  : TestCase ("Datp scheduler indexes buffered messages by merge key")
+{
+}
+
+void
+DatpMergeIndexTestCase::Eject (Ptr<Packet> packet)
+{
+  m_ejected += DatpHeaderView (packet).GetNMessages ();
+}
+
+void
+DatpMergeIndexTestCase::DoRun (void)
+{
+  Ptr<DatpMessageStore> messageStore = CreateObject<DatpMessageStore> ();
+  Ptr<DatpScheduler> scheduler = CreateObject<DatpSchedulerSimple> ();
+  scheduler->SetMessageStore (messageStore);
+  scheduler->SetPacketEjectCallback (MakeCallback (&DatpMergeIndexTestCase::Eject, this));
+  m_ejected = 0;
+
+  uint32_t handles[3];
+  for (uint32_t m = 0; m < 3; ++m)
+    {
+      DatpHeader datpHeader;
+      datpHeader.SetApplication (m + 1);
+      handles[m] = StoreMessage (messageStore, datpHeader, Create<Packet> (4));
+      scheduler->ReceiveNewMessage (handles[m]);
+    }
+  for (uint32_t m = 0; m < 3; ++m)
+    NS_TEST_ASSERT_MSG_EQ (scheduler->FindMergePartner (messageStore->GetMergeKey (handles[m])), handles[m], "wrong merge partner");
+  NS_TEST_ASSERT_MSG_EQ (scheduler->FindMergePartner (9), 0, "no message has merge key 9");
+
+  //ejected messages leave the index
+  Simulator::Run ();
+  Simulator::Destroy ();
+  NS_TEST_ASSERT_MSG_EQ (m_ejected, 3, "all messages should be ejected");
+  for (uint32_t m = 0; m < 3; ++m)
+    NS_TEST_ASSERT_MSG_EQ (scheduler->FindMergePartner (m + 1), 0, "ejected message still indexed");
+}
+
+class DatpFunctionTypedTestCase : public DatpFunctionTestCase
+{
+public:
+  DatpFunctionTypedTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /// Feed readings 10, 4, 30 and 8 to function, \returns the reduced message
+  DatpHeader Run (Ptr<DatpFunction> function, uint32_t &value);
+};
+
+DatpFunctionTypedTestCase::DatpFunctionTypedTestCase ()
+  : DatpFunctionTestCase ("Datp typed functions reduce readings and count them")
+{
+}
+
+DatpHeader
+DatpFunctionTypedTestCase::Run (Ptr<DatpFunction> function, uint32_t &value)
+{
+  Ptr<DatpMessageStore> messageStore = CreateObject<DatpMessageStore> ();
+  function->SetMessageStore (messageStore);
+  Connect (function);
+
+  uint32_t readings[4] = { 10, 4, 30, 8 };
+  for (uint32_t m = 0; m < 4; ++m)
+    {
+      DatpHeader datpHeader;
+      datpHeader.SetApplication (1);
+      datpHeader.SetTimestamp (1000 + m * 100);
+      function->ReceiveNewMessage (StoreMessage (messageStore, datpHeader, CreateReading (readings[m]), Seconds (m)));
+    }
+  NS_TEST_ASSERT_MSG_EQ (messageStore->GetNMessages (), 1, "messages should be reduced into one");
+
+  //the count travels in the header
+  Ptr<Packet> packet = messageStore->Get (m_buffered).payload->Copy ();
+  packet->AddHeader (messageStore->GetHeader (m_buffered));
+  DatpHeaderView view (packet);
+  NS_TEST_ASSERT_MSG_EQ (view.GetNMessages (), 1, "reduced message should parse");
+  value = view.ReadPayloadU32 (0, 0);
+  return view.GetHeader (0);
+}
+
+void
+DatpFunctionTypedTestCase::DoRun (void)
+{
+  uint32_t value;
+  DatpHeader datpHeader = Run (CreateObject<DatpFunctionSum> (), value);
+  NS_TEST_ASSERT_MSG_EQ (value, 52, "wrong sum");
+  NS_TEST_ASSERT_MSG_EQ (datpHeader.GetCount (), 4, "wrong count");
+  NS_TEST_ASSERT_MSG_EQ (datpHeader.GetTimestamp (), 1150, "timestamp should be the mean");
+  Run (CreateObject<DatpFunctionMin> (), value);
+  NS_TEST_ASSERT_MSG_EQ (value, 4, "wrong minimum");
+  Run (CreateObject<DatpFunctionMax> (), value);
+  NS_TEST_ASSERT_MSG_EQ (value, 30, "wrong maximum");
+  Run (CreateObject<DatpFunctionMean> (), value);
+  NS_TEST_ASSERT_MSG_EQ (value, 13, "wrong mean");
+  datpHeader = Run (CreateObject<DatpFunctionLast> (), value);
+  NS_TEST_ASSERT_MSG_EQ (value, 8, "wrong last value");
+  NS_TEST_ASSERT_MSG_EQ (datpHeader.GetTimestamp (), 1300, "timestamp should be the latest");
+}
+
+class DatpFunctionSketchTestCase : public DatpFunctionTestCase
+{
+public:
+  DatpFunctionSketchTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /// Feed 500 messages of 10 readings to function, \returns the sketch they leave as
+  Ptr<Packet> Run (Ptr<DatpFunction> function, uint32_t modulo, uint32_t hot = 0);
+};
+
+DatpFunctionSketchTestCase::DatpFunctionSketchTestCase ()
+  : DatpFunctionTestCase ("Datp sketch functions keep a bounded summary of the readings")
+{
+}
+
+Ptr<Packet>
+DatpFunctionSketchTestCase::Run (Ptr<DatpFunction> function, uint32_t modulo, uint32_t hot)
+{
+  Ptr<DatpMessageStore> messageStore = CreateObject<DatpMessageStore> ();
+  function->SetMessageStore (messageStore);
+  Connect (function);
+
+  for (uint32_t m = 0; m < 500; ++m)
+    {
+      Ptr<Packet> packet = Create<Packet> ();
+      for (uint32_t r = 0; r < 10; ++r)
+        {
+          DatpGenericApplicationDataHeader reading;
+          //the first six readings of a message cycle through the hot values, if any
+          reading.SetValue (r < 6 && hot > 0 ? r % hot : (m * 10 + r) % modulo);
+          packet->AddHeader (reading);
+        }
+      DatpHeader datpHeader;
+      datpHeader.SetApplication (1);
+      function->ReceiveNewMessage (StoreMessage (messageStore, datpHeader, packet));
+    }
+  NS_TEST_ASSERT_MSG_EQ (messageStore->GetNMessages (), 1, "messages should be merged into one");
+  NS_TEST_ASSERT_MSG_EQ (messageStore->Get (m_buffered).count, 500, "wrong count");
+  //20000 bytes of readings went in
+  NS_TEST_ASSERT_MSG_LT (messageStore->Get (m_buffered).payload->GetSize (), 1024, "sketch should stay bounded");
+
+  Ptr<Packet> packet = messageStore->Get (m_buffered).payload->Copy ();
+  packet->AddHeader (messageStore->GetHeader (m_buffered));
+  DatpHeaderView view (packet);
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (0).sizeModifiers & DATP_HFF2_SKETCH, DATP_HFF2_SKETCH, "sketch flag should be sent");
+  return view.GetPayload (0);
+}
+
+void
+DatpFunctionSketchTestCase::DoRun (void)
+{
+  Ptr<Packet> sketch = Run (CreateObject<DatpFunctionHyperLogLog> (), 1000);
+  NS_TEST_ASSERT_MSG_EQ_TOL (DatpFunctionHyperLogLog::EstimateDistinct (sketch), 1000, 250, "wrong distinct count");
+  sketch = Run (CreateObject<DatpFunctionTDigest> (), 1000);
+  NS_TEST_ASSERT_MSG_EQ_TOL (DatpFunctionTDigest::EstimateQuantile (sketch, 0.5), 500, 50, "wrong median");
+  sketch = Run (CreateObject<DatpFunctionCountMin> (), 100);
+  NS_TEST_ASSERT_MSG_GT (DatpFunctionCountMin::EstimateCount (sketch, 7), 49, "Count-Min never counts low");
+  //5000 readings of 20 values, 0 to 2 the most frequent ones
+  sketch = Run (CreateObjectWithAttributes<DatpFunctionTopK> ("K", UintegerValue (8)), 20, 3);
+  std::vector<DatpFunctionTopK::Counter> counters;
+  DatpFunctionTopK::GetTopK (sketch, counters);
+  NS_TEST_ASSERT_MSG_EQ (counters.size (), 8, "top-k should keep K counters");
+  NS_TEST_ASSERT_MSG_LT (counters[0].reading, 3, "wrong most frequent reading");
+  NS_TEST_ASSERT_MSG_LT (counters[2].reading, 3, "wrong third most frequent reading");
+  NS_TEST_ASSERT_MSG_GT (counters[2].count, 1000, "top-k never counts low");
+}
+
+class DatpFunctionCompressTestCase : public DatpFunctionTestCase
+{
+public:
+  DatpFunctionCompressTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DatpFunctionCompressTestCase::DatpFunctionCompressTestCase ()
+  : DatpFunctionTestCase ("Datp compress function packs messages losslessly")
+{
+}
+
+void
+DatpFunctionCompressTestCase::DoRun (void)
+{
+  std::string text (200, 'a');
+  for (uint32_t i = 0; i < text.size (); i += 7)
+    text[i] = 'a' + i % 26;
+  std::vector<uint8_t> block;
+  std::vector<uint8_t> data;
+  DatpLzCodec codec;
+  codec.Compress ((const uint8_t *) text.data (), text.size (), "abcdefg", block);
+  NS_TEST_ASSERT_MSG_LT (block.size (), text.size (), "repetitive text should shrink");
+  NS_TEST_ASSERT_MSG_EQ (codec.Decompress (&block[0], block.size (), "abcdefg", text.size (), data), true, "block should decompress");
+  NS_TEST_ASSERT_MSG_EQ (std::string (data.begin (), data.end ()), text, "codec should be lossless");
+  NS_TEST_ASSERT_MSG_EQ (codec.Decompress (&block[0], block.size (), "abcdefg", text.size () + 1, data), false, "wrong size should be caught");
+  DatpLzCodec::SetDictionary (1, "abcdefg");
+  Simulator::Destroy ();
+  NS_TEST_ASSERT_MSG_EQ (DatpLzCodec::GetDictionary (1).empty (), true, "Simulator::Destroy should clear the dictionaries");
+
+  Ptr<DatpMessageStore> messageStore = CreateObject<DatpMessageStore> ();
+  Ptr<DatpFunctionCompress> function = CreateObject<DatpFunctionCompress> ();
+  function->SetMessageStore (messageStore);
+  Connect (function);
+  for (uint32_t m = 0; m < 20; ++m)
+    {
+      Ptr<Packet> packet = Create<Packet> ();
+      for (uint32_t r = 0; r < 4; ++r)
+        {
+          DatpGenericApplicationDataHeader reading;
+          reading.SetValue (1);
+          packet->AddHeader (reading);
+        }
+      DatpHeader datpHeader;
+      datpHeader.SetOrigin (m);
+      datpHeader.SetApplication (1);
+      datpHeader.SetTimestamp (Seconds (10.0).GetNanoSeconds () + m);
+      function->ReceiveNewMessage (StoreMessage (messageStore, datpHeader, packet));
+    }
+  function->Reduce (m_buffered);
+  NS_TEST_ASSERT_MSG_EQ (messageStore->GetNMessages (), 1, "messages should be packed into one");
+
+  Ptr<Packet> packet = messageStore->Get (m_buffered).payload->Copy ();
+  packet->AddHeader (messageStore->GetHeader (m_buffered));
+  DatpHeaderView view (packet);
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (0).encodingFlags, DATP_HFF3_COMPRESSED, "compressed flag should be sent");
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (0).count, 20, "count should be the packed messages");
+  NS_TEST_ASSERT_MSG_LT (view.GetMessage (0).dataLength, 20 * 16, "messages should shrink");
+
+  NS_TEST_ASSERT_MSG_EQ (DatpFunctionCompress::Unpack (codec, view.GetPayload (0), 1, data), true, "payload should unpack");
+  DatpHeaderView messages (Create<Packet> (&data[0], data.size ()));
+  NS_TEST_ASSERT_MSG_EQ (messages.GetNMessages (), 20, "every message should be inside");
+  NS_TEST_ASSERT_MSG_EQ (messages.GetMessage (19).origin, 19, "wrong origin");
+  NS_TEST_ASSERT_MSG_EQ (messages.GetMessage (19).timestamp, (uint64_t) Seconds (10.0).GetNanoSeconds () + 19, "wrong timestamp");
+  NS_TEST_ASSERT_MSG_EQ (messages.ReadPayloadU32 (19, 3), 1, "wrong reading");
+}
+
+class DatpDeadBandTestCase : public DatpFunctionTestCase
+{
+public:
+  DatpDeadBandTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DatpDeadBandTestCase::DatpDeadBandTestCase ()
+  : DatpFunctionTestCase ("Datp dead-band suppression only forwards changes and heartbeats")
+{
+}
+
+void
+DatpDeadBandTestCase::DoRun (void)
+{
+  Ptr<DatpMessageStore> messageStore = CreateObject<DatpMessageStore> ();
+  Ptr<DatpFunction> function = CreateObjectWithAttributes<DatpFunctionDeadBand> ("DeadBand", UintegerValue (5),
+                                                                                 "Heartbeat", TimeValue (Seconds (1.0)));
+  function->SetMessageStore (messageStore);
+  Connect (function);
+
+  //per origin 100, 106 and back to 100 are changes, the last reading is a heartbeat
+  uint32_t readings[16] = { 100, 103, 105, 106, 106, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100 };
+  for (uint32_t m = 0; m < 16; ++m)
+    {
+      for (uint32_t origin = 1; origin <= 2; ++origin)
+        {
+          DatpHeader datpHeader;
+          datpHeader.SetOrigin (origin);
+          datpHeader.SetApplication (1);
+          function->ReceiveNewMessage (StoreMessage (messageStore, datpHeader, CreateReading (readings[m]), MilliSeconds (100 * m)));
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (m_new, 8, "wrong messages forwarded");
+  NS_TEST_ASSERT_MSG_EQ (function->GetMessagesMerged (), 24, "wrong messages suppressed");
+  NS_TEST_ASSERT_MSG_EQ (messageStore->GetNMessages (), 8, "suppressed messages should leave the store");
+
+  //repeats without an origin and aggregates of the same reading are never suppressed
+  DatpHeader datpHeader;
+  datpHeader.SetApplication (1);
+  function->ReceiveNewMessage (StoreMessage (messageStore, datpHeader, CreateReading (100), Seconds (2.0)));
+  function->ReceiveNewMessage (StoreMessage (messageStore, datpHeader, CreateReading (100), Seconds (2.0)));
+  datpHeader.SetOrigin (1);
+  datpHeader.SetCount (3);
+  function->ReceiveNewMessage (StoreMessage (messageStore, datpHeader, CreateReading (100), Seconds (1.6)));
+  datpHeader.SetCount (1);
+  datpHeader.SetQuantized (true);
+  function->ReceiveNewMessage (StoreMessage (messageStore, datpHeader, CreateReading (100), Seconds (1.6)));
+  NS_TEST_ASSERT_MSG_EQ (m_new, 12, "unfiltered messages should all be forwarded");
+  NS_TEST_ASSERT_MSG_EQ (function->GetMessagesMerged (), 24, "unfiltered messages should not count as suppressed");
+
+  DatpDeadBand deadBand;
+  Ptr<Packet> payload = Create<Packet> (8);
+  NS_TEST_ASSERT_MSG_EQ (deadBand.Pass (1, 1, payload, Seconds (0.0)), true, "first reading should pass");
+  NS_TEST_ASSERT_MSG_EQ (deadBand.Pass (1, 1, payload, Seconds (0.0)), true, "without a heartbeat every reading should pass");
+}
+
+class DatpMergeKeyTestCase : public TestCase
+{
+public:
+  DatpMergeKeyTestCase ();
+
+private:
+  virtual void DoRun (void);
+  uint32_t AddMessage (Ptr<DatpMessageStore> messageStore, uint8_t priority, uint32_t origin, uint32_t sequence);
+};
+
+DatpMergeKeyTestCase::DatpMergeKeyTestCase ()
+  : TestCase ("Datp merge key only groups compatible messages")
+{
+}
+
+uint32_t
+DatpMergeKeyTestCase::AddMessage (Ptr<DatpMessageStore> messageStore, uint8_t priority, uint32_t origin, uint32_t sequence)
+{
+  DatpHeader datpHeader;
+  datpHeader.SetOrigin (origin);
+  datpHeader.SetApplication (1);
+  datpHeader.SetPriority (priority);
+  datpHeader.SetSequence (sequence);
+  return StoreMessage (messageStore, datpHeader, Create<Packet> (4));
+}
+
+void
+DatpMergeKeyTestCase::DoRun (void)
+{
+  Ptr<DatpMessageStore> messageStore = CreateObject<DatpMessageStore> ();
+  uint32_t a = AddMessage (messageStore, 0, 1, 0);
+  uint32_t b = AddMessage (messageStore, 1, 25, 300);
+  NS_TEST_ASSERT_MSG_EQ (messageStore->GetMergeKey (a), messageStore->GetMergeKey (b), "by default only the application counts");
+
+  messageStore = CreateObjectWithAttributes<DatpMessageStore> ("MergeOnPriority", BooleanValue (true),
+                                                              "OriginGroupSize", UintegerValue (10),
+                                                              "SequenceWindow", UintegerValue (100));
+  a = AddMessage (messageStore, 1, 11, 120);
+  b = AddMessage (messageStore, 1, 19, 199);
+  NS_TEST_ASSERT_MSG_EQ (messageStore->GetMergeKey (a), messageStore->GetMergeKey (b), "same group and window should merge");
+  b = AddMessage (messageStore, 0, 11, 120);
+  NS_TEST_ASSERT_MSG_NE (messageStore->GetMergeKey (a), messageStore->GetMergeKey (b), "priorities should stay apart");
+  b = AddMessage (messageStore, 1, 20, 120);
+  NS_TEST_ASSERT_MSG_NE (messageStore->GetMergeKey (a), messageStore->GetMergeKey (b), "origin groups should stay apart");
+  b = AddMessage (messageStore, 1, 11, 200);
+  NS_TEST_ASSERT_MSG_NE (messageStore->GetMergeKey (a), messageStore->GetMergeKey (b), "sequence windows should stay apart");
+}
+
+class DatpFunctionWindowTestCase : public DatpFunctionTestCase
+{
+public:
+  DatpFunctionWindowTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Send (uint64_t timestamp, uint32_t value);
+  virtual void NewMessage (uint32_t handle);
+
+  Ptr<DatpMessageStore> m_messageStore;
+  Ptr<DatpFunctionWindow> m_function;
+  std::vector<uint32_t> m_emitted;
+};
+
+DatpFunctionWindowTestCase::DatpFunctionWindowTestCase ()
+  : DatpFunctionTestCase ("Datp window function emits one aggregate per window and key")
+{
+}
+
+void
+DatpFunctionWindowTestCase::Send (uint64_t timestamp, uint32_t value)
+{
+  DatpHeader datpHeader;
+  datpHeader.SetApplication (1);
+  datpHeader.SetTimestamp (timestamp);
+  m_function->ReceiveNewMessage (StoreMessage (m_messageStore, datpHeader, CreateReading (value), Simulator::Now ()));
+}
+
+void
+DatpFunctionWindowTestCase::NewMessage (uint32_t handle)
+{
+  m_emitted.push_back (handle);
+}
+
+void
+DatpFunctionWindowTestCase::DoRun (void)
+{
+  m_messageStore = CreateObject<DatpMessageStore> ();
+  m_function = CreateObjectWithAttributes<DatpFunctionWindow> ("FunctionType", TypeIdValue (DatpFunctionSum::GetTypeId ()),
+                                                               "Size", TimeValue (Seconds (1.0)),
+                                                               "AllowedLateness", TimeValue (MilliSeconds (100)));
+  m_function->SetMessageStore (m_messageStore);
+  Connect (m_function);
+  m_emitted.clear ();
+
+  //window [0s, 1s) closes at 1.1s, the reading stamped 0.9s arrives after 1s but in time
+  Simulator::Schedule (Seconds (0.1), &DatpFunctionWindowTestCase::Send, this, Seconds (0.1).GetNanoSeconds (), 1);
+  Simulator::Schedule (Seconds (0.5), &DatpFunctionWindowTestCase::Send, this, Seconds (0.5).GetNanoSeconds (), 2);
+  Simulator::Schedule (Seconds (1.05), &DatpFunctionWindowTestCase::Send, this, Seconds (0.9).GetNanoSeconds (), 4);
+  Simulator::Schedule (Seconds (1.05), &DatpFunctionWindowTestCase::Send, this, Seconds (1.05).GetNanoSeconds (), 8);
+  //late, forwarded on its own
+  Simulator::Schedule (Seconds (1.5), &DatpFunctionWindowTestCase::Send, this, Seconds (0.95).GetNanoSeconds (), 16);
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_emitted.size (), 3, "wrong messages emitted");
+  const DatpMessage &first = m_messageStore->Get (m_emitted[0]);
+  NS_TEST_ASSERT_MSG_EQ (first.count, 3, "first window should hold three readings");
+  NS_TEST_ASSERT_MSG_EQ (first.timestamp, 0, "aggregate should be stamped with the start of the window");
+  NS_TEST_ASSERT_MSG_EQ (first.IsWindow (), true, "aggregate should be marked as a window");
+  DatpGenericApplicationDataHeader sum;
+  first.payload->PeekHeader (sum);
+  NS_TEST_ASSERT_MSG_EQ (sum.GetValue (), 7, "wrong sum");
+  NS_TEST_ASSERT_MSG_EQ (m_messageStore->Get (m_emitted[1]).count, 1, "late reading should be alone");
+  NS_TEST_ASSERT_MSG_EQ (m_messageStore->Get (m_emitted[1]).IsWindow (), false, "late reading should not be marked as a window");
+  NS_TEST_ASSERT_MSG_EQ (m_messageStore->Get (m_emitted[2]).timestamp, (uint64_t) Seconds (1.0).GetNanoSeconds (), "second window should close last");
+  NS_TEST_ASSERT_MSG_EQ (m_function->GetLateMessages (), 1, "wrong late messages");
+  m_function->Dispose ();
+}
+
+class DatpFunctionWindowTwoHopTestCase : public DatpFunctionTestCase
+{
+public:
+  DatpFunctionWindowTwoHopTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /// Runs the readings through a child and a parent window function sliding by slide
+  void Run (Time slide);
+  void Send (uint64_t timestamp);
+  void Forward (uint32_t handle);
+  virtual void NewMessage (uint32_t handle);
+
+  Ptr<DatpMessageStore> m_messageStore;
+  Ptr<DatpFunctionWindow> m_child;
+  Ptr<DatpFunctionWindow> m_parent;
+  std::vector<uint32_t> m_emitted;
+};
+
+DatpFunctionWindowTwoHopTestCase::DatpFunctionWindowTwoHopTestCase ()
+  : DatpFunctionTestCase ("Datp window aggregates stay in their window at the parent")
+{
+}
+
+void
+DatpFunctionWindowTwoHopTestCase::Send (uint64_t timestamp)
+{
+  DatpHeader datpHeader;
+  datpHeader.SetApplication (1);
+  datpHeader.SetTimestamp (timestamp);
+  m_child->ReceiveNewMessage (StoreMessage (m_messageStore, datpHeader, CreateReading (1), Simulator::Now ()));
+}
+
+void
+DatpFunctionWindowTwoHopTestCase::Forward (uint32_t handle)
+{
+  //the hop to the parent aggregator
+  m_parent->ReceiveNewMessage (handle);
+}
+
+void
+DatpFunctionWindowTwoHopTestCase::NewMessage (uint32_t handle)
+{
+  m_emitted.push_back (handle);
+}
+
+void
+DatpFunctionWindowTwoHopTestCase::Run (Time slide)
+{
+  m_messageStore = CreateObject<DatpMessageStore> ();
+  m_child = CreateObjectWithAttributes<DatpFunctionWindow> ("FunctionType", TypeIdValue (DatpFunctionSum::GetTypeId ()),
+                                                            "Size", TimeValue (Seconds (1.0)),
+                                                            "AllowedLateness", TimeValue (MilliSeconds (100)));
+  m_parent = CreateObjectWithAttributes<DatpFunctionWindow> ("FunctionType", TypeIdValue (DatpFunctionSum::GetTypeId ()),
+                                                             "Size", TimeValue (Seconds (1.0)),
+                                                             "AllowedLateness", TimeValue (MilliSeconds (200)));
+  m_child->SetAttribute ("Slide", TimeValue (slide));
+  m_parent->SetAttribute ("Slide", TimeValue (slide));
+  m_child->SetMessageStore (m_messageStore);
+  m_parent->SetMessageStore (m_messageStore);
+  Connect (m_child);
+  m_child->SetNewMessageCallback (MakeCallback (&DatpFunctionWindowTwoHopTestCase::Forward, this));
+  Connect (m_parent);
+  m_emitted.clear ();
+
+  Simulator::Schedule (Seconds (0.2), &DatpFunctionWindowTwoHopTestCase::Send, this, Seconds (0.2).GetNanoSeconds ());
+  Simulator::Schedule (Seconds (0.9), &DatpFunctionWindowTwoHopTestCase::Send, this, Seconds (0.9).GetNanoSeconds ());
+  Simulator::Schedule (Seconds (1.2), &DatpFunctionWindowTwoHopTestCase::Send, this, Seconds (1.2).GetNanoSeconds ());
+  Simulator::Schedule (Seconds (1.9), &DatpFunctionWindowTwoHopTestCase::Send, this, Seconds (1.9).GetNanoSeconds ());
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+DatpFunctionWindowTwoHopTestCase::DoRun (void)
+{
+  //tumbling, two readings in each of the windows [0s, 1s) and [1s, 2s)
+  Run (Seconds (0.0));
+  NS_TEST_ASSERT_MSG_EQ (m_emitted.size (), 2, "parent should emit one aggregate per window");
+  for (uint32_t i = 0; i < m_emitted.size (); ++i)
+    {
+      const DatpMessage &message = m_messageStore->Get (m_emitted[i]);
+      NS_TEST_ASSERT_MSG_EQ (message.count, 2, "parent window should hold the readings of one child window");
+      NS_TEST_ASSERT_MSG_EQ (message.timestamp, (uint64_t) Seconds (i).GetNanoSeconds (), "parent window should match the child window");
+    }
+  NS_TEST_ASSERT_MSG_EQ (m_parent->GetLateMessages (), 0, "child aggregates should reach the parent in time");
+  m_child->Dispose ();
+  m_parent->Dispose ();
+
+  //sliding by half a window, [0s, 1s), [0.5s, 1.5s), [1s, 2s) and [1.5s, 2.5s),
+  //each child aggregate is counted once, in the parent window it starts
+  uint32_t counts[] = { 2, 2, 2, 1 };
+  Run (Seconds (0.5));
+  NS_TEST_ASSERT_MSG_EQ (m_emitted.size (), 4, "parent should emit one aggregate per sliding window");
+  for (uint32_t i = 0; i < m_emitted.size () && i < 4; ++i)
+    {
+      const DatpMessage &message = m_messageStore->Get (m_emitted[i]);
+      NS_TEST_ASSERT_MSG_EQ (message.count, counts[i], "parent window should count the child aggregate once");
+      NS_TEST_ASSERT_MSG_EQ (message.timestamp, (uint64_t) MilliSeconds (500 * i).GetNanoSeconds (), "parent window should match the child window");
+    }
+  NS_TEST_ASSERT_MSG_EQ (m_parent->GetLateMessages (), 0, "child aggregates should reach the parent in time");
+  m_child->Dispose ();
+  m_parent->Dispose ();
+}
+
+class DatpFunctionPipelineTestCase : public DatpFunctionTestCase
+{
+public:
+  DatpFunctionPipelineTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Send (uint32_t origin, uint32_t value, double seconds);
+  virtual uint32_t Lookup (uint64_t mergeKey);
+  virtual void NewMessage (uint32_t handle);
+
+  Ptr<DatpMessageStore> m_messageStore;
+  Ptr<DatpFunctionPipeline> m_pipeline;
+  std::map<uint64_t, uint32_t> m_lookup;
+};
+
+DatpFunctionPipelineTestCase::DatpFunctionPipelineTestCase ()
+  : DatpFunctionTestCase ("Datp function pipeline chains its stages and reports per stage reduction")
+{
+}
+
+void
+DatpFunctionPipelineTestCase::Send (uint32_t origin, uint32_t value, double seconds)
+{
+  DatpHeader datpHeader;
+  datpHeader.SetApplication (1);
+  datpHeader.SetOrigin (origin);
+  m_pipeline->ReceiveNewMessage (StoreMessage (m_messageStore, datpHeader, CreateReading (value), Seconds (seconds)));
+}
+
+uint32_t
+DatpFunctionPipelineTestCase::Lookup (uint64_t mergeKey)
+{
+  std::map<uint64_t, uint32_t>::const_iterator it = m_lookup.find (mergeKey);
+  return it == m_lookup.end () ? 0 : it->second;
+}
+
+void
+DatpFunctionPipelineTestCase::NewMessage (uint32_t handle)
+{
+  m_new++;
+  m_lookup[m_messageStore->GetMergeKey (handle)] = handle;
+}
+
+void
+DatpFunctionPipelineTestCase::DoRun (void)
+{
+  m_messageStore = CreateObject<DatpMessageStore> ();
+  m_pipeline = CreateObject<DatpFunctionPipeline> ();
+  m_pipeline->SetMessageStore (m_messageStore);
+  Ptr<DatpFunctionDeadBand> deadBand = CreateObjectWithAttributes<DatpFunctionDeadBand> ("Heartbeat", TimeValue (Seconds (100.0)));
+  deadBand->SetMessageStore (m_messageStore);
+  m_pipeline->AddStage (deadBand);
+  Ptr<DatpFunctionSum> sum = CreateObject<DatpFunctionSum> ();
+  sum->SetMessageStore (m_messageStore);
+  m_pipeline->AddStage (sum);
+  Connect (m_pipeline);
+  m_lookup.clear ();
+
+  //origin 1 repeats itself and is suppressed after its first reading, origin 2 always changes
+  for (uint32_t i = 0; i < 10; ++i)
+    {
+      Send (1, 5, i);
+      Send (2, 2 * i, i);
+    }
+
+  NS_TEST_ASSERT_MSG_EQ (m_pipeline->GetNStages (), 2, "wrong stage count");
+  NS_TEST_ASSERT_MSG_EQ (m_pipeline->GetStageMessagesIn (0), 20, "every message should enter the first stage");
+  NS_TEST_ASSERT_MSG_EQ (m_pipeline->GetStageMessagesIn (1), 11, "only changed readings should reach the sum");
+  NS_TEST_ASSERT_MSG_EQ_TOL (m_pipeline->GetStageReductionRatio (1), 10.0 / 11.0, 1e-9, "wrong sum reduction ratio");
+  NS_TEST_ASSERT_MSG_EQ (m_new, 1, "the sum should forward a single aggregate");
+  NS_TEST_ASSERT_MSG_EQ (m_existing, 10, "the aggregate should be updated in place");
+  NS_TEST_ASSERT_MSG_EQ (m_pipeline->GetMessagesMerged (), 19, "merged counts should add up over the stages");
+  NS_TEST_ASSERT_MSG_EQ (m_messageStore->GetNMessages (), 1, "suppressed and merged messages should be freed");
+  m_pipeline->Dispose ();
+
+  //a sliding window hands the reading on in both of its windows, more than reached it
+  m_pipeline = CreateObject<DatpFunctionPipeline> ();
+  m_pipeline->SetMessageStore (m_messageStore);
+  Ptr<DatpFunctionWindow> window = CreateObjectWithAttributes<DatpFunctionWindow> ("FunctionType", TypeIdValue (DatpFunctionSum::GetTypeId ()),
+                                                                                   "Slide", TimeValue (Seconds (0.5)));
+  window->SetMessageStore (m_messageStore);
+  m_pipeline->AddStage (window);
+  Connect (m_pipeline);
+  Send (1, 5, 0.7);
+  Simulator::Run ();
+  Simulator::Destroy ();
+  NS_TEST_ASSERT_MSG_EQ (m_pipeline->GetStageMessagesIn (0), 1, "wrong messages in");
+  NS_TEST_ASSERT_MSG_EQ (window->GetMessagesForwarded (), 2, "the reading should be handed on once per window");
+  NS_TEST_ASSERT_MSG_EQ (m_pipeline->GetStageReductionRatio (0), 0.0, "the reduction ratio should not go negative");
+  m_pipeline->Dispose ();
+}
+
+class DatpBloomFilterTestCase : public TestCase
+{
+public:
+  DatpBloomFilterTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DatpBloomFilterTestCase::DatpBloomFilterTestCase ()
+  : TestCase ("Datp rotating Bloom filter remembers recent keys in bounded memory")
+{
+}
+
+void
+DatpBloomFilterTestCase::DoRun (void)
+{
+  DatpBloomFilter filter;
+  filter.SetCapacity (1000, 10);
+  uint32_t seen = 0;
+  for (uint64_t key = 0; key < 1000; ++key)
+    seen += filter.Insert (key * 7919 + 1);
+  NS_TEST_ASSERT_MSG_LT (seen, 30, "too many fresh keys reported as seen");
+  seen = 0;
+  for (uint64_t key = 0; key < 1000; ++key)
+    seen += filter.Insert (key * 7919 + 1);
+  NS_TEST_ASSERT_MSG_EQ (seen, 1000, "a key must never be forgotten within a generation");
+
+  //after two more generations the first keys are gone, bar false positives
+  filter.SetCapacity (100, 10);
+  for (uint64_t key = 0; key < 300; ++key)
+    filter.Insert (key);
+  NS_TEST_ASSERT_MSG_EQ (filter.Insert (150), true, "the previous generation should still hold its keys");
+  seen = 0;
+  for (uint64_t key = 0; key < 100; ++key)
+    seen += filter.Insert (key);
+  NS_TEST_ASSERT_MSG_LT (seen, 10, "keys of rotated out generations should be forgotten");
+}
+
+class DatpFunctionSchemaTestCase : public DatpFunctionTestCase
+{
+public:
+  DatpFunctionSchemaTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DatpFunctionSchemaTestCase::DatpFunctionSchemaTestCase ()
+  : DatpFunctionTestCase ("Datp schema function reduces each field of the payload records as declared")
+{
+}
+
+void
+DatpFunctionSchemaTestCase::DoRun (void)
+{
+  DatpPayloadSchema schema;
+  NS_TEST_ASSERT_MSG_EQ (schema.Parse ("u16:sum q16:mean"), false, "fixed point fields need a scale");
+  NS_TEST_ASSERT_MSG_EQ (schema.Parse ("u16:sum q16/100:mean i32:min f32:max u32:last"), true, "schema should parse");
+  NS_TEST_ASSERT_MSG_EQ (schema.GetSize (), 16, "fields should keep their natural widths");
+  DatpPayloadSchema::Register (5, schema);
+
+  Ptr<DatpMessageStore> messageStore = CreateObject<DatpMessageStore> ();
+  Ptr<DatpFunctionSchema> function = CreateObject<DatpFunctionSchema> ();
+  function->SetMessageStore (messageStore);
+  Connect (function);
+
+  uint8_t record[16];
+  for (uint32_t m = 0; m < 10; ++m)
+    {
+      schema.Write (record, 0, 10000);
+      schema.Write (record, 1, -1.5 + m * 0.5);
+      schema.Write (record, 2, -(double) m);
+      schema.Write (record, 3, m * 0.25);
+      schema.Write (record, 4, m);
+      DatpHeader datpHeader;
+      datpHeader.SetApplication (5);
+      datpHeader.SetTimestamp (m);
+      function->ReceiveNewMessage (StoreMessage (messageStore, datpHeader, Create<Packet> (record, sizeof (record))));
+    }
+  DatpPayloadSchema::Register (5, DatpPayloadSchema ());
+
+  NS_TEST_ASSERT_MSG_EQ (messageStore->GetNMessages (), 1, "messages should be reduced into one");
+  NS_TEST_ASSERT_MSG_EQ (messageStore->Get (m_buffered).count, 10, "wrong count");
+  messageStore->Get (m_buffered).payload->CopyData (record, sizeof (record));
+  NS_TEST_ASSERT_MSG_EQ (schema.Read (record, 0), 65535, "a sum should saturate at the field width");
+  NS_TEST_ASSERT_MSG_EQ_TOL (schema.Read (record, 1), 0.75, 0.005, "wrong fixed point mean");
+  NS_TEST_ASSERT_MSG_EQ (schema.Read (record, 2), -9, "wrong min");
+  NS_TEST_ASSERT_MSG_EQ (schema.Read (record, 3), 2.25, "wrong max");
+  NS_TEST_ASSERT_MSG_EQ (schema.Read (record, 4), 9, "the latest record should win a last field");
+}
+
+class DatpSchemaApplicationTestCase : public DatpFunctionTestCase
+{
+public:
+  DatpSchemaApplicationTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Receive (Ptr<Socket> socket);
+
+  Ptr<DatpMessageStore> m_messageStore;
+  Ptr<DatpFunction> m_function;
+  uint32_t m_received;
+};
+
+DatpSchemaApplicationTestCase::DatpSchemaApplicationTestCase ()
+  : DatpFunctionTestCase ("Datp applications send schema records that receivers parse and reduce")
+{
+}
+
+void
+DatpSchemaApplicationTestCase::Receive (Ptr<Socket> socket)
+{
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      DatpHeaderView view;
+      NS_TEST_ASSERT_MSG_EQ (view.Parse (packet), true, "a schema packet should parse");
+      NS_TEST_ASSERT_MSG_EQ (view.GetNMessages (), 1u, "wrong messages");
+      NS_TEST_ASSERT_MSG_EQ (view.GetMessage (0).dataLength, 6u, "the length should be that of a record");
+      NS_TEST_ASSERT_MSG_EQ (view.GetPayload (0)->GetSize (), 6u, "the payload should be one record");
+      ++m_received;
+      m_function->ReceiveNewMessage (m_messageStore->Add (view.GetMessage (0), view.GetPayload (0), Simulator::Now ()));
+    }
+}
+
+void
+DatpSchemaApplicationTestCase::DoRun (void)
+{
+  //records of 6 bytes, which the application sends instead of DataLength bytes
+  DatpPayloadSchema schema;
+  schema.Parse ("u16:sum u32:max");
+  DatpPayloadSchema::Register (1, schema);
+
+  m_messageStore = CreateObject<DatpMessageStore> ();
+  m_function = CreateObject<DatpFunctionSchema> ();
+  m_function->SetMessageStore (m_messageStore);
+  Connect (m_function);
+  m_received = 0;
+
+  //the application sends to 127.0.0.1 by default, the loopback of its node
+  Ptr<Node> node = CreateObject<Node> ();
+  InternetStackHelper internet;
+  internet.Install (node);
+  Ptr<Socket> sink = Socket::CreateSocket (node, UdpSocketFactory::GetTypeId ());
+  sink->Bind (InetSocketAddress (Ipv4Address::GetAny (), 9999));
+  sink->SetRecvCallback (MakeCallback (&DatpSchemaApplicationTestCase::Receive, this));
+  Ptr<DatpApplication> application = CreateObjectWithAttributes<DatpApplicationOne> ("DataLength", UintegerValue (20));
+  node->AddApplication (application);
+  application->SetStartTime (Seconds (0.0));
+  application->SetStopTime (Seconds (1.0));
+  Simulator::Stop (Seconds (2.0));
+  Simulator::Run ();
+  Simulator::Destroy ();
+  NS_TEST_ASSERT_MSG_EQ (DatpPayloadSchema::Lookup (1) == 0, true, "Simulator::Destroy should clear the schemas");
+
+  NS_TEST_ASSERT_MSG_GT (m_received, 5u, "the records should arrive");
+  NS_TEST_ASSERT_MSG_EQ (m_new, 1u, "the records should reduce into one message");
+  NS_TEST_ASSERT_MSG_EQ (m_messageStore->Get (m_buffered).count, m_received, "every record should be counted");
+  sink->Close ();
+  m_function = 0;
+  m_messageStore = 0;
+}
+
+class DatpApplicationSequenceTestCase : public TestCase
+{
+public:
+  DatpApplicationSequenceTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Receive (Ptr<Socket> socket);
+
+  std::vector<uint32_t> m_sequences;
+};
+
+DatpApplicationSequenceTestCase::DatpApplicationSequenceTestCase ()
+  : TestCase ("Datp applications only number the readings they send")
+{
+}
+
+void
+DatpApplicationSequenceTestCase::Receive (Ptr<Socket> socket)
+{
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      DatpHeaderView view;
+      NS_TEST_ASSERT_MSG_EQ (view.Parse (packet), true, "a reading should parse");
+      m_sequences.push_back (view.GetMessage (0).sequence);
+    }
+}
+
+void
+DatpApplicationSequenceTestCase::DoRun (void)
+{
+  Ptr<Node> node = CreateObject<Node> ();
+  InternetStackHelper internet;
+  internet.Install (node);
+  Ptr<Socket> sink = Socket::CreateSocket (node, UdpSocketFactory::GetTypeId ());
+  sink->Bind (InetSocketAddress (Ipv4Address::GetAny (), 9999));
+  sink->SetRecvCallback (MakeCallback (&DatpApplicationSequenceTestCase::Receive, this));
+  //the readings never change, only the heartbeats are sent
+  Ptr<DatpApplication> application = CreateObjectWithAttributes<DatpApplicationOne> ("StampSequence", BooleanValue (true),
+                                                                                     "Heartbeat", TimeValue (Seconds (0.5)));
+  node->AddApplication (application);
+  application->SetStartTime (Seconds (0.0));
+  application->SetStopTime (Seconds (2.0));
+  m_sequences.clear ();
+  Simulator::Stop (Seconds (3.0));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_GT (application->GetMessagesSuppressed (), 0u, "repeated readings should be suppressed");
+  NS_TEST_ASSERT_MSG_EQ (m_sequences.size (), application->GetMessagesSent (), "every reading sent should arrive");
+  for (uint32_t i = 0; i < m_sequences.size (); ++i)
+    NS_TEST_ASSERT_MSG_EQ (m_sequences[i], i, "suppressed readings should leave no gap in the sequence");
+  sink->Close ();
+}
+
+class DatpQuantizerTestCase : public DatpFunctionTestCase
+{
+public:
+  DatpQuantizerTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DatpQuantizerTestCase::DatpQuantizerTestCase ()
+  : DatpFunctionTestCase ("Datp quantization keeps the readings within the error budget of their application")
+{
+}
+
+void
+DatpQuantizerTestCase::DoRun (void)
+{
+  uint32_t readings[4] = { 0, 1000, 123456, 0xffffffff };
+  std::vector<uint8_t> payload;
+  double spent = DatpQuantizer::Pack (readings, 4, false, 100, 5, payload);
+  std::vector<uint32_t> restored;
+  double restoredSpent;
+  NS_TEST_ASSERT_MSG_EQ (DatpQuantizer::Unpack (&payload[0], payload.size (), restored, restoredSpent), true, "payload should unpack");
+  NS_TEST_ASSERT_MSG_EQ (restored.size (), 4, "wrong readings");
+  NS_TEST_ASSERT_MSG_EQ (restored[0], 0, "zero should stay exact");
+  NS_TEST_ASSERT_MSG_EQ_TOL ((double) restored[2], 123456.0, 64.0, "reading off by more than the step");
+  NS_TEST_ASSERT_MSG_LT (spent, 105.0 + 1e-9, "spent more than allowed");
+  NS_TEST_ASSERT_MSG_EQ (restoredSpent >= spent, true, "spent error should never shrink on the way");
+  NS_TEST_ASSERT_MSG_EQ (DatpQuantizer::Unpack (&payload[0], payload.size () - 1, restored, restoredSpent), false, "truncation should be caught");
+  //claims of more readings than the bits hold
+  uint8_t zeroWidth[9] = { 0, 0, 0xff, 0xff, 0x7f, 0, 0, 0, 0 };
+  NS_TEST_ASSERT_MSG_EQ (DatpQuantizer::Unpack (zeroWidth, 9, restored, restoredSpent), false, "zero width readings should be caught");
+  //n * 33 wraps around to 8 bits
+  uint8_t overflow[16] = { 0, 33, 0x88, 0xbe, 0xf0, 0x83, 0x9f, 0xf8, 0xc1, 0x8f, 0x7c, 0, 0, 0, 0, 0 };
+  NS_TEST_ASSERT_MSG_EQ (DatpQuantizer::Unpack (overflow, 16, restored, restoredSpent), false, "overflowing readings should be caught");
+
+  DatpQuantizer::SetErrorBudget (1, 100, false);
+  Ptr<DatpMessageStore> messageStore = CreateObject<DatpMessageStore> ();
+  Ptr<DatpFunction> function = CreateObjectWithAttributes<DatpFunctionSum> ("Quantize", BooleanValue (true));
+  function->SetMessageStore (messageStore);
+  Connect (function);
+  uint32_t exact = 0;
+  for (uint32_t m = 0; m < 10; ++m)
+    {
+      Ptr<Packet> packet = Create<Packet> ();
+      for (uint32_t w = 0; w < 5; ++w)
+        {
+          DatpGenericApplicationDataHeader reading;
+          reading.SetValue (1000 + m * 37 + w);
+          packet->AddHeader (reading);
+        }
+      exact += 1000 + m * 37;
+      DatpHeader datpHeader;
+      datpHeader.SetApplication (1);
+      function->ReceiveNewMessage (StoreMessage (messageStore, datpHeader, packet));
+    }
+  function->Reduce (m_buffered);
+  Simulator::Destroy ();
+  NS_TEST_ASSERT_MSG_EQ (DatpQuantizer::GetErrorBudget (1), 0, "Simulator::Destroy should clear the error budgets");
+
+  const DatpMessage &message = messageStore->Get (m_buffered);
+  NS_TEST_ASSERT_MSG_EQ (message.IsQuantized (), true, "the sum should leave quantized");
+  NS_TEST_ASSERT_MSG_LT (message.payload->GetSize (), 20, "quantized readings should take fewer bytes");
+  Ptr<Packet> packet = message.payload->Copy ();
+  packet->AddHeader (messageStore->GetHeader (m_buffered));
+  DatpHeaderView view (packet);
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (0).encodingFlags & DATP_HFF3_QUANTIZED, DATP_HFF3_QUANTIZED, "quantized flag should be sent");
+  payload.resize (message.payload->GetSize ());
+  message.payload->CopyData (&payload[0], payload.size ());
+  DatpQuantizer::Unpack (&payload[0], payload.size (), restored, restoredSpent);
+  NS_TEST_ASSERT_MSG_LT (restoredSpent, 100.0 + 1e-9, "error budget overspent");
+  //readings are written last first
+  NS_TEST_ASSERT_MSG_EQ_TOL ((double) restored[4], (double) exact, restoredSpent, "sum off by more than the error spent");
+
+  //readings quantized one by one add their errors up in the sum of the
+  //next hop, the budget bounds the error of each reading, not of the sum
+  DatpQuantizer::SetErrorBudget (1, 100, false);
+  Ptr<DatpFunction> child = CreateObjectWithAttributes<DatpFunctionSum> ("Quantize", BooleanValue (true));
+  child->SetMessageStore (messageStore);
+  Connect (child);
+  std::vector<uint32_t> handles;
+  exact = 0;
+  for (uint32_t m = 0; m < 10; ++m)
+    {
+      Ptr<Packet> packet = Create<Packet> ();
+      for (uint32_t w = 0; w < 5; ++w)
+        {
+          DatpGenericApplicationDataHeader reading;
+          reading.SetValue (100000 + m * 1237 + w);
+          packet->AddHeader (reading);
+        }
+      DatpHeader datpHeader;
+      datpHeader.SetApplication (1);
+      m_buffered = 0;
+      child->ReceiveNewMessage (StoreMessage (messageStore, datpHeader, packet));
+      child->Reduce (m_buffered);
+      NS_TEST_ASSERT_MSG_EQ (messageStore->Get (m_buffered).IsQuantized (), true, "each reading should leave quantized");
+      NS_TEST_ASSERT_MSG_LT (messageStore->GetErrorSpent (m_buffered), 50.0 + 1e-9, "each reading should spend its share of the budget");
+      handles.push_back (m_buffered);
+      exact += 100000 + m * 1237;
+    }
+  Ptr<DatpFunction> parent = CreateObjectWithAttributes<DatpFunctionSum> ("Quantize", BooleanValue (true));
+  parent->SetMessageStore (messageStore);
+  Connect (parent);
+  m_buffered = 0;
+  for (uint32_t m = 0; m < handles.size (); ++m)
+    parent->ReceiveNewMessage (handles[m]);
+  parent->Reduce (m_buffered);
+  const DatpMessage &sum = messageStore->Get (m_buffered);
+  NS_TEST_ASSERT_MSG_EQ (sum.count, 10, "the readings should be summed");
+  NS_TEST_ASSERT_MSG_EQ (sum.IsQuantized (), true, "the sum should leave quantized");
+  payload.resize (sum.payload->GetSize ());
+  sum.payload->CopyData (&payload[0], payload.size ());
+  DatpQuantizer::Unpack (&payload[0], payload.size (), restored, restoredSpent);
+  NS_TEST_ASSERT_MSG_GT (restoredSpent, 100.0, "the errors of the readings should add up past the budget");
+  NS_TEST_ASSERT_MSG_LT (restoredSpent, sum.count * 100.0 + 1e-9, "sum off by more than the budget of its readings");
+  NS_TEST_ASSERT_MSG_EQ_TOL ((double) restored[4], (double) exact, restoredSpent, "sum off by more than the error spent");
+  Simulator::Destroy ();
+}
+
+class DatpFunctionIncrementalTestCase : public DatpFunctionTestCase
+{
+public:
+  DatpFunctionIncrementalTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /// Pass readings a and b from sender, \returns the handle of the report, 0 if none
+  uint32_t Send (uint32_t a, uint32_t b, uint32_t sender, Time receiveTime = Seconds (0.0));
+
+  Ptr<DatpMessageStore> m_messageStore;
+  Ptr<DatpFunction> m_function;
+};
+
+DatpFunctionIncrementalTestCase::DatpFunctionIncrementalTestCase ()
+  : DatpFunctionTestCase ("Datp incremental function only reports the changes of the subtree totals")
+{
+}
+
+uint32_t
+DatpFunctionIncrementalTestCase::Send (uint32_t a, uint32_t b, uint32_t sender, Time receiveTime)
+{
+  Ptr<Packet> packet = Create<Packet> ();
+  DatpGenericApplicationDataHeader reading;
+  reading.SetValue (b);
+  packet->AddHeader (reading);
+  reading.SetValue (a);
+  packet->AddHeader (reading);
+  DatpHeader datpHeader;
+  datpHeader.SetApplication (1);
+  m_buffered = 0;
+  m_function->ReceiveNewMessage (StoreMessage (m_messageStore, datpHeader, packet, receiveTime, sender));
+  return m_buffered;
+}
+
+void
+DatpFunctionIncrementalTestCase::DoRun (void)
+{
+  std::vector<int64_t> words;
+  words.push_back (5);
+  words.push_back (-300);
+  std::vector<int64_t> decoded;
+  Ptr<Packet> delta = DatpFunctionIncremental::EncodeDelta (words);
+  NS_TEST_ASSERT_MSG_EQ (delta->GetSize (), 4, "small changes should take a byte or two each");
+  NS_TEST_ASSERT_MSG_EQ (DatpFunctionIncremental::DecodeDelta (delta, decoded), true, "delta should decode");
+  NS_TEST_ASSERT_MSG_EQ (decoded[1], -300, "wrong change");
+  delta->RemoveAtEnd (1);
+  NS_TEST_ASSERT_MSG_EQ (DatpFunctionIncremental::DecodeDelta (delta, decoded), false, "truncation should be caught");
+
+  m_messageStore = CreateObject<DatpMessageStore> ();
+  m_function = CreateObjectWithAttributes<DatpFunctionIncremental> ("Threshold", UintegerValue (2));
+  m_function->SetMessageStore (m_messageStore);
+  Connect (m_function);
+
+  //the first report is a snapshot of the total of both senders
+  uint32_t report = Send (100, 7, 1);
+  NS_TEST_ASSERT_MSG_NE (report, 0, "the first message should be reported");
+  NS_TEST_ASSERT_MSG_EQ (Send (50, 7, 2), 0, "the second message should ride along");
+  m_function->Reduce (report);
+  DatpMessage &snapshot = m_messageStore->Get (report);
+  NS_TEST_ASSERT_MSG_EQ (snapshot.IsDelta (), false, "the parent should get a snapshot first");
+  NS_TEST_ASSERT_MSG_EQ (snapshot.count, 2, "wrong count");
+  DatpHeaderView view;
+  Ptr<Packet> packet = snapshot.payload->Copy ();
+  packet->AddHeader (m_messageStore->GetHeader (report));
+  view.Parse (packet);
+  NS_TEST_ASSERT_MSG_EQ (view.ReadPayloadU32 (0, 0), 150, "wrong snapshot");
+  //the receiver, the collector on the last hop, keeps the total from the reports
+  std::vector<int64_t> total;
+  NS_TEST_ASSERT_MSG_EQ (DatpFunctionIncremental::ApplyReport (view.GetPayload (0), false, total), true, "snapshot should apply");
+  NS_TEST_ASSERT_MSG_EQ (total.size (), 2, "the snapshot should set the total");
+  NS_TEST_ASSERT_MSG_EQ (total[0], 150, "wrong total");
+  m_messageStore->Remove (report);
+
+  //changes within the threshold are not reported
+  NS_TEST_ASSERT_MSG_EQ (Send (101, 7, 1), 0, "a small change should not be reported");
+  NS_TEST_ASSERT_MSG_EQ (Send (51, 7, 2), 0, "a small change should not be reported");
+  NS_TEST_ASSERT_MSG_EQ (m_function->GetMessagesMerged (), 3, "wrong merged count");
+
+  //a larger one leaves as a delta
+  report = Send (104, 7, 1);
+  NS_TEST_ASSERT_MSG_NE (report, 0, "a large change should be reported");
+  m_function->Reduce (report);
+  DatpMessage &change = m_messageStore->Get (report);
+  NS_TEST_ASSERT_MSG_EQ (change.IsDelta (), true, "the change should leave as a delta");
+  NS_TEST_ASSERT_MSG_LT (change.payload->GetSize (), 8, "the delta should be smaller than the readings");
+  packet = change.payload->Copy ();
+  packet->AddHeader (m_messageStore->GetHeader (report));
+  view.Parse (packet);
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (0).encodingFlags & DATP_HFF3_DELTA, DATP_HFF3_DELTA, "delta flag should be sent");
+  DatpFunctionIncremental::DecodeDelta (view.GetPayload (0), decoded);
+  NS_TEST_ASSERT_MSG_EQ (decoded.size (), 2, "wrong delta size");
+  NS_TEST_ASSERT_MSG_EQ (decoded[0], 5, "the delta should hold the change since the last report");
+  NS_TEST_ASSERT_MSG_EQ (decoded[1], 0, "wrong change");
+  NS_TEST_ASSERT_MSG_EQ (DatpFunctionIncremental::ApplyReport (view.GetPayload (0), true, total), true, "delta should apply");
+  NS_TEST_ASSERT_MSG_EQ (total[0], 155, "the delta should add to the total");
+  NS_TEST_ASSERT_MSG_EQ (total[1], 14, "wrong total");
+  NS_TEST_ASSERT_MSG_EQ (DatpFunctionIncremental::ApplyReport (Create<Packet> (3), false, total), false, "a partial word should be caught");
+  NS_TEST_ASSERT_MSG_EQ (total[0], 155, "a malformed report should leave the total");
+  m_messageStore->Remove (report);
+
+  //a new parent gets a snapshot, even of an unchanged total
+  m_function->NotifyParentChange ();
+  report = Send (104, 7, 1);
+  NS_TEST_ASSERT_MSG_NE (report, 0, "the new parent should be told the total");
+  m_function->Reduce (report);
+  NS_TEST_ASSERT_MSG_EQ (m_messageStore->Get (report).IsDelta (), false, "the new parent should get a snapshot");
+  NS_TEST_ASSERT_MSG_EQ (m_messageStore->Get (report).payload->GetSize (), 8, "wrong snapshot");
+  m_messageStore->Remove (report);
+
+  //sender 2 moved to another parent, its share leaves the total once it times out
+  NS_TEST_ASSERT_MSG_EQ (Send (104, 7, 1, Seconds (4.0)), 0, "sender 2 should still count");
+  report = Send (104, 7, 1, Seconds (6.0));
+  NS_TEST_ASSERT_MSG_NE (report, 0, "the loss of sender 2 should be reported");
+  m_function->Reduce (report);
+  NS_TEST_ASSERT_MSG_EQ (m_messageStore->Get (report).IsDelta (), true, "the loss should leave as a delta");
+  DatpFunctionIncremental::DecodeDelta (m_messageStore->Get (report).payload, decoded);
+  NS_TEST_ASSERT_MSG_EQ (decoded[0], -51, "the share of sender 2 should be taken off");
+  NS_TEST_ASSERT_MSG_EQ (decoded[1], -7, "wrong change");
+  DatpFunctionIncremental::ApplyReport (m_messageStore->Get (report).payload, true, total);
+  NS_TEST_ASSERT_MSG_EQ (total[0], 104, "the total should follow the loss of sender 2");
+  NS_TEST_ASSERT_MSG_EQ (total[1], 7, "wrong total");
+  m_function = 0;
+  m_messageStore = 0;
+}
+
+class DatpFunctionFusionTestCase : public DatpFunctionTestCase
+{
+public:
+  DatpFunctionFusionTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DatpFunctionFusionTestCase::DatpFunctionFusionTestCase ()
+  : DatpFunctionTestCase ("Datp fusion puts the readings of several applications of a node behind one header")
+{
+}
+
+void
+DatpFunctionFusionTestCase::DoRun (void)
+{
+  Ptr<DatpMessageStore> messageStore = CreateObject<DatpMessageStore> ();
+  Ptr<DatpFunction> function = CreateObject<DatpFunctionFusion> ();
+  function->SetMessageStore (messageStore);
+  Connect (function);
+
+  //three applications of one node within the window, and one too late
+  uint64_t timestamps[4] = { 1000000000, 1000001000, 1020000000, 1200000000 };
+  uint32_t lengths[4] = { 20, 60, 40, 20 };
+  uint32_t separate = 0;
+  uint32_t head = 0;
+  for (uint32_t m = 0; m < 4; ++m)
+    {
+      std::vector<uint8_t> data (lengths[m], m % 3 + 1);
+      DatpHeader datpHeader;
+      datpHeader.SetOrigin (9);
+      datpHeader.SetApplication (m % 3 + 1);
+      datpHeader.SetTimestamp (timestamps[m]);
+      uint32_t handle = StoreMessage (messageStore, datpHeader, Create<Packet> (&data[0], lengths[m]));
+      if (m < 3)
+        separate += messageStore->Get (handle).headerSize + lengths[m];
+      m_buffered = 0;
+      function->ReceiveNewMessage (handle);
+      if (m == 0)
+        head = m_buffered;
+      else if (m < 3)
+        NS_TEST_ASSERT_MSG_EQ (m_buffered, 0, "aligned readings of other applications should be fused");
+      else
+        NS_TEST_ASSERT_MSG_NE (m_buffered, 0, "a later reading should start a new record");
+    }
+  function->Reduce (head);
+  NS_TEST_ASSERT_MSG_EQ (function->GetMessagesMerged (), 2, "wrong merged count");
+
+  const DatpMessage &message = messageStore->Get (head);
+  NS_TEST_ASSERT_MSG_EQ (message.IsFused (), true, "the record should leave fused");
+  Ptr<Packet> packet = message.payload->Copy ();
+  packet->AddHeader (messageStore->GetHeader (head));
+  NS_TEST_ASSERT_MSG_LT (packet->GetSize (), separate, "one header should take fewer bytes than three");
+  DatpHeaderView view (packet);
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (0).encodingFlags & DATP_HFF3_FUSED, DATP_HFF3_FUSED, "fused flag should be sent");
+  NS_TEST_ASSERT_MSG_EQ (view.GetMessage (0).count, 3, "the count should be the number of records");
+
+  //split back out, as a collector does
+  std::vector<DatpHeader> headers;
+  std::vector<Ptr<Packet> > payloads;
+  NS_TEST_ASSERT_MSG_EQ (DatpFunctionFusion::Unpack (view.GetHeader (0), view.GetPayload (0), headers, payloads), true, "payload should unpack");
+  NS_TEST_ASSERT_MSG_EQ (headers.size (), 3, "wrong number of records");
+  for (uint32_t r = 0; r < headers.size (); ++r)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((uint32_t) headers[r].GetApplication (), r + 1, "records should come in application order");
+      NS_TEST_ASSERT_MSG_EQ (headers[r].GetOrigin (), 9, "wrong origin");
+      NS_TEST_ASSERT_MSG_EQ (headers[r].GetTimestamp (), timestamps[r], "wrong timestamp");
+      NS_TEST_ASSERT_MSG_EQ (headers[r].IsFused (), false, "records should not be fused");
+      NS_TEST_ASSERT_MSG_EQ (payloads[r]->GetSize (), lengths[r], "wrong payload");
+    }
+  Ptr<Packet> truncated = view.GetPayload (0);
+  truncated->RemoveAtEnd (1);
+  NS_TEST_ASSERT_MSG_EQ (DatpFunctionFusion::Unpack (view.GetHeader (0), truncated, headers, payloads), false, "truncation should be caught");
+}
+
+class DatpFunctionTypedForwardTestCase : public DatpFunctionTestCase
+{
+public:
+  DatpFunctionTypedForwardTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /// Pass two readings of value, fused or not, \returns the handle
+  uint32_t Send (bool fused, uint32_t value);
+
+  Ptr<DatpMessageStore> m_messageStore;
+  Ptr<DatpFunction> m_function;
+};
+
+DatpFunctionTypedForwardTestCase::DatpFunctionTypedForwardTestCase ()
+  : DatpFunctionTestCase ("Datp typed functions forward the payloads they cannot parse unmerged")
+{
+}
+
+uint32_t
+DatpFunctionTypedForwardTestCase::Send (bool fused, uint32_t value)
+{
+  Ptr<Packet> packet = Create<Packet> ();
+  DatpGenericApplicationDataHeader reading;
+  reading.SetValue (value);
+  packet->AddHeader (reading);
+  packet->AddHeader (reading);
+  DatpHeader datpHeader;
+  datpHeader.SetApplication (1);
+  datpHeader.SetFused (fused);
+  uint32_t handle = StoreMessage (m_messageStore, datpHeader, packet);
+  m_function->ReceiveNewMessage (handle);
+  return handle;
+}
+
+void
+DatpFunctionTypedForwardTestCase::DoRun (void)
+{
+  m_messageStore = CreateObject<DatpMessageStore> ();
+  m_function = CreateObject<DatpFunctionSum> ();
+  m_function->SetMessageStore (m_messageStore);
+  Connect (m_function);
+
+  //a fused message of the same size meets a plain one, and the other way round
+  uint32_t plain = Send (false, 3);
+  uint32_t fused = Send (true, 5);
+  NS_TEST_ASSERT_MSG_EQ (m_new, 2, "the fused message should be forwarded on its own");
+  Send (false, 7);
+  NS_TEST_ASSERT_MSG_EQ (m_new, 3, "the plain message should not merge into the fused one");
+  NS_TEST_ASSERT_MSG_EQ (m_existing, 0, "nothing should be merged");
+  NS_TEST_ASSERT_MSG_EQ (m_messageStore->GetNMessages (), 3, "all messages should be kept");
+
+  DatpGenericApplicationDataHeader reading;
+  m_messageStore->Get (plain).payload->PeekHeader (reading);
+  NS_TEST_ASSERT_MSG_EQ (reading.GetValue (), 3, "the plain readings should be untouched");
+  m_messageStore->Get (fused).payload->PeekHeader (reading);
+  NS_TEST_ASSERT_MSG_EQ (reading.GetValue (), 5, "the fused records should be untouched");
+  NS_TEST_ASSERT_MSG_EQ (m_messageStore->Get (fused).count, 1, "the fused count should be untouched");
+  m_function = 0;
+  m_messageStore = 0;
+}
+
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
 // and enables the TestCases to be run.  Typically, only the constructor for
 // this class must be defined
@@ -60,6 +1914,33 @@ DatpTestSuite::DatpTestSuite ()
   : TestSuite ("datp", UNIT)
 {
   AddTestCase (new DatpTestCase1);
+  AddTestCase (new DatpHeaderViewTestCase);
+  AddTestCase (new DatpHeaderLayoutTestCase);
+  AddTestCase (new DatpHeaderSizeModifiersTestCase);
+  AddTestCase (new DatpHeaderBundleTestCase);
+  AddTestCase (new DatpHeaderContextTestCase);
+  AddTestCase (new DatpFrameHeaderTestCase);
+  AddTestCase (new DatpPacketBuilderTestCase);
+  AddTestCase (new DatpMessageStoreTestCase);
+  AddTestCase (new DatpMergeKernelTestCase);
+  AddTestCase (new DatpLazyMergeTestCase);
+  AddTestCase (new DatpMergeIndexTestCase);
+  AddTestCase (new DatpFunctionTypedTestCase);
+  AddTestCase (new DatpFunctionSketchTestCase);
+  AddTestCase (new DatpFunctionCompressTestCase);
+  AddTestCase (new DatpDeadBandTestCase);
+  AddTestCase (new DatpMergeKeyTestCase);
+  AddTestCase (new DatpFunctionWindowTestCase);
+  AddTestCase (new DatpFunctionWindowTwoHopTestCase);
+  AddTestCase (new DatpFunctionPipelineTestCase);
+  AddTestCase (new DatpBloomFilterTestCase);
+  AddTestCase (new DatpFunctionSchemaTestCase);
+  AddTestCase (new DatpSchemaApplicationTestCase);
+  AddTestCase (new DatpApplicationSequenceTestCase);
+  AddTestCase (new DatpQuantizerTestCase);
+  AddTestCase (new DatpFunctionIncrementalTestCase);
+  AddTestCase (new DatpFunctionFusionTestCase);
+  AddTestCase (new DatpFunctionTypedForwardTestCase);
 }
 
 // Do not forget to allocate an instance of this TestSuite